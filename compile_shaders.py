@@ -1,11 +1,104 @@
 import os
 import subprocess
+import sys
 
 input_folder = "shaders"
 output_folder = "shaders/compiled_shaders"
+embedded_header = os.path.join(output_folder, "embedded_shaders.hpp")
+
+HEADER_PROLOGUE = """// Generated by compile_shaders.py, do not edit.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace core::embedded {
+
+"""
+
+HEADER_EPILOGUE = """
+}  // namespace core::embedded
+"""
+
+
+def write_embedded_header(shaders):
+    """Embed every compiled .spv as a constexpr uint32_t array, so the
+    binary does not need the .spv files at runtime.
+
+    'shaders' is a list of (spv_filename, is_clspv).
+    """
+    parts = [HEADER_PROLOGUE]
+    table = []
+    for spv_name, is_clspv in sorted(shaders):
+        spv_path = os.path.join(output_folder, spv_name)
+        with open(spv_path, "rb") as f:
+            data = f.read()
+        words = [
+            int.from_bytes(data[i : i + 4], "little")
+            for i in range(0, len(data), 4)
+        ]
+
+        symbol = os.path.splitext(spv_name)[0] + "_spv"
+        parts.append(f"inline constexpr uint32_t {symbol}[] = {{\n")
+        for i in range(0, len(words), 8):
+            line = ", ".join(f"0x{w:08x}" for w in words[i : i + 8])
+            parts.append(f"    {line},\n")
+        parts.append("};\n\n")
+        table.append(
+            f'    EmbeddedShader{{"{spv_name}", {symbol}, '
+            f'{"true" if is_clspv else "false"}}},\n'
+        )
+
+    parts.append("struct EmbeddedShader {\n")
+    parts.append("  std::string_view name;\n")
+    parts.append("  std::span<const uint32_t> code;\n")
+    parts.append("  bool is_clspv;\n")
+    parts.append("};\n\n")
+    parts.append(
+        "inline constexpr std::array<EmbeddedShader, "
+        f"{len(table)}> kShaders{{{{\n"
+    )
+    parts.extend(table)
+    parts.append("}};\n")
+    parts.append(HEADER_EPILOGUE)
+    content = "".join(parts)
+
+    # Leave the header untouched if nothing changed, so that the sources
+    # including it are not rebuilt every time.
+    if os.path.exists(embedded_header):
+        with open(embedded_header) as f:
+            if f.read() == content:
+                return
+    with open(embedded_header, "w") as f:
+        f.write(content)
+
+
+def compile_shader(command, output_path):
+    """Run one compiler command. A stale .spv of an older version of the
+    shader must never be picked up, so it is removed first, and a failure
+    (including a missing compiler) is reported instead of ignored.
+
+    Returns True on success.
+    """
+    if os.path.exists(output_path):
+        os.remove(output_path)
+    try:
+        result = subprocess.run(command)
+    except FileNotFoundError:
+        print(f"error: {command[0]} not found, it is needed to compile "
+              f"{output_path}", file=sys.stderr)
+        return False
+    if result.returncode != 0 or not os.path.exists(output_path):
+        print(f"error: failed to compile {output_path}", file=sys.stderr)
+        return False
+    return True
+
 
 if __name__ == "__main__":
     os.makedirs(output_folder, exist_ok=True)
+    failed = []
 
     # Compile .cl shaders to .spv
     cl_shaders = [
@@ -29,7 +122,8 @@ if __name__ == "__main__":
             output_path,
         ]
 
-        subprocess.run(clspv_command)
+        if not compile_shader(clspv_command, output_path):
+            failed.append(cl_shader)
 
     # Compile .comp shaders to .spv
     comp_shaders = [
@@ -51,6 +145,19 @@ if __name__ == "__main__":
             output_path,
         ]
 
-        subprocess.run(glslang_command)
+        if not compile_shader(glslang_command, output_path):
+            failed.append(comp_shader)
+
+    # The kernels' push constants change with their sources, running with the
+    # binaries of older sources is worse than not building at all
+    if failed:
+        print(f"error: {len(failed)} shader(s) failed: {', '.join(failed)}",
+              file=sys.stderr)
+        sys.exit(1)
+
+    write_embedded_header(
+        [(os.path.splitext(s)[0] + ".spv", True) for s in cl_shaders]
+        + [(os.path.splitext(s)[0] + ".spv", False) for s in comp_shaders]
+    )
 
     print("Shaders compiled successfully.")
@@ -23,7 +23,7 @@ int main(int argc, char **argv) {
                                params,
                                threads_per_block,
                                true,
-                               make_clspv_push_const(n));
+                               make_clspv_push_const(uint32_t{n}));
 
   const auto seq = engine.sequence();
 
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <random>
@@ -7,13 +8,14 @@
 #include "common.hpp"
 #include "core/engine.hpp"
 #include "helpers.hpp"
-#include "morton.hpp"
+#include "hilbert.hpp"
+#include "radix_tree.hpp"
 
-struct InnerNode {
-  int32_t delta;
-  int32_t left;
-  int32_t right;
-  int32_t parent;
+using brt::InnerNode;
+
+struct UpdatePushConstants {
+  uint32_t num_keys;
+  uint32_t num_nodes;
 };
 
 std::ostream &operator<<(std::ostream &os, const InnerNode &node) {
@@ -31,6 +33,9 @@ std::ostream &operator<<(std::ostream &os, const InnerNode &node) {
 int main(int argc, char **argv) {
   setup_log_level("debug");
 
+  // Order of the points, "morton" (default) or "hilbert"
+  const auto curve = sfc::parse_curve(argc > 1 ? argv[1] : "morton");
+
   constexpr auto n = 1024;
 
   // Computation start here
@@ -47,50 +52,69 @@ int main(int argc, char **argv) {
     return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
   });
 
-  // compute and sort morton
+  // compute and sort the curve keys
 
-  auto u_morton_keys = std::vector<glm::uint>(n);
-  morton::foo(in_data.data(), u_morton_keys.data(), n, min_coord, range);
+  auto point_codes = std::vector<glm::uint>(n);
+  sfc::encode_points(
+      curve, in_data.data(), point_codes.data(), n, min_coord, range);
 
-  std::sort(u_morton_keys.begin(), u_morton_keys.end());
+  // Keeps the sorted keys in sync with the points, for the updates. Equal
+  // keys are kept, each point is a leaf of the tree.
+  brt::DynamicKeys dynamic_keys;
+  dynamic_keys.reset(point_codes);
 
-  const auto last_unique_it =
-      std::unique(u_morton_keys.begin(), u_morton_keys.end());
+  const auto &sorted_keys = dynamic_keys.sorted_keys();
+  constexpr auto num_keys = static_cast<uint32_t>(n);
 
-  const auto num_unique_keys =
-      std::distance(u_morton_keys.begin(), last_unique_it);
-  const auto num_brt_nodes = num_unique_keys - 1;
-
-  spdlog::info("num_unique_keys: {}", num_unique_keys);
+  spdlog::info("num_keys: {} ({} order)", num_keys, sfc::to_string(curve));
   // peek the first 10 keys
   for (int i = 0; i < 10; ++i) {
-    std::cout << i << ":\t" << u_morton_keys[i] << std::endl;
+    std::cout << i << ":\t" << sorted_keys[i] << std::endl;
   }
 
   //
   const auto morton_key_buf = engine.buffer(n * sizeof(uint32_t));
   const auto inner_nodes_buf = engine.buffer(n * sizeof(InnerNode));
 
-  // morton_key_buf->tmp_write_data(u_morton_keys.data(), n * sizeof(uint32_t));
+  // morton_key_buf->tmp_write_data(sorted_keys.data(), n * sizeof(uint32_t));
 
   auto ptr = morton_key_buf->get_data_mut<uint32_t>();
-  std::ranges::copy(u_morton_keys, ptr);
+  std::ranges::copy(sorted_keys, ptr);
 
   inner_nodes_buf->tmp_fill_zero(n * sizeof(InnerNode));
 
-  std::vector params{morton_key_buf, inner_nodes_buf};
+  // The number of keys may come from an earlier GPU stage (e.g. one that
+  // drops points). Here the host writes it, but everything below only reads it
+  // on the device, so no readback is needed.
+  const auto num_keys_buf = engine.buffer(sizeof(uint32_t));
+  *num_keys_buf->get_data_mut<uint32_t>() = num_keys;
+
+  std::vector params{morton_key_buf, inner_nodes_buf, num_keys_buf};
 
   constexpr uint32_t threads_per_block = 256;
 
-  auto algo = engine.algorithm("build_radix_tree.spv",
+  auto algo = engine.algorithm("build_radix_tree_indirect.spv",
                                params,
                                threads_per_block,
-                               true,
-                               make_clspv_push_const(n));
+                               true);
+
+  // 'num_keys - 1' inner nodes
+  const auto dispatch_args_buf = engine.dispatch_args_buffer();
+  auto args_algo = engine.dispatch_args_algorithm(
+      *algo, num_keys_buf, dispatch_args_buf, -1);
 
   const auto seq = engine.sequence();
 
-  seq->simple_record_commands(*algo, n);
+  seq->cmd_begin();
+  args_algo->record_bind_core(seq->get_handle());
+  args_algo->record_bind_push(seq->get_handle());
+  args_algo->record_dispatch_tmp(seq->get_handle(), 1);
+  seq->record_indirect_barrier();
+  algo->record_bind_core(seq->get_handle());
+  algo->record_bind_push(seq->get_handle());
+  algo->record_dispatch_indirect(seq->get_handle(), *dispatch_args_buf);
+  seq->cmd_end();
+
   seq->launch_kernel_async();
 
   // ... do something else
@@ -104,5 +128,90 @@ int main(int argc, char **argv) {
     std::cout << i << ":\n" << out[i] << std::endl;
   }
 
+  // ---------------------------------------------------------------------------
+  //  Dynamic points: each frame a few points move a little. Only those are
+  //  re-encoded, their keys merged into the sorted array, and only the inner
+  //  nodes that can change are rebuilt.
+  // ---------------------------------------------------------------------------
+
+  const auto node_indices_buf = engine.buffer(n * sizeof(uint32_t));
+  std::vector update_params{morton_key_buf, inner_nodes_buf, node_indices_buf};
+  auto update_algo =
+      engine.algorithm("build_radix_tree_update.spv",
+                       update_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(UpdatePushConstants{}));
+
+  constexpr auto num_frames = 8;
+  constexpr auto num_moved = n / 50;
+  std::uniform_int_distribution<uint32_t> pick(0, n - 1);
+  std::uniform_real_distribution jitter(-2.0f, 2.0f);
+
+  std::vector<uint32_t> moved_ids(num_moved);
+  std::vector<glm::vec4> moved_points(num_moved);
+  std::vector<glm::uint> moved_codes(num_moved);
+
+  for (int frame = 0; frame < num_frames; ++frame) {
+    for (int c = 0; c < num_moved; ++c) {
+      auto &p = in_data[moved_ids[c] = pick(gen)];
+      p.x = std::clamp(p.x + jitter(gen), min_coord, max_coord - 1.0f);
+      p.y = std::clamp(p.y + jitter(gen), min_coord, max_coord - 1.0f);
+      p.z = std::clamp(p.z + jitter(gen), min_coord, max_coord - 1.0f);
+      moved_points[c] = p;
+    }
+    sfc::encode_points(curve,
+                       moved_points.data(),
+                       moved_codes.data(),
+                       num_moved,
+                       min_coord,
+                       range);
+
+    const auto change = dynamic_keys.update(moved_ids, moved_codes);
+    if (change.empty()) {
+      spdlog::info("frame {}: no key changed", frame);
+      continue;
+    }
+
+    // The current tree (its parent links) tells which nodes depend on the
+    // changed keys
+    const auto affected = brt::affected_nodes(out, num_keys, change.ranges);
+
+    for (const auto &[first, last] : change.ranges) {
+      morton_key_buf->tmp_write_data(&sorted_keys[first],
+                                     (last - first + 1) * sizeof(uint32_t),
+                                     first * sizeof(uint32_t));
+    }
+    node_indices_buf->tmp_write_data(affected.data(),
+                                     affected.size() * sizeof(uint32_t));
+    const auto uploaded = morton_key_buf->flush_dirty();
+    node_indices_buf->flush_dirty();
+
+    const auto num_nodes = static_cast<uint32_t>(affected.size());
+    update_algo->set_push_constants(make_clspv_push_const(
+        UpdatePushConstants{.num_keys = num_keys, .num_nodes = num_nodes}));
+    seq->simple_record_commands(*update_algo, num_nodes);
+
+    spdlog::info(
+        "frame {}: {} key windows, {} of {} nodes rebuilt, {} bytes flushed",
+        frame,
+        change.ranges.size(),
+        num_nodes,
+        num_keys - 1,
+        uploaded);
+
+    seq->launch_kernel_async();
+    seq->sync();
+
+    // Check against a full build on the CPU
+    std::vector<InnerNode> expected(num_keys);
+    std::memcpy(expected.data(), out, num_keys * sizeof(InnerNode));
+    brt::build(sorted_keys.data(), expected.data(), num_keys);
+    if (std::memcmp(expected.data(), out, num_keys * sizeof(InnerNode)) != 0) {
+      spdlog::error("frame {}: radix tree differs from a full rebuild", frame);
+      return EXIT_FAILURE;
+    }
+  }
+
   return EXIT_SUCCESS;
 }
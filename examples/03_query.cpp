@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "core/engine.hpp"
+#include "helpers.hpp"
+#include "hilbert.hpp"
+#include "radix_tree.hpp"
+#include "radix_tree_query.hpp"
+
+// Must match the POD arguments of the radix_tree_*.cl kernels
+struct KnnPushConstants {
+  uint32_t num_queries;
+  uint32_t num_leaves;
+  uint32_t k;
+  float max_radius;
+};
+
+struct RadiusPushConstants {
+  uint32_t num_queries;
+  uint32_t num_leaves;
+  uint32_t max_results;
+  float radius;
+};
+
+namespace {
+
+double elapsed_ms(const std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+void record(const core::Sequence &seq,
+            const core::Algorithm &algo,
+            const uint32_t n) {
+  algo.record_bind_core(seq.get_handle());
+  algo.record_bind_push(seq.get_handle());
+  algo.record_dispatch_tmp(seq.get_handle(), n);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  setup_log_level("info");
+
+  // Order of the points, "morton" (default) or "hilbert", then the k of kNN
+  const auto curve = sfc::parse_curve(argc > 1 ? argv[1] : "morton");
+  const auto k = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 8u;
+  brt::check_knn_k(k);  // the kernel only has room for kMaxK
+
+  constexpr uint32_t n = 1 << 18;
+  constexpr uint32_t num_queries = 1 << 16;
+  constexpr uint32_t max_results = 64;
+  constexpr auto radius = 8.0f;
+  constexpr auto no_limit = std::numeric_limits<float>::infinity();
+
+  core::ComputeEngine engine{};
+
+  // prepare data
+  constexpr auto min_coord = 0.0f;
+  constexpr auto max_coord = 1024.0f;
+  constexpr auto range = max_coord - min_coord;
+  std::default_random_engine gen(114514);
+  std::uniform_real_distribution dis(min_coord, range);
+  std::vector<glm::vec4> in_data(n);
+  std::ranges::generate(in_data, [&] {
+    return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
+  });
+  std::vector<glm::vec4> queries(num_queries);
+  std::ranges::generate(queries, [&] {
+    return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
+  });
+
+  // Points grouped by curve key, one leaf per unique key
+  auto codes = std::vector<glm::uint>(n);
+  sfc::encode_points(curve, in_data.data(), codes.data(), n, min_coord, range);
+  const auto sorted = brt::sort_points(in_data, codes);
+  const auto num_leaves = static_cast<uint32_t>(sorted.keys.size());
+  spdlog::info(
+      "{} points, {} leaves ({} order)", n, num_leaves, sfc::to_string(curve));
+
+  const auto upload = [&](const auto &v) {
+    const auto bytes = v.size() * sizeof(v[0]);
+    auto buf = engine.buffer(bytes);
+    buf->tmp_write_data(v.data(), bytes);
+    buf->flush_dirty();
+    return buf;
+  };
+  const auto keys_buf = upload(sorted.keys);
+  const auto offsets_buf = upload(sorted.leaf_offsets);
+  const auto points_buf = upload(sorted.points);
+  const auto ids_buf = upload(sorted.point_ids);
+  const auto queries_buf = upload(queries);
+
+  const auto nodes_buf = engine.buffer(num_leaves * sizeof(brt::InnerNode));
+  const auto parents_buf = engine.buffer(num_leaves * sizeof(int32_t));
+  const auto visits_buf = engine.buffer(num_leaves * sizeof(uint32_t));
+  const auto aabbs_buf =
+      engine.buffer((2 * num_leaves - 1) * sizeof(brt::Aabb));
+
+  const auto knn_ids_buf = engine.buffer(num_queries * k * sizeof(uint32_t));
+  const auto knn_dist2_buf = engine.buffer(num_queries * k * sizeof(float));
+  const auto radius_ids_buf =
+      engine.buffer(size_t{num_queries} * max_results * sizeof(uint32_t));
+  const auto radius_counts_buf =
+      engine.buffer(num_queries * sizeof(uint32_t));
+
+  constexpr uint32_t threads_per_block = 256;
+
+  // Tree, leaf parents, boxes
+  std::vector build_params{keys_buf, nodes_buf};
+  const auto build_algo =
+      engine.algorithm("build_radix_tree.spv",
+                       build_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(uint32_t{num_leaves}));
+  std::vector parents_params{nodes_buf, parents_buf, visits_buf};
+  const auto parents_algo =
+      engine.algorithm("radix_tree_leaf_parents.spv",
+                       parents_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(uint32_t{num_leaves}));
+  std::vector aabbs_params{
+      nodes_buf, offsets_buf, points_buf, parents_buf, visits_buf, aabbs_buf};
+  const auto aabbs_algo =
+      engine.algorithm("radix_tree_aabbs.spv",
+                       aabbs_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(uint32_t{num_leaves}));
+
+  // Queries
+  std::vector knn_params{nodes_buf,
+                         aabbs_buf,
+                         offsets_buf,
+                         points_buf,
+                         ids_buf,
+                         queries_buf,
+                         knn_ids_buf,
+                         knn_dist2_buf};
+  const auto knn_algo =
+      engine.algorithm("radix_tree_knn.spv",
+                       knn_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(KnnPushConstants{
+                           num_queries, num_leaves, k, no_limit}));
+  std::vector radius_params{nodes_buf,
+                            aabbs_buf,
+                            offsets_buf,
+                            points_buf,
+                            ids_buf,
+                            queries_buf,
+                            radius_ids_buf,
+                            radius_counts_buf};
+  const auto radius_algo =
+      engine.algorithm("radix_tree_radius.spv",
+                       radius_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(RadiusPushConstants{
+                           num_queries, num_leaves, max_results, radius}));
+
+  const auto seq = engine.sequence();
+
+  seq->cmd_begin();
+  record(*seq, *build_algo, num_leaves - 1);
+  seq->record_compute_barrier();
+  record(*seq, *parents_algo, num_leaves - 1);
+  seq->record_compute_barrier();
+  record(*seq, *aabbs_algo, num_leaves);
+  seq->cmd_end();
+  seq->launch_kernel_async();
+  seq->sync();
+
+  // Command buffers are one time submit, so record again for every run
+  const auto run_gpu = [&](const core::Algorithm &algo) {
+    seq->cmd_begin();
+    record(*seq, algo, num_queries);
+    seq->cmd_end();
+    const auto start = std::chrono::high_resolution_clock::now();
+    seq->launch_kernel_async();
+    seq->sync();
+    return elapsed_ms(start);
+  };
+  const auto qps = [](const double ms) { return num_queries / (ms * 1e-3); };
+
+  run_gpu(*knn_algo);  // warm up
+  const auto gpu_knn_ms = run_gpu(*knn_algo);
+  const auto gpu_radius_ms = run_gpu(*radius_algo);
+
+  // Multithreaded CPU reference over the tree built on the GPU
+  nodes_buf->invalidate();
+  aabbs_buf->invalidate();
+  knn_dist2_buf->invalidate();
+  radius_counts_buf->invalidate();
+  const brt::TreeView tree{
+      reinterpret_cast<const brt::InnerNode *>(nodes_buf->get_data()),
+      reinterpret_cast<const brt::Aabb *>(aabbs_buf->get_data()),
+      sorted.leaf_offsets.data(),
+      sorted.points.data(),
+      sorted.point_ids.data(),
+      num_leaves};
+
+  // The boxes are exact (min / max only), so they must match bit for bit
+  std::vector<brt::InnerNode> cpu_nodes(num_leaves);
+  brt::build(sorted.keys.data(), cpu_nodes.data(), num_leaves);
+  const auto cpu_aabbs = brt::build_aabbs(cpu_nodes.data(),
+                                          num_leaves,
+                                          sorted.leaf_offsets.data(),
+                                          sorted.points.data());
+  if (std::memcmp(cpu_aabbs.data(),
+                  tree.aabbs,
+                  cpu_aabbs.size() * sizeof(brt::Aabb)) != 0) {
+    spdlog::error("node boxes differ from the CPU reference");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint32_t> cpu_knn_ids(num_queries * k);
+  std::vector<float> cpu_knn_dist2(num_queries * k);
+  auto start = std::chrono::high_resolution_clock::now();
+  brt::knn_batch(tree,
+                 queries,
+                 k,
+                 no_limit,
+                 cpu_knn_ids.data(),
+                 cpu_knn_dist2.data());
+  const auto cpu_knn_ms = elapsed_ms(start);
+
+  std::vector<uint32_t> cpu_radius_ids(size_t{num_queries} * max_results);
+  std::vector<uint32_t> cpu_radius_counts(num_queries);
+  start = std::chrono::high_resolution_clock::now();
+  brt::radius_batch(tree,
+                    queries,
+                    radius,
+                    max_results,
+                    cpu_radius_ids.data(),
+                    cpu_radius_counts.data());
+  const auto cpu_radius_ms = elapsed_ms(start);
+
+  // The GPU may contract the distances into FMAs, so compare loosely
+  const auto gpu_dist2 =
+      reinterpret_cast<const float *>(knn_dist2_buf->get_data());
+  uint32_t knn_mismatches = 0;
+  for (uint32_t i = 0; i < num_queries * k; ++i) {
+    if (std::abs(gpu_dist2[i] - cpu_knn_dist2[i]) >
+        1e-3f * std::max(1.0f, cpu_knn_dist2[i])) {
+      ++knn_mismatches;
+    }
+  }
+  const auto gpu_counts =
+      reinterpret_cast<const uint32_t *>(radius_counts_buf->get_data());
+  uint32_t radius_mismatches = 0;
+  for (uint32_t q = 0; q < num_queries; ++q) {
+    radius_mismatches += gpu_counts[q] != cpu_radius_counts[q];
+  }
+
+  spdlog::info("kNN (k = {}): GPU {:.0f} queries/s, CPU {:.0f} queries/s, "
+               "{} mismatches",
+               k,
+               qps(gpu_knn_ms),
+               qps(cpu_knn_ms),
+               knn_mismatches);
+  spdlog::info("radius ({}): GPU {:.0f} queries/s, CPU {:.0f} queries/s, "
+               "{} mismatches",
+               radius,
+               qps(gpu_radius_ms),
+               qps(cpu_radius_ms),
+               radius_mismatches);
+
+  return knn_mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
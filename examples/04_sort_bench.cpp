@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include "radix_sort.hpp"
+
+// morton::radix_sort against std::sort, keys only and with uint32 payloads.
+//
+//   sort_bench [max_keys]   (default 100M)
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+double elapsed_ms(const Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+template <typename Key>
+std::vector<Key> random_keys(const size_t n, const Key mask) {
+  std::mt19937_64 gen(114514);  // NOLINT(cert-msc51-cpp)
+  std::vector<Key> keys(n);
+  std::ranges::generate(keys, [&] { return static_cast<Key>(gen()) & mask; });
+  return keys;
+}
+
+template <typename Key>
+void bench(const std::string &name,
+           const size_t n,
+           const Key mask,
+           core::ThreadPool &pool) {
+  const auto input = random_keys(n, mask);
+
+  auto expected = input;
+  auto start = Clock::now();
+  std::ranges::sort(expected);
+  const auto std_ms = elapsed_ms(start);
+
+  auto keys = input;
+  start = Clock::now();
+  morton::radix_sort(keys, {}, pool);
+  const auto radix_ms = elapsed_ms(start);
+  const bool keys_ok = keys == expected;
+
+  // Payload: the input index of every key, as when sorting point indices
+  keys = input;
+  std::vector<uint32_t> payload(n);
+  std::iota(payload.begin(), payload.end(), 0u);
+  start = Clock::now();
+  morton::radix_sort(keys, payload, pool);
+  const auto payload_ms = elapsed_ms(start);
+  const bool payload_ok =
+      keys == expected &&
+      std::ranges::all_of(std::views::iota(size_t{0}, n),
+                          [&](const size_t i) {
+                            return input[payload[i]] == keys[i];
+                          });
+
+  const auto mkeys = [n](const double ms) { return n / (ms * 1e3); };
+  std::cout << std::left << std::setw(8) << name << std::right
+            << std::setw(12) << n << std::fixed << std::setprecision(1)
+            << std::setw(12) << mkeys(std_ms) << std::setw(12)
+            << mkeys(radix_ms) << std::setw(12) << mkeys(payload_ms)
+            << std::setw(9) << std_ms / radix_ms << "x"
+            << ((keys_ok && payload_ok) ? "" : "  MISMATCH") << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t max_keys = argc > 1 ? std::stoull(argv[1]) : 100'000'000;
+
+  core::ThreadPool pool;
+  std::cout << pool.size() << " threads, Mkeys/s" << std::endl;
+  std::cout << std::left << std::setw(8) << "keys" << std::right
+            << std::setw(12) << "n" << std::setw(12) << "std::sort"
+            << std::setw(12) << "radix" << std::setw(12) << "+payload"
+            << std::setw(10) << "speedup" << std::endl;
+
+  for (size_t n = 1'000'000; n <= max_keys; n *= 10) {
+    // 30 bit morton codes, and full 64 bit keys
+    bench<uint32_t>("u32", n, 0x3FFFFFFFu, pool);
+    bench<uint64_t>("u64", n, ~uint64_t{0}, pool);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "common.hpp"
+#include "core/engine.hpp"
+#include "helpers.hpp"
+#include "morton.hpp"
+#include "radix_tree.hpp"
+
+// Many small point sets, each encoded and turned into its own radix tree.
+// Instead of one Buffer/Algorithm/Sequence and a handful of tiny dispatches
+// per set, the sets are packed into shared buffers with an offsets table and
+// every stage is a single dispatch over all of them.
+
+// Must match the POD arguments of morton32.cl
+struct MortonPushConstants {
+  uint32_t n;
+  float min_coord;
+  float range;
+};
+
+namespace {
+
+double elapsed_ms(const std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  setup_log_level("info");
+
+  constexpr uint32_t num_problems = 256;
+  constexpr uint32_t min_points = 1'000;
+  constexpr uint32_t max_points = 50'000;
+  constexpr uint32_t threads_per_block = 256;
+
+  core::ComputeEngine engine{};
+
+  // Point sets of random sizes, each in its own cube
+  std::default_random_engine gen(114514);
+  std::uniform_int_distribution<uint32_t> dis_size(min_points, max_points);
+  std::uniform_real_distribution dis_unit(0.0f, 1.0f);
+
+  std::vector<uint32_t> sizes(num_problems);
+  std::ranges::generate(sizes, [&] { return dis_size(gen); });
+  const auto offsets = brt::make_offsets(sizes);
+  const auto num_points = offsets.back();
+
+  std::vector<float> cubes(2 * num_problems);
+  std::vector<glm::vec4> points(num_points);
+  for (uint32_t p = 0; p < num_problems; ++p) {
+    const auto min_coord = 100.0f * dis_unit(gen);
+    const auto range = 1.0f + 1000.0f * dis_unit(gen);
+    cubes[2 * p] = min_coord;
+    cubes[2 * p + 1] = range;
+    for (auto i = offsets[p]; i < offsets[p + 1]; ++i) {
+      points[i] = {min_coord + range * dis_unit(gen),
+                   min_coord + range * dis_unit(gen),
+                   min_coord + range * dis_unit(gen),
+                   0.0f};
+    }
+  }
+  spdlog::info("{} point sets, {} points", num_problems, num_points);
+
+  const auto upload = [&](const auto &v) {
+    const auto bytes = v.size() * sizeof(v[0]);
+    auto buf = engine.buffer(bytes);
+    buf->tmp_write_data(v.data(), bytes);
+    buf->flush_dirty();
+    return buf;
+  };
+  const auto points_buf = upload(points);
+  const auto offsets_buf = upload(offsets);
+  const auto cubes_buf = upload(cubes);
+  const auto codes_buf = engine.buffer(num_points * sizeof(glm::uint));
+
+  const auto seq = engine.sequence();
+
+  // ---------- One dispatch per set, as before ----------
+  std::vector<std::shared_ptr<core::Algorithm>> per_set_algos;
+  for (uint32_t p = 0; p < num_problems; ++p) {
+    const auto in_buf = upload(std::vector<glm::vec4>(
+        points.begin() + offsets[p], points.begin() + offsets[p + 1]));
+    std::vector params{in_buf, engine.buffer(sizes[p] * sizeof(glm::uint))};
+    per_set_algos.push_back(
+        engine.algorithm("morton32.spv",
+                         params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(MortonPushConstants{
+                             sizes[p], cubes[2 * p], cubes[2 * p + 1]})));
+  }
+  // Recorded up front, the batched run below does not time recording either
+  std::vector<std::shared_ptr<core::Sequence>> per_set_seqs;
+  for (uint32_t p = 0; p < num_problems; ++p) {
+    per_set_seqs.push_back(engine.sequence());
+    per_set_seqs.back()->simple_record_commands(*per_set_algos[p], sizes[p]);
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  for (const auto &per_set_seq : per_set_seqs) {
+    per_set_seq->launch_kernel_async();
+    per_set_seq->sync();
+  }
+  const auto per_set_ms = elapsed_ms(start);
+
+  // ---------- All sets in one dispatch ----------
+  std::vector morton_params{points_buf, codes_buf, offsets_buf, cubes_buf};
+  const auto morton_algo =
+      engine.algorithm("morton32_batched.spv",
+                       morton_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(uint32_t{num_problems}));
+
+  seq->simple_record_commands(*morton_algo, num_points);  // warm up
+  seq->launch_kernel_async();
+  seq->sync();
+
+  seq->simple_record_commands(*morton_algo, num_points);
+  start = std::chrono::high_resolution_clock::now();
+  seq->launch_kernel_async();
+  seq->sync();
+  const auto batched_ms = elapsed_ms(start);
+
+  std::vector<glm::uint> cpu_codes(num_points);
+  morton::foo_batched(points.data(),
+                      cpu_codes.data(),
+                      offsets.data(),
+                      cubes.data(),
+                      num_problems);
+  codes_buf->invalidate();
+  const auto codes =
+      reinterpret_cast<const glm::uint *>(codes_buf->get_data());
+  const bool codes_ok = std::equal(cpu_codes.begin(), cpu_codes.end(), codes);
+
+  spdlog::info("morton32: {} dispatches {:.3f} ms, 1 batched dispatch "
+               "{:.3f} ms, matches CPU: {}",
+               num_problems,
+               per_set_ms,
+               batched_ms,
+               codes_ok);
+
+  // ---------- Trees of all sets in one dispatch ----------
+  // Sorted per set on the host, duplicates and offsets stay as they are
+  auto keys = std::vector<uint32_t>(codes, codes + num_points);
+  brt::sort_segments(keys, offsets);
+  const auto num_keys = num_points;
+
+  const auto keys_buf = upload(keys);
+  const auto nodes_buf = engine.buffer(num_keys * sizeof(brt::InnerNode));
+
+  std::vector build_params{keys_buf, nodes_buf, offsets_buf};
+  const auto build_algo =
+      engine.algorithm("build_radix_tree_batched.spv",
+                       build_params,
+                       threads_per_block,
+                       true,
+                       make_clspv_push_const(uint32_t{num_problems}));
+
+  seq->simple_record_commands(*build_algo, num_keys);
+  start = std::chrono::high_resolution_clock::now();
+  seq->launch_kernel_async();
+  seq->sync();
+  const auto build_ms = elapsed_ms(start);
+
+  // Compare only the used slots, the last one of every set stays unwritten
+  std::vector<brt::InnerNode> cpu_nodes(num_keys);
+  brt::build_batched(keys.data(), cpu_nodes.data(), offsets);
+  nodes_buf->invalidate();
+  const auto nodes =
+      reinterpret_cast<const brt::InnerNode *>(nodes_buf->get_data());
+  uint32_t mismatches = 0;
+  for (uint32_t p = 0; p < num_problems; ++p) {
+    for (auto i = offsets[p]; i + 1 < offsets[p + 1]; ++i) {
+      const auto &a = nodes[i];
+      const auto &b = cpu_nodes[i];
+      // The root has no parent
+      mismatches += a.delta != b.delta || a.left != b.left ||
+                    a.right != b.right ||
+                    (i != offsets[p] && a.parent != b.parent);
+    }
+  }
+  spdlog::info("build_radix_tree: {} trees, {} keys, 1 batched dispatch "
+               "{:.3f} ms, {} mismatches",
+               num_problems,
+               num_keys,
+               build_ms,
+               mismatches);
+
+  return codes_ok && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
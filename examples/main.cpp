@@ -1,13 +1,42 @@
 #include <CLI/CLI.hpp>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
 #include <iostream>
+#include <latch>
 #include <random>
+#include <string_view>
 #include <vector>
 
 #include "common.hpp"
+#include "core/completion_reactor.hpp"
 #include "core/engine.hpp"
+#include "core/stream_executor.hpp"
+#include "core/thread_pool.hpp"
 #include "helpers.hpp"
+#include "hilbert.hpp"
 #include "morton.hpp"
+#include "radix_tree_query.hpp"
+
+// Fire and forget coroutine, for example 9
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Must match the POD arguments of morton32.cl (and morton32_histogram.cl)
+struct MortonPushConstants {
+  uint32_t n;
+  float min_coord;
+  float range;
+};
 
 int main(int argc, char **argv) {
   CLI::App app{"Vulkan Compute Example"};
@@ -22,16 +51,85 @@ int main(int argc, char **argv) {
   int which_example;
   app.add_option("-e,--example",
                  which_example,
-                 "Which example to run (0: float doubler, 1: morton code)")
+                 "Which example to run (0: float doubler, 1: morton code, 2: "
+                 "radix sort, 3: specialized GLSL radix sort, 4: streaming "
+                 "morton code, 5: morton code fused with the first sort "
+                 "pass histogram, 6: morton code with bounds computed on the "
+                 "device, 7: parallel recording of secondary command "
+                 "buffers, 8: morton code of compact input layouts, 9: "
+                 "coroutines awaiting GPU work, 10: radix tree build on "
+                 "transient buffers sharing memory)")
       ->default_val(0);
 
+  bool autotune = false;
+  app.add_flag("-t,--autotune",
+               autotune,
+               "Autotune the workgroup size of the kernel and save it to the "
+               "device's tuning profile");
+
+  bool warm_up = false;
+  app.add_flag("-w,--warm-up",
+               warm_up,
+               "Compile all embedded pipelines in parallel at startup");
+
+  bool validation = false;
+  app.add_flag("--validation",
+               validation,
+               "Enable the validation layers (always on in debug builds)");
+
+  std::string device_type = "discrete";
+  app.add_option("-d,--device",
+                 device_type,
+                 "Preferred device type (discrete, integrated, cpu)")
+      ->check(CLI::IsMember({"discrete", "integrated", "cpu"}))
+      ->default_val("discrete");
+
+  std::string trace_file;
+  app.add_option("--trace",
+                 trace_file,
+                 "Write host trace spans to this file (Chrome trace JSON), "
+                 "needs a build with tracing enabled");
+
+  std::string stats_json;
+  app.add_option("--stats-json",
+                 stats_json,
+                 "Write compiler statistics, invocation counts and timings of "
+                 "the benchmarked pipelines to this file (example 8)");
+
+  std::string curve_name = "morton";
+  app.add_option("--curve",
+                 curve_name,
+                 "Space-filling curve of the point keys (examples 1 and 10)")
+      ->check(CLI::IsMember({"morton", "hilbert"}))
+      ->default_val("morton");
+
   CLI11_PARSE(app, argc, argv);
 
   setup_log_level(log_level);
+  const auto curve = sfc::parse_curve(curve_name);
 
   constexpr auto n = 1024;
 
-  core::ComputeEngine engine{};
+  core::EngineConfig config;
+  config.enable_validation = config.enable_validation || validation;
+  config.device_type = device_type == "cpu" ? vkb::PreferredDeviceType::cpu
+                       : device_type == "integrated"
+                           ? vkb::PreferredDeviceType::integrated
+                           : vkb::PreferredDeviceType::discrete;
+  config.desired_features = {
+      .storage_buffer_16bit = true,
+      .subgroup_ops = true,
+      .buffer_device_address = true,
+      .timeline_semaphores = true,
+      .pipeline_statistics_query = true,
+      .pipeline_executable_info = true,
+      .shader_int64 = true,
+  };
+
+  core::ComputeEngine engine(config);
+  if (warm_up) {
+    engine.warm_up_pipelines();
+  }
 
   // ---------- Example A ------------
   if (which_example == 0) {
@@ -49,7 +147,15 @@ int main(int argc, char **argv) {
                                  params,
                                  threads_per_block,
                                  true,
-                                 make_clspv_push_const(n));
+                                 make_clspv_push_const(uint32_t{n}));
+
+    // Any workgroup size works for this kernel, so let it be tuned
+    engine.enable_tuning(*algo);
+    if (autotune) {
+      engine.autotune(*algo, n, engine.workgroup_candidates());
+      engine.save_tuning_profile();
+    }
+    algo->tune_for(n);
 
     const auto seq = engine.sequence();
 
@@ -96,11 +202,23 @@ int main(int argc, char **argv) {
     constexpr uint32_t threads_per_block = 256;
 
     const auto algo =
-        engine.algorithm("morton32.spv",
+        engine.algorithm(sfc::kernel_name(curve),
                          params,
                          threads_per_block,
                          true,
-                         make_clspv_push_const(n, min_coord, range));
+                         make_clspv_push_const(MortonPushConstants{
+                             .n = n,
+                             .min_coord = min_coord,
+                             .range = range,
+                         }));
+
+    // Any workgroup size works for this kernel, so let it be tuned
+    engine.enable_tuning(*algo);
+    if (autotune) {
+      engine.autotune(*algo, n, engine.workgroup_candidates());
+      engine.save_tuning_profile();
+    }
+    algo->tune_for(n);
 
     const auto seq = engine.sequence();
 
@@ -112,7 +230,8 @@ int main(int argc, char **argv) {
     seq->sync();
 
     auto cpu_out = std::vector<glm::uint>(n);
-    morton::foo(in_data.data(), cpu_out.data(), n, min_coord, range);
+    sfc::encode_points(
+        curve, in_data.data(), cpu_out.data(), n, min_coord, range);
 
     const auto in = reinterpret_cast<const glm::vec4 *>(in_buf->get_data());
     const auto out = reinterpret_cast<const glm::uint *>(out_but->get_data());
@@ -120,6 +239,43 @@ int main(int argc, char **argv) {
       std::cout << i << ":\t" << in[i] << "\t-\t" << out[i] << "\t("
                 << cpu_out[i] << ")" << std::endl;
     }
+
+    // The 63 bit keys, for scenes where 10 bits per axis are too coarse. Only
+    // the Hilbert curve has a kernel for them, and it needs shaderInt64.
+    if (curve == sfc::Curve::kHilbert && !engine.get_features().shader_int64) {
+      spdlog::info("Skipping the 63 bit keys, shaderInt64 is not enabled");
+    } else if (curve == sfc::Curve::kHilbert) {
+      const auto out64_buf = engine.buffer(n * sizeof(uint64_t));
+      std::vector params64{in_buf, out64_buf};
+      const auto algo64 =
+          engine.algorithm(sfc::kernel_name64(curve, engine.get_features()),
+                           params64,
+                           threads_per_block,
+                           true,
+                           make_clspv_push_const(MortonPushConstants{
+                               .n = n,
+                               .min_coord = min_coord,
+                               .range = range,
+                           }));
+      seq->simple_record_commands(*algo64, n);
+      seq->launch_kernel_async();
+      seq->sync();
+
+      auto cpu_out64 = std::vector<uint64_t>(n);
+      hilbert::foo64(in_data.data(), cpu_out64.data(), n, min_coord, range);
+
+      out64_buf->invalidate();
+      const auto out64 =
+          reinterpret_cast<const uint64_t *>(out64_buf->get_data());
+      int mismatches = 0;
+      for (int i = 0; i < n; ++i) {
+        mismatches += out64[i] != cpu_out64[i];
+      }
+      spdlog::info("{}: {} of {} keys differ from the CPU",
+                   sfc::kernel_name64(curve, engine.get_features()),
+                   mismatches,
+                   n);
+    }
   }
 
   if (which_example == 2) {
@@ -144,7 +300,7 @@ int main(int argc, char **argv) {
                                        params,
                                        threads_per_block,
                                        true,
-                                       make_clspv_push_const(n));
+                                       make_clspv_push_const(uint32_t{n}));
 
     const auto seq = engine.sequence();
 
@@ -169,6 +325,627 @@ int main(int argc, char **argv) {
     // }
   }
 
+  // ---------- Example D ------------
+  if (which_example == 3) {
+    const auto in_buf = engine.buffer(n * sizeof(uint32_t));
+    const auto out_buf = engine.buffer(n * sizeof(uint32_t));
+
+    std::vector<uint32_t> in_data(n);
+    std::iota(in_data.begin(), in_data.end(), 0);
+    std::reverse(in_data.begin(), in_data.end());
+
+    in_buf->tmp_write_data(in_data.data(), n * sizeof(uint32_t));
+    out_buf->tmp_fill_zero(n * sizeof(uint32_t));
+
+    std::vector params{in_buf, out_buf};
+
+    // A single workgroup sorts everything. 4 passes of 8 bits each; the
+    // number of bins follows from the bits per pass.
+    constexpr uint32_t threads_per_block = 256;
+    const auto spec = core::SpecConstants()
+                          .set(3, 8u)  // BITS_PER_ITERATION
+                          .set(4, engine.get_subgroup_size());
+
+    const auto algo = engine.algorithm("tmp_sort.spv",
+                                       params,
+                                       threads_per_block,
+                                       false,
+                                       core::PushConstants(uint32_t{n}),
+                                       spec);
+
+    const auto seq = engine.sequence();
+    seq->simple_record_commands(*algo, threads_per_block);
+    seq->launch_kernel_async();
+    seq->sync();
+
+    // 4 passes, so the result ends up back in the input buffer
+    const auto out = in_buf->get_data_mut<uint32_t>();
+    std::cout << "sorted: " << std::boolalpha << std::is_sorted(out, out + n)
+              << std::endl;
+  }
+
+  // ---------- Example E ------------
+  if (which_example == 4) {
+    // Much bigger than a chunk, only 'num_slots' chunks live on the device.
+    constexpr size_t n_points = 1 << 24;
+    constexpr uint32_t chunk_size = 1 << 20;
+    constexpr uint32_t num_slots = 3;
+
+    constexpr auto min_coord = 0.0f;
+    constexpr auto range = 1024.0f;
+    std::default_random_engine gen(114514);  // NOLINT(cert-msc51-cpp)
+    std::uniform_real_distribution dis(min_coord, range);
+
+    std::vector<glm::vec4> in_data(n_points);
+    std::ranges::generate(in_data, [&] {
+      return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
+    });
+
+    core::StreamExecutor exec(engine,
+                              "morton32.spv",
+                              256,
+                              sizeof(glm::vec4),
+                              sizeof(glm::uint),
+                              chunk_size,
+                              num_slots,
+                              [&](const uint32_t count) {
+                                return make_clspv_push_const(
+                                    MortonPushConstants{
+                                        .n = count,
+                                        .min_coord = min_coord,
+                                        .range = range,
+                                    });
+                              });
+
+    std::vector<glm::uint> out_data(n_points);
+    exec.run<glm::vec4, glm::uint>(
+        in_data,
+        [&](const size_t offset, const std::span<const glm::uint> codes) {
+          std::ranges::copy(codes, out_data.begin() + offset);
+        });
+
+    auto cpu_out = std::vector<glm::uint>(n_points);
+    morton::foo(in_data.data(), cpu_out.data(), n_points, min_coord, range);
+    std::cout << "matches CPU: " << std::boolalpha << (out_data == cpu_out)
+              << std::endl;
+  }
+
+  // ---------- Example F ------------
+  if (which_example == 5) {
+    constexpr auto min_coord = 0.0f;
+    constexpr auto range = 1024.0f;
+    std::default_random_engine gen(114514);  // NOLINT(cert-msc51-cpp)
+    std::uniform_real_distribution dis(min_coord, range);
+
+    std::vector<glm::vec4> in_data(n);
+    std::ranges::generate(in_data, [&] {
+      return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
+    });
+
+    constexpr uint32_t num_bins = 256;
+    const auto in_buf = engine.buffer(n * sizeof(glm::vec4));
+    const auto codes_buf = engine.buffer(n * sizeof(glm::uint));
+    const auto tmp_buf = engine.buffer(n * sizeof(glm::uint));
+    const auto histogram_buf = engine.buffer(num_bins * sizeof(uint32_t));
+
+    in_buf->tmp_write_data(in_data.data(), n * sizeof(glm::vec4));
+    histogram_buf->tmp_fill_zero(num_bins * sizeof(uint32_t));
+
+    constexpr uint32_t threads_per_block = 256;
+
+    // Writes the codes and counts their lowest byte ...
+    std::vector encode_params{in_buf, codes_buf, histogram_buf};
+    const auto encode_algo =
+        engine.algorithm("morton32_histogram.spv",
+                         encode_params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(MortonPushConstants{
+                             .n = n,
+                             .min_coord = min_coord,
+                             .range = range,
+                         }));
+
+    // ... so the sort starts scattering right away in its first pass
+    std::vector sort_params{codes_buf, tmp_buf, histogram_buf};
+    const auto spec = core::SpecConstants()
+                          .set(3, 8u)  // BITS_PER_ITERATION, must be 8
+                          .set(4, engine.get_subgroup_size());
+    const auto sort_algo = engine.algorithm("tmp_sort_histogram.spv",
+                                            sort_params,
+                                            threads_per_block,
+                                            false,
+                                            core::PushConstants(uint32_t{n}),
+                                            spec);
+
+    const auto seq = engine.sequence();
+    seq->cmd_begin();
+    encode_algo->record_bind_core(seq->get_handle());
+    encode_algo->record_bind_push(seq->get_handle());
+    encode_algo->record_dispatch_tmp(seq->get_handle(), n);
+    seq->record_compute_barrier();
+    sort_algo->record_bind_core(seq->get_handle());
+    sort_algo->record_bind_push(seq->get_handle());
+    sort_algo->record_dispatch_tmp(seq->get_handle(), threads_per_block);
+    seq->cmd_end();
+
+    seq->launch_kernel_async();
+    seq->sync();
+
+    auto cpu_out = std::vector<glm::uint>(n);
+    morton::foo(in_data.data(), cpu_out.data(), n, min_coord, range);
+    std::ranges::sort(cpu_out);
+
+    // 4 passes, so the result ends up back in the codes buffer
+    const auto out = codes_buf->get_data_mut<glm::uint>();
+    std::cout << "matches CPU: " << std::boolalpha
+              << std::equal(cpu_out.begin(), cpu_out.end(), out) << std::endl;
+  }
+
+  // ---------- Example G ------------
+  if (which_example == 6) {
+    // Bounds unknown to the host, and different per axis
+    std::default_random_engine gen(114514);  // NOLINT(cert-msc51-cpp)
+    std::uniform_real_distribution dis_x(-300.0f, 500.0f);
+    std::uniform_real_distribution dis_y(10.0f, 20.0f);
+    std::uniform_real_distribution dis_z(-1.0f, 1.0f);
+
+    std::vector<glm::vec4> in_data(n);
+    std::ranges::generate(in_data, [&] {
+      return glm::vec4{dis_x(gen), dis_y(gen), dis_z(gen), 0.0f};
+    });
+
+    const auto in_buf = engine.buffer(n * sizeof(glm::vec4));
+    const auto bounds_buf = engine.buffer(sizeof(morton::kEmptyBoundsBuffer));
+    const auto out_buf = engine.buffer(n * sizeof(glm::uint));
+
+    in_buf->tmp_write_data(in_data.data(), n * sizeof(glm::vec4));
+    bounds_buf->tmp_write_data(morton::kEmptyBoundsBuffer.data(),
+                               sizeof(morton::kEmptyBoundsBuffer));
+
+    constexpr uint32_t threads_per_block = 256;
+
+    std::vector bounds_params{in_buf, bounds_buf};
+    const auto bounds_algo =
+        engine.algorithm("bounding_box.spv",
+                         bounds_params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(uint32_t{n}));
+
+    std::vector encode_params{in_buf, out_buf, bounds_buf};
+    const auto encode_algo =
+        engine.algorithm("morton32_bounds.spv",
+                         encode_params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(uint32_t{n}));
+
+    // Reduction and encoding back to back, the host never sees the bounds
+    const auto seq = engine.sequence();
+    seq->cmd_begin();
+    bounds_algo->record_bind_core(seq->get_handle());
+    bounds_algo->record_bind_push(seq->get_handle());
+    bounds_algo->record_dispatch_tmp(seq->get_handle(), n);
+    seq->record_compute_barrier();
+    encode_algo->record_bind_core(seq->get_handle());
+    encode_algo->record_bind_push(seq->get_handle());
+    encode_algo->record_dispatch_tmp(seq->get_handle(), n);
+    seq->cmd_end();
+
+    seq->launch_kernel_async();
+    seq->sync();
+
+    const auto bounds = morton::decode_bounds(
+        reinterpret_cast<const glm::uint *>(bounds_buf->get_data()));
+    const auto cpu_bounds = morton::compute_bounds(in_data.data(), n);
+    std::cout << "bounds: " << glm::vec4(bounds.min, 0.0f) << " - "
+              << glm::vec4(bounds.max, 0.0f) << ", matches CPU: "
+              << std::boolalpha
+              << (bounds.min == cpu_bounds.min &&
+                  bounds.max == cpu_bounds.max)
+              << std::endl;
+
+    auto cpu_out = std::vector<glm::uint>(n);
+    morton::foo_bounds(in_data.data(), cpu_out.data(), n, cpu_bounds);
+    const auto out =
+        reinterpret_cast<const glm::uint *>(out_buf->get_data());
+    std::cout << "matches CPU: " << std::boolalpha
+              << std::equal(cpu_out.begin(), cpu_out.end(), out) << std::endl;
+  }
+
+  // ---------- Example H ------------
+  if (which_example == 7) {
+    // Many independent problems, each with its own buffers and algorithm.
+    // Workers create them and record them into secondary command buffers
+    // concurrently, one primary executes everything in a single submit.
+    constexpr uint32_t num_problems = 256;
+    constexpr uint32_t dispatches_per_problem = 64;
+    constexpr uint32_t threads_per_block = 256;
+
+    const auto run = [&](core::ThreadPool &pool) {
+      // Everything a secondary uses must live until the primary is done
+      std::vector<std::shared_ptr<core::Buffer>> inputs(num_problems);
+      std::vector<std::shared_ptr<core::Buffer>> outputs(num_problems);
+      std::vector<std::shared_ptr<core::Algorithm>> algos(num_problems);
+      std::vector<std::shared_ptr<core::SecondarySequence>> parts(
+          num_problems);
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      std::vector<std::future<void>> results;
+      results.reserve(num_problems);
+      for (uint32_t i = 0; i < num_problems; ++i) {
+        results.push_back(pool.submit([&, i] {
+          inputs[i] = engine.buffer(n * sizeof(float));
+          outputs[i] = engine.buffer(n * sizeof(float));
+          inputs[i]->tmp_debug_data<float>(n * sizeof(float));
+
+          std::vector params{inputs[i], outputs[i]};
+          algos[i] = engine.algorithm("float_doubler.spv",
+                                      params,
+                                      threads_per_block,
+                                      true,
+                                      make_clspv_push_const(uint32_t{n}));
+
+          // Recorded on the thread that created it
+          parts[i] = engine.secondary_sequence();
+          parts[i]->cmd_begin();
+          for (uint32_t d = 0; d < dispatches_per_problem; ++d) {
+            parts[i]->record_dispatch(*algos[i], n);
+            parts[i]->record_compute_barrier();
+          }
+          parts[i]->cmd_end();
+        }));
+      }
+      for (auto &result : results) {
+        result.get();
+      }
+      const auto end = std::chrono::high_resolution_clock::now();
+
+      const auto seq = engine.sequence();
+      seq->cmd_begin();
+      seq->record_execute(parts);
+      seq->cmd_end();
+      seq->launch_kernel_async();
+      seq->sync();
+
+      const auto out =
+          reinterpret_cast<const float *>(outputs.back()->get_data());
+      std::cout << pool.size() << " threads: recorded " << num_problems
+                << " problems in "
+                << std::chrono::duration<double, std::milli>(end - start)
+                       .count()
+                << " ms, out[1] = " << out[1] << std::endl;
+    };
+
+    core::ThreadPool single(1);
+    run(single);
+    core::ThreadPool workers;
+    run(workers);
+    std::cout << engine.num_command_pools() << " command pools" << std::endl;
+  }
+
+  // ---------- Example I ------------
+  if (which_example == 8) {
+    // The encoder is memory bound, so fewer bytes per point go faster
+    constexpr uint32_t num_points = 1 << 22;
+    constexpr auto min_coord = 0.0f;
+    constexpr auto range = 1024.0f;
+    constexpr uint32_t threads_per_block = 256;
+
+    std::default_random_engine gen(114514);  // NOLINT(cert-msc51-cpp)
+    std::uniform_real_distribution dis(min_coord, range);
+    std::vector<glm::vec4> in_data(num_points);
+    std::ranges::generate(in_data, [&] {
+      return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
+    });
+
+    const auto out_buf = engine.buffer(num_points * sizeof(glm::uint));
+    const auto seq = engine.sequence();
+    auto cpu_out = std::vector<glm::uint>(num_points);
+
+    // Invocation counts, when the device can count them
+    const auto query = engine.get_features().pipeline_statistics_query
+                           ? engine.pipeline_statistics_query()
+                           : nullptr;
+    std::vector<core::PipelineStats> all_stats;
+
+    const auto elapsed_ms = [](const auto start) {
+      return std::chrono::duration<double, std::milli>(
+                 std::chrono::high_resolution_clock::now() - start)
+          .count();
+    };
+    const auto upload = [&](const auto &v) {
+      const auto bytes = v.size() * sizeof(v[0]);
+      auto buf = engine.buffer(bytes);
+      buf->tmp_write_data(v.data(), bytes);
+      buf->flush_dirty();
+      return buf;
+    };
+
+    // 'inputs' already uploaded, the upload time is measured by the caller
+    const auto run = [&](const std::string_view layout,
+                         const std::string_view spirv,
+                         std::vector<std::shared_ptr<core::Buffer>> inputs,
+                         const core::PushConstants &push_constants,
+                         const double upload_ms) {
+      vk::DeviceSize input_bytes = 0;
+      for (const auto &buf : inputs) {
+        input_bytes += buf->get_size();
+      }
+      inputs.push_back(out_buf);
+      const auto algo = engine.algorithm(
+          spirv, inputs, threads_per_block, true, push_constants);
+
+      seq->simple_record_commands(*algo, num_points);  // warm up
+      seq->launch_kernel_async();
+      seq->sync();
+
+      const auto &cmd = seq->get_handle();
+      seq->cmd_begin();
+      if (query) {
+        query->record_reset(cmd);
+        query->record_begin(cmd);
+      }
+      algo->record_bind_core(cmd);
+      algo->record_bind_push(cmd);
+      algo->record_dispatch_tmp(cmd, num_points);
+      if (query) {
+        query->record_end(cmd);
+      }
+      seq->cmd_end();
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      seq->launch_kernel_async();
+      seq->sync();
+      const auto encode_ms = elapsed_ms(start);
+
+      if (!stats_json.empty()) {
+        auto stats = engine.pipeline_stats(*algo);
+        if (query) {
+          stats.invocations = query->get_invocations();
+        }
+        stats.metrics = {
+            {"bytes_per_point", static_cast<double>(input_bytes) / num_points},
+            {"upload_ms", upload_ms},
+            {"encode_ms", encode_ms},
+        };
+        all_stats.push_back(std::move(stats));
+      }
+
+      const auto out =
+          reinterpret_cast<const glm::uint *>(out_buf->get_data());
+      std::cout << layout << ": "
+                << static_cast<double>(input_bytes) / num_points
+                << " bytes per point, upload " << upload_ms << " ms, encode "
+                << encode_ms << " ms, matches CPU: " << std::boolalpha
+                << std::equal(cpu_out.begin(), cpu_out.end(), out)
+                << std::endl;
+    };
+    const auto push = make_clspv_push_const(MortonPushConstants{
+        .n = num_points,
+        .min_coord = min_coord,
+        .range = range,
+    });
+
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      const auto buf = upload(in_data);
+      const auto upload_ms = elapsed_ms(start);
+      morton::foo(in_data.data(), cpu_out.data(), num_points, min_coord, range);
+      run("float4", "morton32.spv", {buf}, push, upload_ms);
+    }
+    {
+      const auto xyz = morton::to_xyz(in_data.data(), num_points);
+      auto start = std::chrono::high_resolution_clock::now();
+      const auto buf = upload(xyz);
+      const auto upload_ms = elapsed_ms(start);
+      morton::foo_xyz(xyz.data(), cpu_out.data(), num_points, min_coord, range);
+      run("xyz", "morton32_xyz.spv", {buf}, push, upload_ms);
+    }
+    {
+      const auto soa = morton::to_soa(in_data.data(), num_points);
+      auto start = std::chrono::high_resolution_clock::now();
+      std::vector bufs{upload(soa.x), upload(soa.y), upload(soa.z)};
+      const auto upload_ms = elapsed_ms(start);
+      morton::foo_soa(soa, cpu_out.data(), num_points, min_coord, range);
+      run("soa", "morton32_soa.spv", bufs, push, upload_ms);
+    }
+    {
+      const auto half = morton::to_half(in_data.data(), num_points);
+      auto start = std::chrono::high_resolution_clock::now();
+      const auto buf = upload(half);
+      const auto upload_ms = elapsed_ms(start);
+      morton::foo_half(
+          half.data(), cpu_out.data(), num_points, min_coord, range);
+      run("half", "morton32_half.spv", {buf}, push, upload_ms);
+    }
+    {
+      const auto q =
+          morton::quantize(in_data.data(), num_points, min_coord, range);
+      auto start = std::chrono::high_resolution_clock::now();
+      const auto buf = upload(q);
+      const auto upload_ms = elapsed_ms(start);
+      morton::foo_quantized(q.data(), cpu_out.data(), num_points);
+      run("uint16",
+          "morton32_quantized.spv",
+          {buf},
+          make_clspv_push_const(uint32_t{num_points}),
+          upload_ms);
+    }
+
+    if (!stats_json.empty()) {
+      core::write_pipeline_stats_json(stats_json, all_stats);
+      std::cout << "Pipeline statistics written to " << stats_json
+                << std::endl;
+    }
+  }
+
+  // ---------- Example J ------------
+  if (which_example == 9) {
+    // Many requests in flight, each a coroutine awaiting its own submission.
+    // No thread blocks on a fence: the reactor waits for all of them, and
+    // finished requests continue on two workers.
+    constexpr uint32_t num_requests = 256;
+    constexpr uint32_t threads_per_block = 256;
+
+    // Outlive the workers, which may still be finishing a request
+    std::latch done(num_requests);
+    std::atomic<uint32_t> correct = 0;
+
+    core::ThreadPool workers(2);
+    core::CompletionReactor reactor(engine.get_device_ptr(),
+                                    core::CompletionReactor::on(workers));
+
+    const auto request = [&](const uint32_t id) -> Detached {
+      const auto in_buf = engine.buffer(n * sizeof(float));
+      const auto out_buf = engine.buffer(n * sizeof(float));
+      in_buf->tmp_debug_data<float>(n * sizeof(float));
+
+      std::vector params{in_buf, out_buf};
+      const auto algo = engine.algorithm("float_doubler.spv",
+                                         params,
+                                         threads_per_block,
+                                         true,
+                                         make_clspv_push_const(uint32_t{n}));
+      const auto seq = engine.sequence();
+      seq->simple_record_commands(*algo, n);
+
+      co_await reactor.launch(*seq);
+
+      const auto out = reinterpret_cast<const float *>(out_buf->get_data());
+      if (out[id % n] == 2.0f * static_cast<float>(id % n)) {
+        ++correct;
+      }
+      done.count_down();
+    };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < num_requests; ++i) {
+      request(i);
+    }
+    done.wait();
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << num_requests << " requests on " << workers.size()
+              << " workers in "
+              << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms, " << correct << " correct" << std::endl;
+  }
+
+  // ---------- Example K ------------
+  if (which_example == 10) {
+    // points -> codes (--curve) -> sorted codes -> inner nodes -> leaf parents.
+    // The intermediates are only needed for a stage or two, so they are
+    // transient: the sort scratch and the visit counters reuse the memory of
+    // buffers that are dead by then.
+    constexpr uint32_t num_points = 1 << 16;
+    constexpr auto min_coord = 0.0f;
+    constexpr auto range = 1024.0f;
+    constexpr uint32_t threads_per_block = 256;
+
+    std::default_random_engine gen(114514);  // NOLINT(cert-msc51-cpp)
+    std::uniform_real_distribution dis(min_coord, range);
+    std::vector<glm::vec4> in_data(num_points);
+    std::ranges::generate(in_data, [&] {
+      return glm::vec4{dis(gen), dis(gen), dis(gen), 0.0f};
+    });
+
+    const auto points_buf = engine.buffer(num_points * sizeof(glm::vec4));
+    points_buf->tmp_write_data(in_data.data(),
+                               num_points * sizeof(glm::vec4));
+    points_buf->flush_dirty();
+    const auto parents_buf = engine.buffer(num_points * sizeof(int32_t));
+
+    // Stages: 0 morton, 1 sort, 2 tree, 3 leaf parents
+    core::TransientPlan plan;
+    const auto codes = plan.add(num_points * sizeof(uint32_t), 0, 2);
+    const auto scratch = plan.add(num_points * sizeof(uint32_t), 1, 1);
+    const auto nodes = plan.add(num_points * sizeof(brt::InnerNode), 2, 3);
+    const auto visits = plan.add(num_points * sizeof(uint32_t), 3, 3);
+    const auto transients = engine.transient_buffers(plan);
+    std::cout << "transient buffers: " << transients->get_block_size()
+              << " bytes instead of " << transients->get_unaliased_size()
+              << std::endl;
+
+    std::vector morton_params{points_buf, transients->get(codes)};
+    const auto morton_algo =
+        engine.algorithm(sfc::kernel_name(curve),
+                         morton_params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(MortonPushConstants{
+                             num_points, min_coord, range}));
+    // 4 passes of 8 bits, the result ends up back in 'codes'
+    std::vector sort_params{transients->get(codes), transients->get(scratch)};
+    const auto sort_algo = engine.algorithm(
+        "tmp_sort.spv",
+        sort_params,
+        threads_per_block,
+        false,
+        core::PushConstants(uint32_t{num_points}),
+        core::SpecConstants().set(3, 8u).set(4, engine.get_subgroup_size()));
+    std::vector tree_params{transients->get(codes), transients->get(nodes)};
+    const auto tree_algo =
+        engine.algorithm("build_radix_tree.spv",
+                         tree_params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(uint32_t{num_points}));
+    std::vector parents_params{
+        transients->get(nodes), parents_buf, transients->get(visits)};
+    const auto parents_algo =
+        engine.algorithm("radix_tree_leaf_parents.spv",
+                         parents_params,
+                         threads_per_block,
+                         true,
+                         make_clspv_push_const(uint32_t{num_points}));
+
+    // Every stage reads the previous one's output, the barriers between them
+    // also order the reuse of memory
+    const auto seq = engine.sequence();
+    const auto &cmd = seq->get_handle();
+    seq->cmd_begin();
+    morton_algo->record_bind_core(cmd);
+    morton_algo->record_bind_push(cmd);
+    morton_algo->record_dispatch_tmp(cmd, num_points);
+    seq->record_compute_barrier();
+    sort_algo->record_bind_core(cmd);
+    sort_algo->record_bind_push(cmd);
+    sort_algo->record_dispatch_tmp(cmd, threads_per_block);
+    seq->record_compute_barrier();
+    tree_algo->record_bind_core(cmd);
+    tree_algo->record_bind_push(cmd);
+    tree_algo->record_dispatch_tmp(cmd, num_points);
+    seq->record_compute_barrier();
+    parents_algo->record_bind_core(cmd);
+    parents_algo->record_bind_push(cmd);
+    parents_algo->record_dispatch_tmp(cmd, num_points);
+    seq->cmd_end();
+
+    seq->launch_kernel_async();
+    seq->sync();
+
+    // Same stages on the CPU
+    std::vector<uint32_t> cpu_codes(num_points);
+    sfc::encode_points(
+        curve, in_data.data(), cpu_codes.data(), num_points, min_coord, range);
+    std::ranges::sort(cpu_codes);
+    std::vector<brt::InnerNode> cpu_nodes(num_points);
+    brt::build(cpu_codes.data(), cpu_nodes.data(), num_points);
+    const auto expected = brt::leaf_parents(cpu_nodes.data(), num_points);
+
+    const auto out = reinterpret_cast<const int32_t *>(parents_buf->get_data());
+    std::cout << "leaf parents match CPU: " << std::boolalpha
+              << std::equal(expected.begin(), expected.end(), out)
+              << std::endl;
+    engine.log_memory_report();
+  }
+
+  if (!trace_file.empty()) {
+    core::trace::write_chrome_trace(trace_file);
+  }
+
   std::cout << "Done!" << std::endl;
   return EXIT_SUCCESS;
 }
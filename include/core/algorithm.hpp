@@ -1,8 +1,14 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
+#include <utility>
 
 #include "buffer.hpp"
+#include "pipeline_stats.hpp"
+#include "push_constants.hpp"
+#include "spec_constants.hpp"
+#include "tuning_profile.hpp"
 #include "vulkan_resource.hpp"
 
 namespace core {
@@ -15,12 +21,19 @@ using WorkGroup = std::array<uint32_t, 3>;
  */
 class Algorithm final : public VulkanResource<vk::ShaderModule> {
  public:
+  /**
+   * @param device_ptr Pointer to the device
+   * @param pipeline_cache The engine's pipeline cache (of the same device), or
+   * null for a cache of its own.
+   */
   explicit Algorithm(std::shared_ptr<vk::Device> device_ptr,
+                     vk::PipelineCache pipeline_cache,
                      std::string_view spirv_filename,
                      const std::vector<std::shared_ptr<Buffer>> &buffers,
                      uint32_t threads_per_block,
                      bool is_clspv,
-                     const std::vector<float> &push_constants = {});
+                     const PushConstants &push_constants = {},
+                     const SpecConstants &spec_constants = {});
 
   ~Algorithm() override {
     spdlog::debug("YxAlgorithm::~YxAlgorithm");
@@ -36,50 +49,92 @@ class Algorithm final : public VulkanResource<vk::ShaderModule> {
   //                  Getter and Setter
   // ---------------------------------------------------------------------------
 
- protected:
   /**
-   * @brief If your push constant is homogeneous type, you can use this function
-   * to pass a vector of push constants. Just a nice wrapper of the other
-   * function.
+   * @brief Update the push constants, e.g. a new element count before
+   * recording. The struct must have the same size as the one the Algorithm was
+   * created with, because the pipeline layout is fixed.
    *
-   * @tparam T The type of the push constant (usually uint32_t or float).
-   * @param push_constants The vector of push constants.
-   */
-  template <typename T>
-  void set_push_constants(const std::vector<T> &push_constants) {
-    spdlog::debug("YxAlgorithm::set_push_constants", push_constants.size());
-    const uint32_t memory_size = sizeof(decltype(push_constants.back()));
-    const uint32_t size = push_constants.size();
-    this->set_push_constants(push_constants.data(), size, memory_size);
+   * @tparam T The push constant struct (e.g. ClspvPushConstants<MyArgs>).
+   * @param push_constants The new push constants.
+   */
+  template <PushConstantT T>
+  void set_push_constants(const T &push_constants) {
+    push_constants_.set(push_constants);
+  }
+
+  void set_push_constants(const PushConstants &push_constants);
+
+  template <PushConstantT T>
+  [[nodiscard]] T get_push_constants() const {
+    return push_constants_.get<T>();
   }
 
   /**
-   * @brief Set the push constants. Passing the raw pointer to the data.
+   * @brief Switch to the pipeline variant specialized with the given workgroup
+   * size and constants. The first time a combination is used its pipeline is
+   * compiled, after that it is reused from the cache. Subsequent
+   * record_bind_core() and record_dispatch_tmp() calls use this variant.
    *
-   * @param data The raw pointer to the data.
-   * @param size The number of push constants.
-   * @param memory_size The size of each push constant.
-   */
-  void set_push_constants(const void *data,
-                          uint32_t size,
-                          uint32_t memory_size);
-
-  template <typename T>
-  [[nodiscard]] std::vector<T> get_push_constants() {
-    return {static_cast<T *>(push_constants_data_),
-            static_cast<T *>(push_constants_data_) + push_constants_size_};
+   * @param threads_per_block The workgroup size (constant ID 0).
+   * @param spec_constants User constants (constant ID >= 3).
+   * @throws std::invalid_argument for tmp_sort.spv and tmp_sort_histogram.spv
+   * constants the shader cannot sort with (see tmp_sort.h).
+   */
+  void set_variant(uint32_t threads_per_block,
+                   const SpecConstants &spec_constants = {});
+
+  [[nodiscard]] uint32_t get_threads_per_block() const {
+    return threads_per_block_;
+  }
+  [[nodiscard]] const SpecConstants &get_spec_constants() const {
+    return spec_constants_;
   }
 
-  // void set_clspv_spec_const();
+  /**
+   * @brief The constants the Algorithm was created with. Tuned variants keep
+   * them, only adding or overriding the tuned ones.
+   */
+  [[nodiscard]] const SpecConstants &get_base_spec_constants() const {
+    return base_spec_constants_;
+  }
+  [[nodiscard]] size_t num_variants() const { return pipelines_.size(); }
 
   /**
-   * @brief telling the shader the workgroup size (if is CLSPV shader)
+   * @brief Attach the autotuning profile of the device, so that tune_for()
+   * selects tuned variants. Nothing changes until tune_for() is called. Opt in
+   * with ComputeEngine::enable_tuning(), never for kernels that only work at
+   * a fixed workgroup size.
    *
-   * @return vk::SpecializationInfo
+   * @param profile The tuning profile, or nullptr to detach.
    */
-  [[nodiscard]] vk::SpecializationInfo make_spec_info() const;
+  void set_tuning_profile(std::shared_ptr<const TuningProfile> profile);
 
-  // void set_spec_const(const void *data, uint32_t size, uint32_t memory_size);
+  /**
+   * @brief Select the tuned variant for a problem of 'n' elements, using the
+   * attached profile: the tuned workgroup size, and the tuned constants merged
+   * into get_base_spec_constants(). Does nothing if no profile is attached or
+   * the kernel was never tuned.
+   *
+   * @param n The problem size.
+   * @return true if a tuned variant was selected.
+   */
+  bool tune_for(uint32_t n);
+  [[nodiscard]] const std::string &get_spirv_filename() const {
+    return spirv_filename_;
+  }
+
+  /**
+   * @brief Compile the current variant once more, asking the driver to keep
+   * its compiler statistics (VK_KHR_pipeline_executable_properties), and
+   * return them. The pipeline used for dispatching is not changed, nor is the
+   * pipeline cache. Use ComputeEngine::pipeline_stats() rather than calling
+   * it directly.
+   *
+   * @param dld Dispatcher with the extension's entry points loaded.
+   * @return One entry per executable of the pipeline.
+   */
+  [[nodiscard]] std::vector<PipelineExecutableStats> capture_statistics(
+      const vk::DispatchLoaderDynamic &dld) const;
 
   // ---------------------------------------------------------------------------
   //                  Used by Sequence (command buffer)
@@ -101,27 +156,87 @@ class Algorithm final : public VulkanResource<vk::ShaderModule> {
   void record_bind_push(const vk::CommandBuffer &cmd_buf) const;
 
   /**
-   * @brief Let the cmd_buffer to dispatch the compute shader.
+   * @brief Let the cmd_buffer to dispatch the compute shader. The workgroups
+   * are spread over X and Y when they do not fit in X (see num_blocks()), so
+   * kernels must index with linear_global_id() from shaders/dispatch.h.
+   * Larger problems, past 2^32 elements, are split into chunks, e.g. with
+   * StreamExecutor.
    *
    * @param cmd_buf The command buffer.
    * @param data_size The number of data to process. (N)
+   * @throws std::runtime_error if the dispatch would need more workgroups than
+   * the device is guaranteed to support.
    */
   void record_dispatch_tmp(const vk::CommandBuffer &cmd_buf,
                            uint32_t data_size) const;
 
+  /**
+   * @brief Let the cmd_buffer to dispatch the compute shader, with workgroup
+   * counts read from a device buffer (VkDispatchIndirectCommand, 3 uint32).
+   * Use it when the problem size is computed by an earlier GPU stage, so no
+   * readback is needed. See ComputeEngine::dispatch_args_algorithm().
+   *
+   * @param cmd_buf The command buffer.
+   * @param indirect_buf Buffer holding the workgroup counts. Must be created
+   * with vk::BufferUsageFlagBits::eIndirectBuffer.
+   * @param offset Byte offset of the command inside the buffer.
+   */
+  void record_dispatch_indirect(const vk::CommandBuffer &cmd_buf,
+                                const Buffer &indirect_buf,
+                                vk::DeviceSize offset = 0) const;
+
+  /**
+   * @brief maxComputeWorkGroupCount every Vulkan device supports, per axis.
+   * Must match MAX_WORKGROUP_COUNT in shaders/dispatch.h.
+   */
+  static constexpr uint32_t kMaxWorkGroupCount = 65535;
+
+  /**
+   * @brief Workgroup counts needed to cover 'data_size' elements. Up to
+   * kMaxWorkGroupCount they all go in X, beyond that they are spread over as
+   * few rows (Y) as possible. Computed in 64 bits so counts close to 2^32 do
+   * not wrap around.
+   *
+   * @throws std::runtime_error if even kMaxWorkGroupCount rows are not
+   * enough, i.e. one thread per block and more than 65535^2 elements.
+   */
+  [[nodiscard]] WorkGroup num_blocks(uint32_t data_size) const;
+
  protected:
   // Basically setup the buffer, its descriptor set, binding etc.
   void create_parameters();
   void create_pipeline();
   void create_shader_module();
 
+  /**
+   * @brief Compile the compute pipeline for one variant. The pipeline layout
+   * and cache are shared by all variants. Pipelines created with any 'flags'
+   * (e.g. to capture statistics) bypass the cache.
+   */
+  [[nodiscard]] vk::Pipeline create_pipeline_variant(
+      uint32_t threads_per_block,
+      const SpecConstants &spec_constants,
+      vk::PipelineCreateFlags flags = {}) const;
+
+  /**
+   * @brief Check the push constants given by the user against the push
+   * constant block declared in the SPIR-V (via SPIRV-Cross reflection).
+   *
+   * If none were given for a CLSPV shader, a zeroed global offset is used.
+   *
+   * @param spirv_binary The shader code.
+   * @throws std::runtime_error if the sizes do not match.
+   */
+  void validate_push_constants(const std::vector<uint32_t> &spirv_binary);
+
  private:
   std::string spirv_filename_;
   bool is_clspv_;
 
   // Vulkan components
-  vk::Pipeline pipeline_;
+  vk::Pipeline pipeline_;  // currently selected variant
   vk::PipelineCache pipeline_cache_;
+  bool owns_pipeline_cache_ = false;
   vk::PipelineLayout pipeline_layout_;
   vk::DescriptorSetLayout descriptor_set_layout_;
   vk::DescriptorPool descriptor_pool_;
@@ -133,6 +248,25 @@ class Algorithm final : public VulkanResource<vk::ShaderModule> {
    */
   uint32_t threads_per_block_;
 
+  /**
+   * @brief User specialization constants of the currently selected variant.
+   */
+  SpecConstants spec_constants_;
+
+  /**
+   * @brief Specialization constants given at creation, the base of tuned
+   * variants.
+   */
+  SpecConstants base_spec_constants_;
+
+  /**
+   * @brief All compiled variants, keyed by (workgroup size, constants). They
+   * are destroyed together with the Algorithm.
+   */
+  std::map<std::pair<uint32_t, SpecConstants>, vk::Pipeline> pipelines_;
+
+  std::shared_ptr<const TuningProfile> tuning_profile_;
+
   /**
    * @brief All the buffers that are used by this algorithm. It is corresponding
    * to the GPU kernel's arguments. Note, they might have different type, sizes,
@@ -143,10 +277,11 @@ class Algorithm final : public VulkanResource<vk::ShaderModule> {
    */
   std::vector<std::shared_ptr<Buffer>> usm_buffers_;
 
-  // Currently this assume the push constant is homogeneous type
-  void *push_constants_data_ = nullptr;
-  uint32_t push_constants_data_type_memory_size_ = 0;
-  uint32_t push_constants_size_ = 0;
+  /**
+   * @brief Raw bytes of the user's push constant struct. The size is fixed
+   * once the pipeline layout is created.
+   */
+  PushConstants push_constants_;
 };
 
 }  // namespace core
\ No newline at end of file
@@ -2,31 +2,35 @@
 
 #include <spdlog/spdlog.h>
 
+#include <mutex>
+#include <string_view>
 #include <vulkan/vulkan.hpp>
 
 #include "VkBootstrap.h"
+#include "engine_config.hpp"
+#include "vma_usage.hpp"
 
 namespace core {
 
-// Need a global allocator for VMA
-// extern VmaAllocator g_allocator;
-
 /**
  * @brief Basically do the initializations, save you a lot of time. BaseEngine
  * will setup the Vulkan instance, physical device, logical device etc. For
- * compute shader usage only. By default it will pick an integrated GPU, with
- * compute queue. It should only pick integrated GPU.
+ * compute shader usage only. By default it will pick a discrete GPU, with
+ * compute queue, see EngineConfig.
+ *
+ * Every engine has its own device, VMA allocator and pipeline cache, so several
+ * engines can live in one process. Buffers must be used with the engine that made them.
  */
 class BaseEngine {
  public:
-  BaseEngine();
+  explicit BaseEngine(const EngineConfig &config = {});
 
   ~BaseEngine() {
     spdlog::debug("BaseEngine::~BaseEngine");
     destroy();
   }
 
-  void destroy() const;
+  void destroy();
 
   // ---------------------------------------------------------------------------
   //                  Getter and Setter
@@ -49,19 +53,100 @@ class BaseEngine {
     return std::make_shared<vk::Device>(device_.device);
   }
 
+  /**
+   * @brief The VMA allocator of this engine's device, which all its buffers
+   * are allocated from.
+   */
+  [[nodiscard]] VmaAllocator get_allocator() const { return allocator_; }
+
+  /**
+   * @brief The pipeline cache of this engine's device, shared by all its
+   * Algorithms (and pipeline warm-up) so a pipeline compiled once is cheap to
+   * create again.
+   */
+  [[nodiscard]] vk::PipelineCache get_pipeline_cache() const {
+    return pipeline_cache_;
+  }
+
   [[nodiscard, maybe_unused]] vk::Queue &get_queue() { return queue_; }
   [[nodiscard, maybe_unused]] const vk::Queue &get_queue() const {
     return queue_;
   }
 
+  /**
+   * @brief Guards submissions to the queue (vkQueueSubmit needs the queue
+   * externally synchronized). Hold it when submitting to get_queue() directly.
+   */
+  [[nodiscard]] std::mutex &get_queue_mutex() { return queue_mutex_; }
+
+  /**
+   * @brief Whether VK_EXT_external_memory_host is enabled, i.e., host memory
+   * (such as a mmap'ed file) can be imported as a buffer without a copy.
+   */
+  [[nodiscard]] bool supports_external_memory_host() const {
+    return external_memory_host_alignment_ != 0;
+  }
+
+  /**
+   * @brief minImportedHostPointerAlignment. Imported pointers and sizes must
+   * be multiples of it. 0 if the extension is not supported.
+   */
+  [[nodiscard]] vk::DeviceSize get_external_memory_host_alignment() const {
+    return external_memory_host_alignment_;
+  }
+
+  /**
+   * @brief Whether VK_EXT_memory_budget is enabled, i.e., the heap budgets
+   * reported by VMA are live numbers from the driver rather than estimates.
+   */
+  [[nodiscard]] bool supports_memory_budget() const {
+    return has_memory_budget_;
+  }
+
+  /**
+   * @brief The optional features enabled on the device: the required ones,
+   * and the desired ones the device supports.
+   */
+  [[nodiscard]] const DeviceFeatures &get_features() const {
+    return features_;
+  }
+
+  /**
+   * @brief Threads per subgroup (warp/wavefront) of the device.
+   */
+  [[nodiscard]] uint32_t get_subgroup_size() const { return subgroup_size_; }
+
+  /**
+   * @brief Whether a device extension was enabled when the device was
+   * created: a required one, or a desired one (e.g. of the EngineConfig) that
+   * the device supports.
+   */
+  [[nodiscard]] bool is_extension_enabled(std::string_view name) const {
+    return has_device_extension(name);
+  }
+
  private:
-  void device_initialization();
+  void device_initialization(const EngineConfig &config);
   void get_queues();
-  void vma_initialization() const;
+  void vma_initialization();
+  void pipeline_cache_initialization();
+  void query_optional_extensions();
+  void log_features() const;
+
+  [[nodiscard]] bool has_device_extension(std::string_view name) const;
 
  protected:
   vkb::Instance instance_;
   vkb::Device device_;
   vk::Queue queue_;
+  std::mutex queue_mutex_;
+  VmaAllocator allocator_ = VK_NULL_HANDLE;
+  vk::PipelineCache pipeline_cache_;
+
+  vk::DeviceSize external_memory_host_alignment_ = 0;
+  bool has_memory_budget_ = false;
+
+  DeviceFeatures features_;
+  uint32_t subgroup_size_ = 0;
 };
 }  // namespace core
@@ -2,9 +2,13 @@
 
 #include <spdlog/spdlog.h>
 
+#include <memory>
 #include <numeric>
 #include <vulkan/vulkan.hpp>
 
+#include "dirty_ranges.hpp"
+#include "memory_tracker.hpp"
+#include "trace.hpp"
 #include "vma_usage.hpp"
 #include "vulkan_resource.hpp"
 
@@ -31,6 +35,7 @@ class Buffer final : public VulkanResource<vk::Buffer> {
    * not data size. (N*sizeof(T) instead of N)
    *
    * @param device_ptr Pointer to the device
+   * @param allocator The VMA allocator of the engine (of the same device).
    * @param size Size of the buffer. It is the total memory size of the buffer,
    * not the data size.
    * @param buffer_usage Usage of the buffer. Default is storage buffer.
@@ -38,6 +43,7 @@ class Buffer final : public VulkanResource<vk::Buffer> {
    * @param flags Allocation flags. Default is persistent mapped memory.
    */
   explicit Buffer(std::shared_ptr<vk::Device> device_ptr,
+                  VmaAllocator allocator,
                   vk::DeviceSize size,
                   vk::BufferUsageFlags buffer_usage =
                       vk::BufferUsageFlagBits::eStorageBuffer,
@@ -46,6 +52,30 @@ class Buffer final : public VulkanResource<vk::Buffer> {
                       VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
                       VMA_ALLOCATION_CREATE_MAPPED_BIT);
 
+  /**
+   * @brief Adopt a buffer whose memory was not allocated by VMA, e.g. host
+   * memory imported with VK_EXT_external_memory_host. The buffer and memory
+   * are destroyed with this object, then 'keep_alive' (the owner of the host
+   * memory) is released.
+   *
+   * @param device_ptr Pointer to the device
+   * @param buffer The Vulkan buffer, already bound to 'memory'.
+   * @param memory The device memory, owned by this object from now on.
+   * @param size Size of the buffer in bytes.
+   * @param mapped_data Host address of the memory.
+   * @param keep_alive Keeps the host memory valid while the buffer exists.
+   * @param owns_memory Whether 'memory' is freed with this object. False for
+   * buffers bound to memory shared with others (see TransientBuffers), which
+   * 'keep_alive' then keeps allocated.
+   */
+  explicit Buffer(std::shared_ptr<vk::Device> device_ptr,
+                  vk::Buffer buffer,
+                  vk::DeviceMemory memory,
+                  vk::DeviceSize size,
+                  std::byte *mapped_data,
+                  std::shared_ptr<const void> keep_alive,
+                  bool owns_memory = true);
+
   Buffer(const Buffer &) = delete;
 
   ~Buffer() override {
@@ -84,22 +114,98 @@ class Buffer final : public VulkanResource<vk::Buffer> {
 
   template <typename T>
   void tmp_debug_data(const size_t size, const size_t offset = 0) const {
-    auto *ptr = reinterpret_cast<T *>(mapped_data_ + offset);
+    auto *ptr = reinterpret_cast<T *>(host_data() + offset);
     std::iota(ptr, ptr + size / sizeof(T), T());
+    mark_dirty(offset, size);
   }
 
   void tmp_write_data(const void *data,
                       const size_t size,
                       const size_t offset = 0) const {
-    spdlog::info("Writing {} bytes to buffer", size);
-    std::memcpy(mapped_data_ + offset, data, size);
+    VKC_TRACE_SCOPE_N("transfer", "Buffer::tmp_write_data", size);
+    std::memcpy(host_data() + offset, data, size);
+    mark_dirty(offset, size);
   }
 
   void tmp_fill_zero(const size_t size, const size_t offset = 0) const {
-    spdlog::info("Filling zeros {} bytes to buffer", size);
-    std::memset(mapped_data_ + offset, 0, size);
+    VKC_TRACE_SCOPE_N("transfer", "Buffer::tmp_fill_zero", size);
+    std::memset(host_data() + offset, 0, size);
+    mark_dirty(offset, size);
   }
 
+  // ---------------------------------------------------------------------------
+  //                 Incremental uploads (dirty range tracking)
+  // ---------------------------------------------------------------------------
+
+  /**
+   * @brief Record that the host changed [offset, offset + size), e.g. after
+   * writing through get_data_mut(). The tmp_* writers do it themselves.
+   * Adjacent and overlapping ranges are merged.
+   */
+  void mark_dirty(const size_t offset, const size_t size) const {
+    dirty_.add(offset, size);
+  }
+
+  [[nodiscard]] const DirtyRanges &get_dirty_ranges() const { return dirty_; }
+
+  /**
+   * @brief Make the dirty ranges of a mapped buffer visible to the device and
+   * forget them. On non-coherent memory only those ranges are flushed, rounded
+   * to nonCoherentAtomSize (and merged where rounding makes them touch); on
+   * coherent memory nothing needs to be done. For a staged buffer this only
+   * flushes the staging memory, the ranges are kept for record_upload().
+   *
+   * @return Number of bytes flushed.
+   */
+  vk::DeviceSize flush_dirty();
+
+  /**
+   * @brief Upload the dirty ranges of a staged buffer (see
+   * ComputeEngine::staged_buffer()): one copy region per range from the
+   * staging buffer, between a compute -> transfer barrier (for dispatches
+   * recorded before it) and a transfer -> compute barrier. For a mapped
+   * buffer it records nothing and just calls flush_dirty().
+   *
+   * There is a single staging buffer, and the copy reads it only when the
+   * command buffer executes. Wait for that submission (e.g. Sequence::sync())
+   * before writing to the buffer again, or the copy may see the new data.
+   *
+   * @param cmd_buf The command buffer, recorded before the dispatches reading
+   * this buffer.
+   * @return Number of bytes uploaded.
+   */
+  vk::DeviceSize record_upload(const vk::CommandBuffer &cmd_buf);
+
+  /**
+   * @brief Attach the host-visible buffer that writes go through, for a buffer
+   * in device-local memory. Created with eTransferSrc usage, as big as this
+   * buffer. Used by ComputeEngine::staged_buffer().
+   */
+  void set_staging(std::unique_ptr<Buffer> staging);
+
+  [[nodiscard]] bool is_staged() const { return staging_ != nullptr; }
+
+  /**
+   * @brief Make host writes visible to the device. Only needed if the memory
+   * is not HOST_COHERENT, otherwise it does nothing.
+   */
+  void flush(vk::DeviceSize size = VK_WHOLE_SIZE,
+             vk::DeviceSize offset = 0) const;
+
+  /**
+   * @brief Make device writes visible to the host. Only needed if the memory
+   * is not HOST_COHERENT, otherwise it does nothing.
+   */
+  void invalidate(vk::DeviceSize size = VK_WHOLE_SIZE,
+                  vk::DeviceSize offset = 0) const;
+
+  /**
+   * @brief Report this buffer's size to 'tracker' now, and again when it is
+   * destroyed. Used by ComputeEngine for its memory statistics.
+   */
+  void set_memory_tracker(std::shared_ptr<MemoryTracker> tracker,
+                          BufferClass buffer_class);
+
   // ---------------------------------------------------------------------------
   //      The following functions provides infos for the descriptor set
   // ---------------------------------------------------------------------------
@@ -108,7 +214,16 @@ class Buffer final : public VulkanResource<vk::Buffer> {
       const;
 
  private:
+  /**
+   * @brief Where host writes go: the staging buffer if there is one, otherwise
+   * the mapped memory of this buffer.
+   */
+  [[nodiscard]] std::byte *host_data() const {
+    return staging_ ? staging_->mapped_data_ : mapped_data_;
+  }
+
   // Vulkan Memory Allocator components
+  VmaAllocator allocator_ = VK_NULL_HANDLE;
   VmaAllocation allocation_ = VK_NULL_HANDLE;
   vk::DeviceMemory memory_ = nullptr;
   vk::DeviceSize size_ = 0;
@@ -117,6 +232,20 @@ class Buffer final : public VulkanResource<vk::Buffer> {
   std::byte *mapped_data_ = nullptr;
 
   bool persistent_ = true;
+
+  // Only for adopted (non-VMA) buffers, see the second constructor
+  std::shared_ptr<const void> keep_alive_;
+  bool owns_memory_ = true;
+
+  std::shared_ptr<MemoryTracker> memory_tracker_;
+  BufferClass buffer_class_ = BufferClass::kStorage;
+
+  // Host writes not yet made visible to the device. Mutable so the const
+  // writers (tmp_*) can record them, the tracking is not part of the contents.
+  mutable DirtyRanges dirty_;
+
+  // Only for staged (device local) buffers
+  std::unique_ptr<Buffer> staging_;
 };
 
 }  // namespace core
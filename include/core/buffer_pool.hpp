@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vulkan/vulkan.hpp>
+
+#include "buffer.hpp"
+
+namespace core {
+
+/**
+ * @brief When the pool keeps or evicts released buffers.
+ */
+struct BufferPoolPolicy {
+  // Smallest size class, smaller requests are rounded up to it
+  vk::DeviceSize min_class_size = 256;
+
+  // Idle bytes kept over all classes, least recently released go first
+  vk::DeviceSize max_idle_bytes = vk::DeviceSize{256} << 20;
+
+  // Idle buffers kept per (size class, usage)
+  uint32_t max_idle_per_class = 8;
+};
+
+struct BufferPoolStats {
+  uint64_t hits = 0;       // requests served from a free list
+  uint64_t misses = 0;     // requests that allocated a new buffer
+  uint64_t releases = 0;   // buffers returned to the pool
+  uint64_t evictions = 0;  // idle buffers freed by the trim policy
+  vk::DeviceSize evicted_bytes = 0;
+
+  uint32_t idle_buffers = 0;
+  vk::DeviceSize idle_bytes = 0;
+};
+
+/**
+ * @brief Recycles Buffers across iterations. Requests are rounded up to a size
+ * class (powers of two), and when the last shared_ptr of a pooled buffer dies
+ * the buffer goes back to the free list of its class instead of being freed,
+ * so the next request of a similar size skips vmaCreateBuffer.
+ *
+ * Recycled buffers keep their old contents, and get_size() is the size of the
+ * class, which may be bigger than requested.
+ *
+ * Use it through ComputeEngine::enable_buffer_pool().
+ */
+class BufferPool : public std::enable_shared_from_this<BufferPool> {
+ public:
+  /**
+   * @brief Allocates a new buffer of exactly the given size.
+   */
+  using AllocateFn = std::function<std::unique_ptr<Buffer>(
+      vk::DeviceSize size, vk::BufferUsageFlags usage)>;
+
+  explicit BufferPool(AllocateFn allocate, const BufferPoolPolicy &policy = {})
+      : allocate_(std::move(allocate)), policy_(policy) {}
+
+  ~BufferPool() { close(); }
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /**
+   * @brief A buffer of at least 'size' bytes, recycled if possible.
+   */
+  [[nodiscard]] std::shared_ptr<Buffer> acquire(vk::DeviceSize size,
+                                                vk::BufferUsageFlags usage);
+
+  /**
+   * @brief The size class of a request.
+   */
+  [[nodiscard]] vk::DeviceSize class_size(vk::DeviceSize size) const;
+
+  /**
+   * @brief Free idle buffers, least recently released first, until at most
+   * 'max_idle_bytes' are left idle.
+   *
+   * @return Number of bytes freed.
+   */
+  vk::DeviceSize trim(vk::DeviceSize max_idle_bytes = 0);
+
+  void set_policy(const BufferPoolPolicy &policy);
+
+  [[nodiscard]] BufferPoolPolicy get_policy() const {
+    std::lock_guard lock(mutex_);
+    return policy_;
+  }
+
+  [[nodiscard]] BufferPoolStats stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+  }
+
+  /**
+   * @brief Free all idle buffers. Buffers released afterwards are freed right
+   * away instead of recycled. Called when the engine is destroyed.
+   */
+  void close();
+
+ private:
+  using ClassKey = std::pair<vk::DeviceSize, VkBufferUsageFlags>;
+
+  /**
+   * @brief Called by the deleter of the shared_ptr handed out by acquire().
+   */
+  void release(Buffer *buffer, vk::BufferUsageFlags usage);
+
+  /**
+   * @brief Evict least recently released buffers until the idle bytes fit.
+   * Expects the lock held, the evicted buffers are returned to be freed
+   * outside of it.
+   */
+  std::vector<std::unique_ptr<Buffer>> evict_locked(
+      vk::DeviceSize max_idle_bytes);
+
+  AllocateFn allocate_;
+
+  mutable std::mutex mutex_;
+  BufferPoolPolicy policy_;
+  BufferPoolStats stats_;
+  bool closed_ = false;
+
+  // Idle buffers in release order (front = least recently released), and
+  // per class iterators into it for O(1) lookup.
+  struct IdleBuffer {
+    ClassKey key;
+    std::unique_ptr<Buffer> buffer;
+  };
+  std::list<IdleBuffer> idle_;
+  std::map<ClassKey, std::vector<std::list<IdleBuffer>::iterator>> free_lists_;
+};
+
+}  // namespace core
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace core {
+
+/**
+ * @brief One command pool per recording thread. A vk::CommandPool (and every
+ * command buffer allocated from it) must only be used by one thread at a time,
+ * so threads recording in parallel each get their own pool instead of
+ * contending on a lock.
+ *
+ * Command buffers can be released from any thread: they go back to the free
+ * list of the pool they came from, and are reused (reset by their next
+ * begin()) by the thread owning that pool. They are never freed one by one,
+ * destroying a pool frees all of its command buffers.
+ *
+ * Shared between the engine and its SecondarySequences, which only keep a
+ * weak reference, so they can outlive the engine.
+ */
+class CommandPools {
+ public:
+  /**
+   * @brief A command buffer, and the index of the pool it belongs to.
+   */
+  struct Allocation {
+    vk::CommandBuffer command_buffer;
+    size_t pool_index = 0;
+  };
+
+  explicit CommandPools(std::shared_ptr<vk::Device> device_ptr,
+                        uint32_t queue_family_index)
+      : device_ptr_(std::move(device_ptr)),
+        queue_family_index_(queue_family_index) {}
+
+  ~CommandPools() { destroy(); }
+
+  CommandPools(const CommandPools &) = delete;
+  CommandPools &operator=(const CommandPools &) = delete;
+
+  /**
+   * @brief A command buffer from the pool of the calling thread (created on
+   * the first call of a thread). It must be recorded on this thread.
+   */
+  [[nodiscard]] Allocation allocate(vk::CommandBufferLevel level);
+
+  /**
+   * @brief Give a command buffer back to its pool, from any thread. It must
+   * not be pending execution anymore.
+   */
+  void release(vk::CommandBufferLevel level, const Allocation &allocation);
+
+  /**
+   * @brief Number of threads that allocated a command buffer so far.
+   */
+  [[nodiscard]] size_t num_pools() const {
+    std::lock_guard lock(mutex_);
+    return pools_.size();
+  }
+
+  /**
+   * @brief Destroy all pools, with their command buffers. Buffers released
+   * afterwards are ignored. Called when the engine is destroyed.
+   */
+  void destroy();
+
+ private:
+  struct PerThreadPool {
+    vk::CommandPool pool;
+    std::vector<vk::CommandBuffer> free_primary;
+    std::vector<vk::CommandBuffer> free_secondary;
+
+    std::vector<vk::CommandBuffer> &free_list(
+        const vk::CommandBufferLevel level) {
+      return level == vk::CommandBufferLevel::ePrimary ? free_primary
+                                                       : free_secondary;
+    }
+  };
+
+  std::shared_ptr<vk::Device> device_ptr_;
+  uint32_t queue_family_index_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<PerThreadPool>> pools_;
+  std::unordered_map<std::thread::id, size_t> pool_of_thread_;
+  bool destroyed_ = false;
+};
+
+}  // namespace core
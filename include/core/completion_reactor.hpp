@@ -0,0 +1,134 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "sequence.hpp"
+#include "thread_pool.hpp"
+
+namespace core {
+
+/**
+ * @brief Lets coroutines co_await GPU work instead of blocking a thread in
+ * Sequence::sync(). One reactor thread waits on the fences of all in-flight
+ * submissions at once and hands the coroutines of the finished ones to an
+ * executor, so thousands of concurrent jobs share a few threads:
+ *
+ *   core::ThreadPool workers(2);
+ *   core::CompletionReactor reactor(engine.get_device_ptr(),
+ *                                   core::CompletionReactor::on(workers));
+ *
+ *   Task handle(Request request) {
+ *     const auto seq = engine.sequence();
+ *     seq->simple_record_commands(*algo, n);
+ *     co_await reactor.launch(*seq);  // resumes on 'workers'
+ *     ...
+ *   }
+ *
+ * The reactor resets the fence before resuming, as sync() would. Destroying
+ * the reactor waits for the submissions it still watches.
+ */
+class CompletionReactor {
+ public:
+  /**
+   * @brief Resumes a coroutine whose GPU work has finished.
+   */
+  using Executor = std::function<void(std::coroutine_handle<>)>;
+
+  /**
+   * @brief An executor resuming coroutines on the workers of a pool. The pool
+   * must outlive the reactor.
+   */
+  [[nodiscard]] static Executor on(ThreadPool &pool) {
+    return [&pool](const std::coroutine_handle<> handle) {
+      static_cast<void>(pool.submit([handle] { handle.resume(); }));
+    };
+  }
+
+  /**
+   * @param device_ptr The device of the fences.
+   * @param executor Where to resume coroutines. By default they are resumed
+   * on the reactor thread, which then waits for nothing else meanwhile, so
+   * they should hand off any real work.
+   */
+  explicit CompletionReactor(std::shared_ptr<vk::Device> device_ptr,
+                             Executor executor = nullptr);
+
+  ~CompletionReactor();
+
+  CompletionReactor(const CompletionReactor &) = delete;
+  CompletionReactor &operator=(const CompletionReactor &) = delete;
+
+  /**
+   * @brief Awaitable of one submission. co_await submits the sequence (as
+   * launch_kernel_async()) and suspends until the GPU has finished it.
+   */
+  class LaunchAwaitable {
+   public:
+    LaunchAwaitable(CompletionReactor &reactor, Sequence &seq)
+        : reactor_(reactor), seq_(seq) {}
+
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+    void await_suspend(const std::coroutine_handle<> handle) const {
+      seq_.launch_kernel_async();
+      // May resume the coroutine right away, on another thread, so nothing
+      // may touch the awaitable after this
+      reactor_.watch(seq_.get_fence(), handle);
+    }
+
+    void await_resume() const noexcept {}
+
+   private:
+    CompletionReactor &reactor_;
+    Sequence &seq_;
+  };
+
+  /**
+   * @brief co_await reactor.launch(seq): submit the recorded commands of
+   * 'seq' and resume once they have finished.
+   */
+  [[nodiscard]] LaunchAwaitable launch(Sequence &seq) { return {*this, seq}; }
+
+  /**
+   * @brief Resume 'handle' on the executor once 'fence' is signaled, after
+   * resetting it. For submissions made outside of launch().
+   */
+  void watch(vk::Fence fence, std::coroutine_handle<> handle);
+
+  /**
+   * @brief Number of submissions being waited for.
+   */
+  [[nodiscard]] size_t num_pending() const {
+    std::lock_guard lock(mutex_);
+    return num_pending_;
+  }
+
+ private:
+  struct Pending {
+    vk::Fence fence;
+    std::coroutine_handle<> handle;
+  };
+
+  void run();
+
+  std::shared_ptr<vk::Device> device_ptr_;
+  Executor executor_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Pending> incoming_;  // added since the reactor last looked
+  size_t num_pending_ = 0;
+  bool stopping_ = false;
+
+  std::thread thread_;
+};
+
+}  // namespace core
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <vector>
+
+namespace core {
+
+/**
+ * @brief A set of byte ranges [begin, end), kept sorted and merged:
+ * overlapping or adjacent ranges become one. Used by Buffer to remember which
+ * parts were written by the host since the last upload.
+ */
+class DirtyRanges {
+ public:
+  struct Range {
+    uint64_t begin;
+    uint64_t end;
+
+    [[nodiscard]] uint64_t size() const { return end - begin; }
+  };
+
+  void add(const uint64_t offset, const uint64_t size) {
+    if (size == 0) {
+      return;
+    }
+    auto begin = offset;
+    auto end = offset + size;
+
+    // Swallow a range starting before 'begin' that reaches it ...
+    auto it = ranges_.upper_bound(begin);
+    if (it != ranges_.begin()) {
+      if (const auto prev = std::prev(it); prev->second >= begin) {
+        begin = prev->first;
+        end = std::max(end, prev->second);
+        it = ranges_.erase(prev);
+      }
+    }
+    // ... and all ranges starting inside (or right after) [begin, end)
+    while (it != ranges_.end() && it->first <= end) {
+      end = std::max(end, it->second);
+      it = ranges_.erase(it);
+    }
+    ranges_.emplace(begin, end);
+  }
+
+  void clear() { ranges_.clear(); }
+
+  [[nodiscard]] bool empty() const { return ranges_.empty(); }
+
+  /**
+   * @brief Number of disjoint ranges.
+   */
+  [[nodiscard]] size_t size() const { return ranges_.size(); }
+
+  /**
+   * @brief Total number of dirty bytes.
+   */
+  [[nodiscard]] uint64_t bytes() const {
+    uint64_t total = 0;
+    for (const auto &[begin, end] : ranges_) {
+      total += end - begin;
+    }
+    return total;
+  }
+
+  /**
+   * @brief The ranges widened to multiples of 'alignment' (e.g.
+   * nonCoherentAtomSize) and clamped to 'limit', merged again where the
+   * widening made them touch.
+   */
+  [[nodiscard]] std::vector<Range> aligned(const uint64_t alignment,
+                                           const uint64_t limit) const {
+    std::vector<Range> result;
+    result.reserve(ranges_.size());
+    for (const auto &[begin, end] : ranges_) {
+      const auto a_begin = begin / alignment * alignment;
+      const auto a_end =
+          std::min(limit, (end + alignment - 1) / alignment * alignment);
+      if (!result.empty() && result.back().end >= a_begin) {
+        result.back().end = std::max(result.back().end, a_end);
+      } else {
+        result.push_back({a_begin, a_end});
+      }
+    }
+    return result;
+  }
+
+ private:
+  // begin -> end
+  std::map<uint64_t, uint64_t> ranges_;
+};
+
+}  // namespace core
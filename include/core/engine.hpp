@@ -1,12 +1,22 @@
 #pragma once
 
+#include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vulkan/vulkan.hpp>
 
 #include "algorithm.hpp"
 #include "base_engine.hpp"
 #include "buffer.hpp"
+#include "buffer_pool.hpp"
+#include "command_pools.hpp"
+#include "memory_tracker.hpp"
+#include "pipeline_stats.hpp"
+#include "pipeline_warmup.hpp"
 #include "sequence.hpp"
+#include "transient_buffers.hpp"
+#include "tuning_profile.hpp"
 
 template <typename T, typename... Args>
 concept EngineComponentArgsMatch =
@@ -20,10 +30,32 @@ namespace core {
  *
  * It also manages the lifetime of these resources, and frees them when
  * necessary.
+ *
+ * Thread safety: buffer(), staged_buffer(), transient_buffers(),
+ * import_host_memory(), load_point_file(), sequence(), secondary_sequence(),
+ * algorithm(), dispatch_args_algorithm(), pipeline_stats(),
+ * pipeline_statistics_query() and the memory queries can be called from any
+ * number of threads at once. Sequences submit under a shared queue lock, so
+ * launch_kernel_async() is safe too. The soft limit is checked before
+ * allocating, so concurrent allocations may overshoot it a little.
+ *
+ * Not thread-safe, call them from one thread while no other is using the
+ * engine: configuration (enable_buffer_pool(), set_memory_soft_limit()),
+ * autotune(), save_tuning_profile() and destroy().
+ * Each Sequence, SecondarySequence and Buffer is only safe to use from one
+ * thread at a time, and an Algorithm recorded by several threads must not be
+ * changed (set_variant(), set_push_constants()) meanwhile.
  */
 class ComputeEngine : public BaseEngine {
  public:
-  ComputeEngine() : vkh_device_(device_.device) {}
+  explicit ComputeEngine(const EngineConfig &config = {})
+      : BaseEngine(config),
+        vkh_device_(device_.device),
+        command_pools_(std::make_shared<CommandPools>(
+            get_device_ptr(),
+            device_.get_queue_index(vkb::QueueType::compute).value())) {
+    load_tuning_profile();
+  }
 
   ~ComputeEngine() {
     spdlog::debug("ComputeEngine::~ComputeEngine");
@@ -35,32 +67,90 @@ class ComputeEngine : public BaseEngine {
   /**
    * @brief It sucks, but this function takes the N*sizeof(T)
    *
+   * With the buffer pool enabled, the buffer may be a recycled one (with old
+   * contents) and its size is rounded up to a size class.
+   *
    * @param size
+   * @param usage Buffer usage, add eIndirectBuffer for dispatch arguments.
    * @return std::shared_ptr<Buffer>
+   * @throws OutOfBudgetError if it would exceed the soft limit or the heap
+   * budget, see set_memory_soft_limit().
    */
-  [[nodiscard]] std::shared_ptr<Buffer> buffer(vk::DeviceSize size) {
-    auto buf = std::make_shared<Buffer>(get_device_ptr(), size);
+  [[nodiscard]] std::shared_ptr<Buffer> buffer(
+      vk::DeviceSize size,
+      vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer) {
+    auto buf = buffer_pool_ ? buffer_pool_->acquire(size, usage)
+                            : std::shared_ptr(allocate_buffer(size, usage));
     if (manage_resources_) {
-      buffers_.push_back(buf);
+      register_resource(buffers_, buf);
     }
     return buf;
   }
 
+  /**
+   * @brief A buffer in device local memory, written by the host through a
+   * mapped staging buffer of the same size. Host writes (tmp_write_data() or
+   * get_data_mut() + mark_dirty()) are tracked, and
+   * Sequence::record_upload() copies only the changed ranges. get_data() is
+   * nullptr, the device side is not mapped. Never pooled. The staging buffer
+   * is not double-buffered: sync() the upload before writing again.
+   *
+   * @param size Size in bytes.
+   * @param usage Buffer usage, eTransferDst is added.
+   * @return std::shared_ptr<Buffer>
+   * @throws OutOfBudgetError see buffer().
+   */
+  [[nodiscard]] std::shared_ptr<Buffer> staged_buffer(
+      vk::DeviceSize size,
+      vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer);
+
+  /**
+   * @brief Device-only buffers for the intermediate results of a multi-stage
+   * computation. Buffers whose stages do not overlap share memory, so the
+   * whole set takes what its worst stage needs, see TransientBuffers.
+   *
+   * @param plan The buffers and the stages using them.
+   * @return The buffers, in the order they were added to the plan.
+   * @throws OutOfBudgetError see buffer().
+   */
+  [[nodiscard]] std::shared_ptr<TransientBuffers> transient_buffers(
+      const TransientPlan &plan);
+
   [[nodiscard]] std::shared_ptr<Sequence> sequence() {
-    auto seq = std::make_shared<Sequence>(get_device_ptr(), device_, queue_);
+    auto seq = std::make_shared<Sequence>(
+        get_device_ptr(), device_, queue_, &queue_mutex_);
     if (manage_resources_) {
-      sequence_.push_back(seq);
+      register_resource(sequence_, seq);
     }
     return seq;
   }
 
+  /**
+   * @brief A secondary command buffer from the calling thread's command pool,
+   * to record part of a submission in parallel with other threads. Record it
+   * on this thread, and execute it with Sequence::record_execute().
+   */
+  [[nodiscard]] std::shared_ptr<SecondarySequence> secondary_sequence() {
+    return std::make_shared<SecondarySequence>(get_device_ptr(),
+                                               command_pools_);
+  }
+
+  /**
+   * @brief Number of per-thread command pools created by secondary_sequence()
+   * so far, i.e. of threads that recorded secondaries.
+   */
+  [[nodiscard]] size_t num_command_pools() const {
+    return command_pools_->num_pools();
+  }
+
   /**
    * @brief Creates a new instance of the Algorithm class with the given
    * arguments.
    *
    * @tparam Args The types of the arguments to pass to the Algorithm
    * constructor.
-   * @param args The arguments to pass to the Algorithm constructor.
+   * @param args The arguments to pass to the Algorithm constructor, after the
+   * device and this engine's pipeline cache.
    * @return std::shared_ptr<Algorithm> A shared pointer to the newly created
    * Algorithm instance.
    * @throws std::invalid_argument if the given arguments do not match the
@@ -68,26 +158,331 @@ class ComputeEngine : public BaseEngine {
    */
   template <typename... Args>
   [[nodiscard]] auto algorithm(Args &&...args) -> std::shared_ptr<Algorithm>
-    requires EngineComponentArgsMatch<Algorithm, Args...>
+    requires EngineComponentArgsMatch<Algorithm, vk::PipelineCache, Args...>
   {
-    auto algo = std::make_shared<Algorithm>(get_device_ptr(),
-                                            std::forward<Args>(args)...);
+    auto algo = std::make_shared<Algorithm>(
+        get_device_ptr(), pipeline_cache_, std::forward<Args>(args)...);
     if (manage_resources_) {
-      algorithms_.push_back(algo);
+      register_resource(algorithms_, algo);
     }
     return algo;
   }
 
+  /**
+   * @brief Wrap host memory as a Buffer without copying, using
+   * VK_EXT_external_memory_host. 'data' and 'size' must be multiples of
+   * get_external_memory_host_alignment().
+   *
+   * @param data Host memory, e.g. from mmap. Must stay valid while the buffer
+   * lives, which is what 'keep_alive' is for.
+   * @param size Size in bytes.
+   * @param keep_alive Owner of the host memory, released with the buffer.
+   * @return The buffer, or nullptr if the extension is not supported or the
+   * driver rejects this memory.
+   */
+  [[nodiscard]] std::shared_ptr<Buffer> import_host_memory(
+      std::byte *data,
+      vk::DeviceSize size,
+      std::shared_ptr<const void> keep_alive);
+
+  /**
+   * @brief Load a binary point file (a raw array of records, e.g. glm::vec4)
+   * into a Buffer. Where possible the file is mmap'ed and its pages imported
+   * directly (zero copy). Otherwise the file is read straight into a mapped
+   * buffer, without an intermediate host copy.
+   *
+   * The buffer can be slightly bigger than the file (rounded up to the import
+   * alignment), the extra bytes are zeros.
+   *
+   * @param path The point file.
+   * @param element_size Size of one record, the file size must be a multiple.
+   * @return std::shared_ptr<Buffer>
+   * @throws std::runtime_error if the file cannot be read.
+   */
+  [[nodiscard]] std::shared_ptr<Buffer> load_point_file(
+      const std::filesystem::path &path, size_t element_size = 16);
+
+  /**
+   * @brief A buffer for one VkDispatchIndirectCommand (3 uint32), usable both
+   * as a storage buffer (written by a shader) and as an indirect buffer.
+   */
+  [[nodiscard]] std::shared_ptr<Buffer> dispatch_args_buffer() {
+    return buffer(3 * sizeof(uint32_t),
+                  vk::BufferUsageFlagBits::eStorageBuffer |
+                      vk::BufferUsageFlagBits::eIndirectBuffer);
+  }
+
+  /**
+   * @brief Creates the tiny kernel that turns an element count computed on the
+   * GPU into workgroup counts for Algorithm::record_dispatch_indirect().
+   * It reads 'count_buf[0] + count_adjust' (clamped at 0) and writes the
+   * workgroup counts of Algorithm::num_blocks() into 'args_buf': up to 65535
+   * in X, beyond that spread over rows in Y. Counts that would need more than
+   * 65535 rows are cut short, the kernel cannot report an error.
+   *
+   * Record it before the target algorithm, followed by
+   * Sequence::record_indirect_barrier(). If the target switches to another
+   * workgroup size (e.g. tune_for()), create this algorithm again.
+   *
+   * @param target The algorithm that will be dispatched indirectly.
+   * @param count_buf Buffer whose first uint32 is the element count.
+   * @param args_buf Output, see dispatch_args_buffer().
+   * @param count_adjust Added to the count, e.g. -1 for 'n - 1' tree nodes.
+   * @return std::shared_ptr<Algorithm> Dispatch it with 1 element.
+   */
+  [[nodiscard]] std::shared_ptr<Algorithm> dispatch_args_algorithm(
+      const Algorithm &target,
+      const std::shared_ptr<Buffer> &count_buf,
+      const std::shared_ptr<Buffer> &args_buf,
+      int32_t count_adjust = 0);
+
+  // ---------------------------------------------------------------------------
+  //                            Pipeline statistics
+  // ---------------------------------------------------------------------------
+
+  /**
+   * @brief Compiler statistics (registers, shared memory, spills, instruction
+   * counts) of the current variant of an Algorithm. Compiles the variant once
+   * more, so do it outside of timed code.
+   *
+   * @param algo The algorithm.
+   * @return The statistics, with no executables if the device does not have
+   * DeviceFeatures::pipeline_executable_info enabled. Fill in 'invocations'
+   * and 'metrics' from a run, then write_pipeline_stats_json().
+   */
+  [[nodiscard]] PipelineStats pipeline_stats(const Algorithm &algo) const;
+
+  /**
+   * @brief A query counting compute shader invocations, see
+   * PipelineStatisticsQuery.
+   *
+   * @throws std::runtime_error if DeviceFeatures::pipeline_statistics_query is
+   * not enabled.
+   */
+  [[nodiscard]] std::shared_ptr<PipelineStatisticsQuery>
+  pipeline_statistics_query();
+
+  // ---------------------------------------------------------------------------
+  //                            Autotuning
+  // ---------------------------------------------------------------------------
+
+  /**
+   * @brief Time each candidate configuration of an Algorithm on a problem of
+   * 'n' elements and record the fastest one in the tuning profile. The
+   * Algorithm is left on the winning variant. Its buffers and push constants
+   * must already be set up for 'n' elements, and the kernel is run several
+   * times, so it should not rely on its previous output.
+   *
+   * The candidates' constants are merged into the ones the Algorithm was
+   * created with. The Algorithm is then attached to the profile, as with
+   * enable_tuning(). Call save_tuning_profile() to persist the results, later
+   * engines on the same device pick them up for Algorithms passed to
+   * enable_tuning().
+   *
+   * @param algo The algorithm to tune.
+   * @param n The problem size (number of elements).
+   * @param candidates Configurations to try, e.g. workgroup_candidates().
+   * @param repetitions Dispatches per measurement, timed on the GPU with
+   * timestamp queries (on the host if the compute queue has no timestamps).
+   * @return The best configuration.
+   * @throws std::runtime_error if no candidate could be run.
+   */
+  TuningEntry autotune(Algorithm &algo,
+                       uint32_t n,
+                       const std::vector<TuningCandidate> &candidates,
+                       uint32_t repetitions = 10);
+
+  /**
+   * @brief Power of two workgroup sizes supported by this device.
+   */
+  [[nodiscard]] std::vector<TuningCandidate> workgroup_candidates() const;
+
+  void save_tuning_profile() const;
+
+  [[nodiscard]] const TuningProfile &get_tuning_profile() const {
+    return *tuning_profile_;
+  }
+
+  /**
+   * @brief Let an Algorithm use the tuning profile: Algorithm::tune_for() then
+   * switches it to the tuned workgroup size and constants. Opt-in, because
+   * some kernels (e.g. radix_sort.cl) only work at the workgroup size they
+   * were written for; never enable it for those.
+   */
+  void enable_tuning(Algorithm &algo) const {
+    algo.set_tuning_profile(tuning_profile_);
+  }
+
+  // ---------------------------------------------------------------------------
+  //                            Pipeline warm-up
+  // ---------------------------------------------------------------------------
+
+  /**
+   * @brief Workgroup size used by known_pipelines() for kernels that were never
+   * tuned.
+   */
+  static constexpr uint32_t kDefaultThreadsPerBlock = 256;
+
+  /**
+   * @brief Every shader embedded in the binary, at its tuned variants (from the
+   * tuning profile) or at kDefaultThreadsPerBlock. Kernels whose device
+   * feature is off (hilbert64.spv without shader_int64) are left out.
+   */
+  [[nodiscard]] std::vector<PipelineKey> known_pipelines() const;
+
+  /**
+   * @brief Compile the given pipelines concurrently on a thread pool, into the
+   * pipeline cache shared by all Algorithms of this engine. Call it once at
+   * startup, so creating these Algorithms later does not stall on shader
+   * compilation.
+   *
+   * Failures are logged and skipped, a missing pipeline is only slower to
+   * create later.
+   *
+   * @param keys The pipelines, e.g. known_pipelines().
+   * @param num_threads Worker threads, 0 for one per hardware thread.
+   * @return Number of pipelines built.
+   */
+  size_t warm_up_pipelines(const std::vector<PipelineKey> &keys,
+                           size_t num_threads = 0);
+
+  size_t warm_up_pipelines() { return warm_up_pipelines(known_pipelines()); }
+
+  // ---------------------------------------------------------------------------
+  //                            Buffer pool
+  // ---------------------------------------------------------------------------
+
+  /**
+   * @brief Recycle buffers: from now on buffer() serves requests from free
+   * lists of released buffers when possible, see BufferPool. Calling it again
+   * only updates the policy.
+   */
+  void enable_buffer_pool(const BufferPoolPolicy &policy = {});
+
+  /**
+   * @brief The pool, or nullptr if enable_buffer_pool() was never called.
+   * Use it for stats() and trim().
+   */
+  [[nodiscard]] BufferPool *get_buffer_pool() const {
+    return buffer_pool_.get();
+  }
+
+  // ---------------------------------------------------------------------------
+  //                            Memory usage
+  // ---------------------------------------------------------------------------
+
+  /**
+   * @brief Called when an allocation would go over the soft limit or the heap
+   * budget, after the idle buffers of the pool were freed. It may free memory
+   * (e.g. drop caches, wait for other work to release buffers) and return true
+   * to retry the allocation once. Returning false rejects it.
+   */
+  using MemoryPressureFn = std::function<bool(vk::DeviceSize requested)>;
+
+  /**
+   * @brief Limit the total size of the buffers of this engine. Allocations
+   * over the limit go to the pressure callback (if any), and are rejected
+   * with OutOfBudgetError if there is still not enough room.
+   *
+   * @param bytes The limit, 0 for no limit (default).
+   * @param on_pressure Optional callback to defer/retry the allocation.
+   */
+  void set_memory_soft_limit(vk::DeviceSize bytes,
+                             MemoryPressureFn on_pressure = nullptr) {
+    memory_soft_limit_ = bytes;
+    on_memory_pressure_ = std::move(on_pressure);
+  }
+
+  /**
+   * @brief Bytes, buffer counts per class and high-water mark of the buffers
+   * created by this engine.
+   */
+  [[nodiscard]] MemoryStats memory_stats() const {
+    return memory_tracker_->stats();
+  }
+
+  void reset_memory_high_water_mark() {
+    memory_tracker_->reset_high_water_mark();
+  }
+
+  /**
+   * @brief Live usage and budget of every memory heap of the device
+   * (vmaGetHeapBudgets). Shared by all engines of the process.
+   */
+  [[nodiscard]] std::vector<HeapUsage> heap_usage() const;
+
+  /**
+   * @brief Log memory_stats() and heap_usage() at info level.
+   */
+  void log_memory_report() const;
+
  private:
+  void load_tuning_profile();
+
+  /**
+   * @brief A new, tracked buffer of exactly 'size' bytes.
+   */
+  [[nodiscard]] std::unique_ptr<Buffer> allocate_buffer(
+      vk::DeviceSize size, vk::BufferUsageFlags usage);
+
+  /**
+   * @brief Add a resource to a registry, dropping the entries of dead
+   * resources whenever the registry would grow, so it stays proportional to
+   * the number of live resources.
+   */
+  template <typename T>
+  void register_resource(std::vector<std::weak_ptr<T>> &registry,
+                         const std::shared_ptr<T> &resource) {
+    std::lock_guard lock(registry_mutex_);
+    if (registry.size() == registry.capacity()) {
+      std::erase_if(registry,
+                    [](const std::weak_ptr<T> &w) { return w.expired(); });
+    }
+    registry.push_back(resource);
+  }
+
+  /**
+   * @brief Check an allocation of 'size' bytes against the soft limit and the
+   * budget of the heap it would be allocated from: device local memory if
+   * 'device_local', otherwise the mapped memory of a default Buffer.
+   *
+   * @throws OutOfBudgetError if there is not enough room.
+   */
+  void reserve_memory(vk::DeviceSize size,
+                      vk::BufferUsageFlags usage,
+                      bool device_local = false);
+
+  /**
+   * @brief Why 'size' more bytes do not fit, or an empty string if they do.
+   */
+  [[nodiscard]] std::string over_budget_reason(vk::DeviceSize size,
+                                               vk::BufferUsageFlags usage,
+                                               bool device_local) const;
+
   vk::Device vkh_device_;
 
   std::vector<std::weak_ptr<Algorithm>> algorithms_;
   std::vector<std::weak_ptr<Buffer>> buffers_;
   std::vector<std::weak_ptr<Sequence>> sequence_;
+  std::vector<std::weak_ptr<PipelineStatisticsQuery>> queries_;
+  std::vector<std::weak_ptr<TransientBuffers>> transients_;
+  std::mutex registry_mutex_;
+
+  // Secondary command buffers, one pool per recording thread
+  std::shared_ptr<CommandPools> command_pools_;
 
   /**
    * @brief Should the engine manage the above resources?
    */
   bool manage_resources_ = true;
+
+  std::shared_ptr<TuningProfile> tuning_profile_;
+
+  std::shared_ptr<BufferPool> buffer_pool_;
+
+  std::shared_ptr<MemoryTracker> memory_tracker_ =
+      std::make_shared<MemoryTracker>();
+  vk::DeviceSize memory_soft_limit_ = 0;
+  MemoryPressureFn on_memory_pressure_;
 };
 }  // namespace core
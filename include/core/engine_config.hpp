@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "VkBootstrap.h"
+
+namespace core {
+
+/**
+ * @brief Optional device features. Used both to ask for features
+ * (EngineConfig) and to report what the device has enabled
+ * (BaseEngine::get_features()).
+ */
+struct DeviceFeatures {
+  // storageBuffer16BitAccess: 16-bit types in storage buffers
+  bool storage_buffer_16bit = false;
+
+  // Basic, vote, arithmetic, ballot and shuffle subgroup operations in
+  // compute shaders. A property of the device, nothing to enable.
+  bool subgroup_ops = false;
+
+  // bufferDeviceAddress: raw GPU pointers to buffers
+  bool buffer_device_address = false;
+
+  // timelineSemaphore: semaphores with a 64-bit counter
+  bool timeline_semaphores = false;
+
+  // pipelineStatisticsQuery: count shader invocations with a query, see
+  // PipelineStatisticsQuery
+  bool pipeline_statistics_query = false;
+
+  // pipelineExecutableInfo (VK_KHR_pipeline_executable_properties): compiler
+  // statistics of pipelines, see ComputeEngine::pipeline_stats()
+  bool pipeline_executable_info = false;
+
+  // shaderInt64: 64-bit integers (ulong) in shaders, e.g. hilbert64.cl
+  bool shader_int64 = false;
+};
+
+/**
+ * @brief How BaseEngine sets up the instance and the device. The defaults
+ * match a debug build on a discrete GPU:
+ *
+ *   core::ComputeEngine engine(core::EngineConfig{
+ *       .enable_validation = false,
+ *       .device_type = vkb::PreferredDeviceType::cpu,  // e.g. lavapipe
+ *       .desired_features = {.subgroup_ops = true},
+ *   });
+ */
+struct EngineConfig {
+  std::string app_name = "Example Vulkan Application";
+
+  // Validation layers and the debug messenger. They multiply the cost of
+  // recording and submitting, so they are off in release builds.
+#if defined(NDEBUG)
+  bool enable_validation = false;
+#else
+  bool enable_validation = true;
+#endif
+
+  // Which kind of device to pick. 'cpu' selects software implementations
+  // such as lavapipe or SwiftShader.
+  vkb::PreferredDeviceType device_type = vkb::PreferredDeviceType::discrete;
+
+  // Fall back to another kind of device if there is none of 'device_type'.
+  bool allow_other_device_types = false;
+
+  // Device extensions. Devices without a required one are not selected,
+  // desired ones are enabled when available.
+  std::vector<std::string> required_extensions;
+  std::vector<std::string> desired_extensions;
+
+  // Features the selected device must have (or the engine fails to start),
+  // and features enabled only when available.
+  DeviceFeatures required_features;
+  DeviceFeatures desired_features;
+};
+
+}  // namespace core
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace core {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Read-only view of a whole file through mmap. The pages are mapped
+ * private and writable (copy on write), because some drivers refuse to import
+ * read-only host memory. Nothing is ever written back to the file.
+ *
+ * The mapping length is rounded up to whole pages, the bytes past the end of
+ * the file are zeros.
+ */
+class MappedFile {
+ public:
+  /**
+   * @brief Map the file.
+   *
+   * @param path The file to map.
+   * @throws std::runtime_error if the file cannot be opened or mapped.
+   */
+  explicit MappedFile(const fs::path &path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  [[nodiscard]] std::byte *data() const { return data_; }
+
+  // Size of the file in bytes
+  [[nodiscard]] size_t size() const { return size_; }
+
+  // Size of the mapping in bytes (whole pages)
+  [[nodiscard]] size_t mapped_size() const { return mapped_size_; }
+
+  [[nodiscard]] static size_t page_size();
+
+ private:
+  std::byte *data_ = nullptr;
+  size_t size_ = 0;
+  size_t mapped_size_ = 0;
+};
+
+}  // namespace core
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan.hpp>
+
+namespace core {
+
+/**
+ * @brief Rough classification of buffers for the memory statistics.
+ */
+enum class BufferClass : uint8_t {
+  kStorage = 0,    // regular storage buffers
+  kIndirect = 1,   // buffers that can hold indirect dispatch arguments
+  kImported = 2,   // host memory imported with VK_EXT_external_memory_host
+  kStaging = 3,    // host side of staged (device local) buffers
+  kTransient = 4,  // memory blocks shared by TransientBuffers
+};
+
+constexpr size_t kNumBufferClasses = 5;
+
+[[nodiscard]] constexpr const char *to_string(const BufferClass c) {
+  switch (c) {
+    case BufferClass::kStorage:
+      return "storage";
+    case BufferClass::kIndirect:
+      return "indirect";
+    case BufferClass::kImported:
+      return "imported";
+    case BufferClass::kStaging:
+      return "staging";
+    case BufferClass::kTransient:
+      return "transient";
+  }
+  return "unknown";
+}
+
+[[nodiscard]] constexpr BufferClass classify_buffer(
+    const vk::BufferUsageFlags usage) {
+  return (usage & vk::BufferUsageFlagBits::eIndirectBuffer)
+             ? BufferClass::kIndirect
+             : BufferClass::kStorage;
+}
+
+/**
+ * @brief Snapshot of the buffers created by one engine.
+ */
+struct MemoryStats {
+  std::array<vk::DeviceSize, kNumBufferClasses> bytes_per_class{};
+  std::array<uint32_t, kNumBufferClasses> buffers_per_class{};
+
+  vk::DeviceSize total_bytes = 0;      // currently alive
+  vk::DeviceSize high_water_mark = 0;  // peak of total_bytes
+  uint32_t live_allocations = 0;
+  uint64_t total_allocations = 0;     // over the engine's lifetime
+  uint64_t rejected_allocations = 0;  // refused by the soft limit
+};
+
+/**
+ * @brief Live memory usage of a device heap, from vmaGetHeapBudgets(). Covers
+ * every allocation of the process on this heap, not just one engine.
+ */
+struct HeapUsage {
+  uint32_t heap_index = 0;
+  bool device_local = false;
+  vk::DeviceSize usage = 0;   // estimated bytes in use (all processes)
+  vk::DeviceSize budget = 0;  // estimated bytes available to this process
+  vk::DeviceSize block_bytes = 0;
+  vk::DeviceSize allocation_bytes = 0;
+  uint32_t block_count = 0;
+  uint32_t allocation_count = 0;
+};
+
+/**
+ * @brief Thrown when an allocation would go over the engine's soft limit or
+ * the heap budget, before the driver itself fails.
+ */
+class OutOfBudgetError : public std::runtime_error {
+ public:
+  explicit OutOfBudgetError(const std::string &what)
+      : std::runtime_error(what) {}
+};
+
+/**
+ * @brief Counts the bytes of the buffers of one engine. Shared between the
+ * engine and its buffers, so buffers can report when they are freed, even if
+ * they outlive the engine's registry.
+ */
+class MemoryTracker {
+ public:
+  void on_allocate(const BufferClass c, const vk::DeviceSize size) {
+    std::lock_guard lock(mutex_);
+    const auto i = static_cast<size_t>(c);
+    stats_.bytes_per_class[i] += size;
+    ++stats_.buffers_per_class[i];
+    stats_.total_bytes += size;
+    stats_.high_water_mark =
+        std::max(stats_.high_water_mark, stats_.total_bytes);
+    ++stats_.live_allocations;
+    ++stats_.total_allocations;
+  }
+
+  void on_free(const BufferClass c, const vk::DeviceSize size) {
+    std::lock_guard lock(mutex_);
+    const auto i = static_cast<size_t>(c);
+    stats_.bytes_per_class[i] -= size;
+    --stats_.buffers_per_class[i];
+    stats_.total_bytes -= size;
+    --stats_.live_allocations;
+  }
+
+  void on_reject() {
+    std::lock_guard lock(mutex_);
+    ++stats_.rejected_allocations;
+  }
+
+  [[nodiscard]] MemoryStats stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+  }
+
+  void reset_high_water_mark() {
+    std::lock_guard lock(mutex_);
+    stats_.high_water_mark = stats_.total_bytes;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  MemoryStats stats_;
+};
+
+}  // namespace core
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vulkan_resource.hpp"
+
+namespace core {
+
+/**
+ * @brief One statistic of a pipeline executable, as reported by the driver
+ * (VK_KHR_pipeline_executable_properties). Names and meanings are
+ * vendor-specific, booleans are 0/1.
+ */
+struct ExecutableStatistic {
+  std::string name;
+  std::string description;
+  double value = 0.0;
+};
+
+/**
+ * @brief Compiler statistics of one executable of a pipeline, i.e. one
+ * compiled form of the shader (a compute pipeline usually has one, some
+ * drivers report one per SIMD width).
+ *
+ * The common counters are picked out of 'statistics' by name, they are empty
+ * if the driver reports nothing that looks like them:
+ *   - registers: "VGPRs" (AMD), "register" (others)
+ *   - shared_memory_bytes: "LDS", "shared" or "workgroup memory"
+ *   - spills: sum of all "spill" statistics (e.g. SGPRs + VGPRs)
+ *   - instructions: first "instruction" statistic
+ */
+struct PipelineExecutableStats {
+  std::string name;
+  std::string description;
+  uint32_t subgroup_size = 0;
+
+  std::optional<uint64_t> registers;
+  std::optional<uint64_t> shared_memory_bytes;
+  std::optional<uint64_t> spills;
+  std::optional<uint64_t> instructions;
+
+  std::vector<ExecutableStatistic> statistics;
+};
+
+/**
+ * @brief Fill the common counters of 'stats' from its raw statistics.
+ */
+void summarize_statistics(PipelineExecutableStats &stats);
+
+/**
+ * @brief What is known about one pipeline (variant of an Algorithm): its
+ * compiler statistics, and what a run of it measured.
+ */
+struct PipelineStats {
+  std::string kernel;
+  uint32_t threads_per_block = 0;
+
+  // Empty if the device has no pipeline_executable_info
+  std::vector<PipelineExecutableStats> executables;
+
+  // Compute shader invocations, from a PipelineStatisticsQuery
+  std::optional<uint64_t> invocations;
+
+  // Anything else the caller measured, e.g. {"time_ms", 1.5}
+  std::vector<std::pair<std::string, double>> metrics;
+};
+
+/**
+ * @brief Write pipeline statistics as JSON, one object per pipeline:
+ *
+ *   {"pipelines":[{"kernel":"morton32.spv","threads_per_block":256,
+ *     "invocations":4194304,"metrics":{"time_ms":1.5},
+ *     "executables":[{"name":"Compute Shader","subgroup_size":64,
+ *       "registers":24,"spills":0,...,"statistics":{"VGPRs":24,...}}]}]}
+ *
+ * Counters that are not known are left out. Metrics and statistics that are
+ * not finite (NaN, inf) are written as null.
+ *
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void write_pipeline_stats_json(const std::filesystem::path &path,
+                               const std::vector<PipelineStats> &pipelines);
+
+/**
+ * @brief A pipeline statistics query counting compute shader invocations
+ * (needs DeviceFeatures::pipeline_statistics_query). Wrap the dispatches to
+ * measure, all in one command buffer:
+ *
+ *   seq->cmd_begin();
+ *   query->record_reset(seq->get_handle());
+ *   query->record_begin(seq->get_handle());
+ *   ... record the dispatches ...
+ *   query->record_end(seq->get_handle());
+ *   seq->cmd_end();
+ *
+ * Create it with ComputeEngine::pipeline_statistics_query().
+ */
+class PipelineStatisticsQuery final : public VulkanResource<vk::QueryPool> {
+ public:
+  explicit PipelineStatisticsQuery(std::shared_ptr<vk::Device> device_ptr);
+
+  ~PipelineStatisticsQuery() override { destroy(); }
+
+  void destroy() override;
+
+  /**
+   * @brief Reset the query, before record_begin() in every submission.
+   */
+  void record_reset(const vk::CommandBuffer &cmd_buf) const;
+  void record_begin(const vk::CommandBuffer &cmd_buf) const;
+  void record_end(const vk::CommandBuffer &cmd_buf) const;
+
+  /**
+   * @brief Compute shader invocations between record_begin() and
+   * record_end(). Waits for the result, so call it after Sequence::sync().
+   */
+  [[nodiscard]] uint64_t get_invocations() const;
+};
+
+}  // namespace core
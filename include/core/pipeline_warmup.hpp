@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vulkan/vulkan.hpp>
+
+#include "spec_constants.hpp"
+
+namespace core {
+
+/**
+ * @brief Identifies one compute pipeline variant: the shader and the constants
+ * it is specialized with. The pipeline layout is reflected from the SPIR-V.
+ */
+struct PipelineKey {
+  std::string spirv_filename;
+  uint32_t threads_per_block;
+  bool is_clspv;
+  SpecConstants spec_constants = {};
+};
+
+/**
+ * @brief Build the pipeline of 'key' into 'cache' and throw everything else
+ * away. Creating the same pipeline later (e.g. in an Algorithm) then hits the
+ * cache instead of compiling the shader again.
+ *
+ * The descriptor set layout (one storage buffer per binding) and the push
+ * constant range are reflected from the shader, the same way Algorithm builds
+ * them. Safe to call from several threads at once.
+ *
+ * @throws std::runtime_error if the shader cannot be loaded, vk::SystemError
+ * if the pipeline cannot be created.
+ */
+void warm_up_pipeline(vk::Device device,
+                      vk::PipelineCache cache,
+                      const PipelineKey &key);
+
+}  // namespace core
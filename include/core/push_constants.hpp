@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace core {
+
+/**
+ * @brief Vulkan guarantees at least 128 bytes of push constant space, so
+ * anything bigger than this is not portable.
+ */
+constexpr uint32_t kMaxPushConstantsSize = 128;
+
+/**
+ * @brief A push constant block is any plain struct that can be memcpy'ed to
+ * the GPU. Every member should be 4 bytes wide (uint32_t, int32_t, float), or
+ * at least the struct size must be a multiple of 4, as required by
+ * vkCmdPushConstants.
+ */
+template <typename T>
+concept PushConstantT =
+    std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> &&
+    sizeof(T) % 4 == 0 && sizeof(T) <= kMaxPushConstantsSize;
+
+/**
+ * @brief For CLSPV generated shader, the first 16 bytes of the push constants
+ * are reserved for the global offset (uint3, padded to 16 bytes). The kernel
+ * arguments come right after it.
+ *
+ * Check  https://github.com/google/clspv/blob/main/docs/OpenCLCOnVulkan.md
+ * for more details.
+ *
+ * @tparam T The struct matching the POD arguments of the kernel, in order.
+ */
+template <PushConstantT T>
+struct ClspvPushConstants {
+  std::array<uint32_t, 4> global_offset{};
+  T args;
+};
+
+/**
+ * @brief Type erased storage of a push constant block. It remembers the size
+ * of the struct it was created from, so the Algorithm can check it against
+ * the push constant block declared in the shader.
+ */
+class PushConstants {
+ public:
+  PushConstants() = default;
+
+  template <PushConstantT T>
+  explicit PushConstants(const T &value) : data_(sizeof(T)) {
+    std::memcpy(data_.data(), &value, sizeof(T));
+  }
+
+  /**
+   * @brief Overwrite the content. The pipeline layout is created with a fixed
+   * push constant range, so the new struct must have the same size.
+   */
+  template <PushConstantT T>
+  void set(const T &value) {
+    if (!data_.empty() && sizeof(T) != data_.size()) {
+      throw std::invalid_argument("Push constant size mismatch");
+    }
+    data_.resize(sizeof(T));
+    std::memcpy(data_.data(), &value, sizeof(T));
+  }
+
+  template <PushConstantT T>
+  [[nodiscard]] T get() const {
+    if (sizeof(T) != data_.size()) {
+      throw std::invalid_argument("Push constant size mismatch");
+    }
+    T value;
+    std::memcpy(&value, data_.data(), sizeof(T));
+    return value;
+  }
+
+  [[nodiscard]] const std::byte *data() const { return data_.data(); }
+  [[nodiscard]] uint32_t size() const {
+    return static_cast<uint32_t>(data_.size());
+  }
+  [[nodiscard]] bool empty() const { return data_.empty(); }
+
+ private:
+  std::vector<std::byte> data_;
+};
+
+}  // namespace core
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "VkBootstrap.h"
 #include "algorithm.hpp"
+#include "command_pools.hpp"
+#include "trace.hpp"
 #include "vulkan_resource.hpp"
 
 namespace core {
 
+class SecondarySequence;
+
 /**
  * @brief Sequence class is an abstraction of a Vulkan command buffer. It
  * handles command pool/buffer, synchronization, etc.
@@ -13,6 +21,11 @@ namespace core {
  *
  * You can attached an Algorithm to a Sequence, and call record() to record the
  * commands. It bind pipeline, push constants, and dispatch.
+ *
+ * A Sequence owns its command pool, so it can be recorded on any thread, but
+ * only one thread may use a given Sequence at a time. To record one
+ * submission from several threads, record SecondarySequences in parallel and
+ * execute them from this one, see record_execute().
  */
 class Sequence final : public VulkanResource<vk::CommandBuffer> {
  public:
@@ -23,13 +36,18 @@ class Sequence final : public VulkanResource<vk::CommandBuffer> {
    * @param device_ptr Pointer to the device
    * @param vkb_device vkb::Device object
    * @param queue Queue to submit the commands
+   * @param queue_mutex Held while submitting to 'queue', if the queue is
+   * shared with other threads. The queue and the mutex must outlive the
+   * Sequence.
    */
   explicit Sequence(std::shared_ptr<vk::Device> device_ptr,
                     const vkb::Device &vkb_device,
-                    vk::Queue &queue)  // tmp
+                    vk::Queue &queue,  // tmp
+                    std::mutex *queue_mutex = nullptr)
       : VulkanResource(std::move(device_ptr)),
         vkb_device_(vkb_device),
-        vkh_queue_(&queue) {
+        vkh_queue_(&queue),
+        queue_mutex_(queue_mutex) {
     create_sync_objects();
     create_command_pool();
     create_command_buffer();
@@ -53,6 +71,7 @@ class Sequence final : public VulkanResource<vk::CommandBuffer> {
    * @param n Number of elements to be processed.
    */
   void simple_record_commands(const Algorithm &algo, const uint32_t n) const {
+    VKC_TRACE_SCOPE_N("record", "Sequence::simple_record_commands", n);
     cmd_begin();
     algo.record_bind_core(handle_);
     algo.record_bind_push(handle_);
@@ -60,10 +79,46 @@ class Sequence final : public VulkanResource<vk::CommandBuffer> {
     cmd_end();
   }
 
+  /**
+   * @brief Upload what the host changed in a buffer since the last upload,
+   * see Buffer::record_upload(). Record it before the dispatches reading it,
+   * and sync() before the host writes to the buffer again.
+   *
+   * @return Number of bytes copied (0 for mapped buffers, which are flushed).
+   */
+  vk::DeviceSize record_upload(Buffer &buffer) const {
+    return buffer.record_upload(handle_);
+  }
+
+  /**
+   * @brief Make the results of previous dispatches visible to the following
+   * ones (compute -> compute memory barrier).
+   */
+  void record_compute_barrier() const;
+
+  /**
+   * @brief Make workgroup counts written by a compute shader visible to a
+   * following vkCmdDispatchIndirect (compute -> indirect command read), along
+   * with the usual compute -> compute dependency.
+   */
+  void record_indirect_barrier() const;
+
+  /**
+   * @brief Execute secondary command buffers, in order, as part of this one
+   * (vkCmdExecuteCommands). They must be ended, and stay alive until this
+   * Sequence has finished executing (sync()). Barriers between them are up to
+   * the secondaries themselves.
+   */
+  void record_execute(
+      const std::vector<std::shared_ptr<SecondarySequence>> &secondaries) const;
+
   /**
    * @brief Once all commands are recorded, you can launch the kernel. It will
    * submit all the commands to the GPU. It is asynchronous, so you can do other
    * CPU tasks while the GPU is processing.
+   *
+   * Thread-safe with respect to other Sequences submitting to the same queue,
+   * if a queue mutex was given.
    */
   void launch_kernel_async();
 
@@ -73,6 +128,13 @@ class Sequence final : public VulkanResource<vk::CommandBuffer> {
    */
   void sync() const;
 
+  /**
+   * @brief Signaled when the last submission has finished. sync() resets it,
+   * whoever else waits on it must reset it before the next launch (see
+   * CompletionReactor).
+   */
+  [[nodiscard]] vk::Fence get_fence() const { return fence_; }
+
  protected:
   // ---------------------------------------------------------------------------
   //                            Helpers
@@ -86,8 +148,77 @@ class Sequence final : public VulkanResource<vk::CommandBuffer> {
   // Vulkan components
   const vkb::Device &vkb_device_;
   vk::Queue *vkh_queue_;
+  std::mutex *queue_mutex_;
   vk::CommandPool command_pool_;
   vk::Fence fence_;
 };
 
+/**
+ * @brief A secondary command buffer, from the command pool of the thread that
+ * created it (see CommandPools). Worker threads each record their own
+ * SecondarySequences in parallel, without any locking, then one thread
+ * executes them all from a primary Sequence with a single submit:
+ *
+ *   // on each worker
+ *   auto part = engine.secondary_sequence();
+ *   part->cmd_begin();
+ *   part->record_dispatch(*algo, n);
+ *   part->cmd_end();
+ *
+ *   // on the submitting thread
+ *   seq->cmd_begin();
+ *   seq->record_execute(parts);
+ *   seq->cmd_end();
+ *   seq->launch_kernel_async();
+ *
+ * It must be recorded on the thread that created it. It can be released on
+ * any thread, once the primary executing it has finished, its command buffer
+ * is then reused by the creating thread.
+ */
+class SecondarySequence final : public VulkanResource<vk::CommandBuffer> {
+ public:
+  /**
+   * @brief Take a secondary command buffer from the calling thread's pool.
+   *
+   * @param device_ptr Pointer to the device
+   * @param pools Per-thread command pools of the engine
+   */
+  explicit SecondarySequence(std::shared_ptr<vk::Device> device_ptr,
+                             const std::shared_ptr<CommandPools> &pools);
+
+  ~SecondarySequence() override { destroy(); }
+
+  /**
+   * @brief Give the command buffer back to its pool.
+   */
+  void destroy() override;
+
+  /**
+   * @brief Begin recording, for one submission of a primary executing it.
+   * Compute only, so nothing is inherited (no render pass).
+   */
+  void cmd_begin() const;
+  void cmd_end() const;
+
+  /**
+   * @brief Bind the pipeline and push constants of an Algorithm, and dispatch
+   * it over 'n' elements.
+   */
+  void record_dispatch(const Algorithm &algo, uint32_t n) const;
+
+  /**
+   * @brief See Sequence::record_compute_barrier().
+   */
+  void record_compute_barrier() const;
+
+  /**
+   * @brief See Sequence::record_indirect_barrier().
+   */
+  void record_indirect_barrier() const;
+
+ private:
+  std::weak_ptr<CommandPools> pools_;
+  size_t pool_index_ = 0;
+};
+
 }  // namespace core
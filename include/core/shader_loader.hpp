@@ -4,10 +4,61 @@
 
 #include <filesystem>
 #include <fstream>
+#include <optional>
+#include <span>
+#include <string_view>
 #include <vector>
 
+// Generated by compile_shaders.py from shaders/compiled_shaders/*.spv. Without
+// it, shaders are only loaded from files.
+#if __has_include("embedded_shaders.hpp")
+#include "embedded_shaders.hpp"
+#define VKC_HAS_EMBEDDED_SHADERS 1
+#else
+#define VKC_HAS_EMBEDDED_SHADERS 0
+#endif
+
 namespace fs = std::filesystem;
 
+/**
+ * @brief A shader compiled into the binary.
+ */
+struct EmbeddedShaderInfo {
+  std::string_view name;  // e.g. "morton32.spv"
+  std::span<const uint32_t> code;
+  bool is_clspv;
+};
+
+/**
+ * @brief All shaders compiled into the binary, empty if the embedded header was
+ * not generated.
+ */
+[[nodiscard]] inline std::vector<EmbeddedShaderInfo> embedded_shaders() {
+  std::vector<EmbeddedShaderInfo> shaders;
+#if VKC_HAS_EMBEDDED_SHADERS
+  shaders.reserve(core::embedded::kShaders.size());
+  for (const auto &shader : core::embedded::kShaders) {
+    shaders.push_back({shader.name, shader.code, shader.is_clspv});
+  }
+#endif
+  return shaders;
+}
+
+/**
+ * @brief Look up a shader compiled into the binary by its .spv filename.
+ */
+[[nodiscard]] inline std::optional<std::span<const uint32_t>>
+find_embedded_shader([[maybe_unused]] const std::string_view filename) {
+#if VKC_HAS_EMBEDDED_SHADERS
+  for (const auto &shader : core::embedded::kShaders) {
+    if (shader.name == filename) {
+      return shader.code;
+    }
+  }
+#endif
+  return std::nullopt;
+}
+
 [[nodiscard]] inline std::vector<uint32_t> load_shader_from_file(
     const std::string &filename) {
   const fs::path shader_path = fs::current_path() / filename;
@@ -39,3 +90,17 @@ namespace fs = std::filesystem;
 
   return buffer;
 }
+
+/**
+ * @brief Get the SPIR-V of a shader, from the binary if it was embedded at
+ * build time, otherwise from the file in the working directory (e.g. shaders
+ * compiled separately by the user).
+ */
+[[nodiscard]] inline std::vector<uint32_t> load_shader(
+    const std::string &filename) {
+  if (const auto code = find_embedded_shader(filename)) {
+    spdlog::debug("using embedded shader: {}", filename);
+    return {code->begin(), code->end()};
+  }
+  return load_shader_from_file(filename);
+}
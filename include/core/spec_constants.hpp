@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace core {
+
+/**
+ * @brief Constant ID 0, 1, 2 are reserved for the workgroup size (CLSPV uses
+ * them for 'reqd_work_group_size', GLSL shaders should use
+ * 'layout(local_size_x_id = 0) in;'). User constants start from here.
+ */
+constexpr uint32_t kFirstUserSpecConstantId = 3;
+
+/**
+ * @brief Specialization constants are 32 bit scalars here (uint, int, float,
+ * bool). Bool is stored as VkBool32, as the spec requires.
+ */
+template <typename T>
+concept SpecConstantT =
+    std::is_same_v<T, bool> ||
+    (std::is_arithmetic_v<T> && sizeof(T) == sizeof(uint32_t));
+
+/**
+ * @brief A set of (constant ID -> value) pairs that specializes a shader at
+ * pipeline creation time. Each distinct set (together with the workgroup size)
+ * becomes its own pipeline variant in the Algorithm.
+ *
+ * e.g.
+ *   auto spec = SpecConstants().set(3, 256u).set(4, 4u);
+ */
+class SpecConstants {
+ public:
+  template <SpecConstantT T>
+  SpecConstants &set(const uint32_t constant_id, const T value) {
+    if (constant_id < kFirstUserSpecConstantId) {
+      throw std::invalid_argument("Constant ID 0-2 are for the workgroup size");
+    }
+
+    uint32_t raw;
+    if constexpr (std::is_same_v<T, bool>) {
+      raw = value ? VK_TRUE : VK_FALSE;
+    } else {
+      std::memcpy(&raw, &value, sizeof(uint32_t));
+    }
+
+    const auto it = std::ranges::lower_bound(ids_, constant_id);
+    const auto pos = std::distance(ids_.begin(), it);
+    if (it != ids_.end() && *it == constant_id) {
+      values_[pos] = raw;
+    } else {
+      ids_.insert(it, constant_id);
+      values_.insert(values_.begin() + pos, raw);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Set every constant of 'other' on top of these, e.g. tuned
+   * constants over the ones an Algorithm was created with.
+   */
+  SpecConstants &merge(const SpecConstants &other) {
+    for (size_t i = 0; i < other.ids_.size(); ++i) {
+      set(other.ids_[i], other.values_[i]);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief The raw 32 bit value of a constant, or 'fallback' (the shader's
+   * default) if it is not set.
+   */
+  [[nodiscard]] uint32_t get_or(const uint32_t constant_id,
+                                const uint32_t fallback) const {
+    const auto it = std::ranges::lower_bound(ids_, constant_id);
+    if (it == ids_.end() || *it != constant_id) {
+      return fallback;
+    }
+    return values_[std::distance(ids_.begin(), it)];
+  }
+
+  [[nodiscard]] bool empty() const { return ids_.empty(); }
+  [[nodiscard]] size_t size() const { return ids_.size(); }
+
+  [[nodiscard]] const std::vector<uint32_t> &ids() const { return ids_; }
+  [[nodiscard]] const std::vector<uint32_t> &values() const { return values_; }
+
+  /**
+   * @brief Prepend the workgroup size (constant ID 0, 1, 2) and build the
+   * Vulkan structures. 'entries' and 'data' must outlive the returned info.
+   */
+  [[nodiscard]] vk::SpecializationInfo make_spec_info(
+      const uint32_t threads_per_block,
+      std::vector<vk::SpecializationMapEntry> &entries,
+      std::vector<uint32_t> &data) const {
+    entries.clear();
+    data = {threads_per_block, 1u, 1u};
+    for (auto i = 0u; i < 3; ++i) {
+      entries.emplace_back(i, i * sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    for (size_t i = 0; i < ids_.size(); ++i) {
+      const auto offset =
+          static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+      entries.emplace_back(ids_[i], offset, sizeof(uint32_t));
+      data.push_back(values_[i]);
+    }
+
+    return vk::SpecializationInfo()
+        .setMapEntries(entries)
+        .setData<uint32_t>(data);
+  }
+
+  bool operator==(const SpecConstants &) const = default;
+  auto operator<=>(const SpecConstants &) const = default;
+
+ private:
+  // Sorted by constant ID, so equal sets compare equal.
+  std::vector<uint32_t> ids_;
+  std::vector<uint32_t> values_;
+};
+
+}  // namespace core
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine.hpp"
+
+namespace core {
+
+/**
+ * @brief StreamExecutor runs a 1-in/1-out kernel over a host range that can be
+ * much bigger than device memory. The range is cut into fixed-size chunks, and
+ * each chunk goes through one of a few "slots" (double/triple buffering). A
+ * slot owns its input/output Buffers, an Algorithm bound to them and a
+ * Sequence.
+ *
+ * While the GPU works on one slot, the host copies the next chunk into another
+ * slot and hands the finished chunk of a third one to the consumer, so
+ * transfer and compute overlap. Device memory stays at
+ * 'num_slots * chunk_size * (sizeof(In) + sizeof(Out))' whatever the input
+ * size is.
+ *
+ * e.g. morton encoding
+ *
+ *   StreamExecutor exec(engine, "morton32.spv", 256,
+ *                       sizeof(glm::vec4), sizeof(glm::uint), 1 << 20, 3,
+ *                       [&](uint32_t n) {
+ *                         return make_clspv_push_const(
+ *                             MortonPushConstants{n, min_coord, range});
+ *                       });
+ *   exec.run<glm::vec4, glm::uint>(points, [&](size_t offset, auto codes) {
+ *     ...
+ *   });
+ */
+class StreamExecutor {
+ public:
+  /**
+   * @brief Builds the push constants of a chunk of 'n' elements. It must
+   * always return the same size.
+   */
+  using PushConstantsFn = std::function<PushConstants(uint32_t n)>;
+
+  /**
+   * @brief Called once per finished chunk, in order. 'offset' is the index of
+   * the chunk's first element in the whole range. The data lives in the slot's
+   * mapped output buffer, and is only valid during the call.
+   */
+  using ConsumerFn =
+      std::function<void(size_t offset, std::span<const std::byte> output)>;
+
+  /**
+   * @brief Construct a new StreamExecutor, allocating all slots up front.
+   *
+   * @param engine The engine to allocate from.
+   * @param spirv_filename The CLSPV kernel, taking (input, output) buffers.
+   * @param threads_per_block Workgroup size of the kernel.
+   * @param in_element_size sizeof one input element.
+   * @param out_element_size sizeof one output element.
+   * @param chunk_size Number of elements per chunk.
+   * @param num_slots 2 for double buffering, 3 for triple buffering.
+   * @param make_push_constants Push constants of a chunk.
+   */
+  explicit StreamExecutor(ComputeEngine &engine,
+                          std::string_view spirv_filename,
+                          uint32_t threads_per_block,
+                          size_t in_element_size,
+                          size_t out_element_size,
+                          uint32_t chunk_size,
+                          uint32_t num_slots,
+                          PushConstantsFn make_push_constants);
+
+  /**
+   * @brief Process 'num_elements' input elements (raw bytes), calling
+   * 'consumer' for every finished chunk. Blocks until everything is done.
+   */
+  void run(const std::byte *input, size_t num_elements, ConsumerFn consumer);
+
+  /**
+   * @brief Typed version of the above.
+   */
+  template <typename InT, typename OutT>
+  void run(std::span<const InT> input,
+           const std::function<void(size_t, std::span<const OutT>)> &consumer) {
+    assert(sizeof(InT) == in_element_size_);
+    assert(sizeof(OutT) == out_element_size_);
+    run(reinterpret_cast<const std::byte *>(input.data()),
+        input.size(),
+        [&](const size_t offset, const std::span<const std::byte> output) {
+          consumer(offset,
+                   {reinterpret_cast<const OutT *>(output.data()),
+                    output.size() / sizeof(OutT)});
+        });
+  }
+
+  [[nodiscard]] uint32_t get_chunk_size() const { return chunk_size_; }
+  [[nodiscard]] uint32_t get_num_slots() const {
+    return static_cast<uint32_t>(slots_.size());
+  }
+
+ private:
+  struct Slot {
+    std::shared_ptr<Buffer> in_buf;
+    std::shared_ptr<Buffer> out_buf;
+    std::shared_ptr<Algorithm> algo;
+    std::shared_ptr<Sequence> seq;
+
+    // The chunk currently in flight
+    bool in_flight = false;
+    size_t offset = 0;
+    uint32_t count = 0;
+  };
+
+  /**
+   * @brief Wait for the slot's chunk and hand it to the consumer.
+   */
+  void retire(Slot &slot, const ConsumerFn &consumer) const;
+
+  size_t in_element_size_;
+  size_t out_element_size_;
+  uint32_t chunk_size_;
+  PushConstantsFn make_push_constants_;
+
+  std::vector<Slot> slots_;
+};
+
+}  // namespace core
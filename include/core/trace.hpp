@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * Host-side tracing, for finding stalls between allocation, recording, submit
+ * and wait. Build with VKC_ENABLE_TRACING=1 (xmake f --tracing=y) to turn it
+ * on. Otherwise the macros below compile to nothing, arguments included, so
+ * they cost nothing in the hot path.
+ *
+ *   void Sequence::sync() const {
+ *     VKC_TRACE_SCOPE("wait", "Sequence::sync");
+ *     ...
+ *   }
+ *
+ *   core::trace::write_chrome_trace("trace.json");  // open in ui.perfetto.dev
+ *
+ * Names and categories must be string literals (only the pointer is stored).
+ */
+#ifndef VKC_ENABLE_TRACING
+#define VKC_ENABLE_TRACING 0
+#endif
+
+#define VKC_TRACE_CONCAT_IMPL(a, b) a##b
+#define VKC_TRACE_CONCAT(a, b) VKC_TRACE_CONCAT_IMPL(a, b)
+
+#if VKC_ENABLE_TRACING
+// A span from here to the end of the enclosing scope.
+#define VKC_TRACE_SCOPE(category, name)                   \
+  const ::core::trace::Scope VKC_TRACE_CONCAT(vkc_trace_, \
+                                              __LINE__)(category, name, 0)
+// Same, with an integer shown as 'n' in the trace viewer (e.g. a size).
+#define VKC_TRACE_SCOPE_N(category, name, n)              \
+  const ::core::trace::Scope VKC_TRACE_CONCAT(vkc_trace_, \
+                                              __LINE__)(  \
+      category, name, static_cast<int64_t>(n))
+#else
+#define VKC_TRACE_SCOPE(category, name) static_cast<void>(0)
+#define VKC_TRACE_SCOPE_N(category, name, n) static_cast<void>(0)
+#endif
+
+namespace core::trace {
+
+/**
+ * @brief One complete span ("ph": "X" in the Chrome trace format).
+ */
+struct Event {
+  const char *category;
+  const char *name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  int64_t arg;
+};
+
+/**
+ * @brief Events kept per thread. Older events are overwritten once a thread
+ * records more than this between two exports.
+ */
+constexpr size_t kEventsPerThread = 1 << 14;
+
+/**
+ * @brief Nanoseconds on a steady clock (never 0).
+ */
+[[nodiscard]] uint64_t now_ns();
+
+/**
+ * @brief Append an event to the calling thread's ring buffer. Lock free, the
+ * only shared state touched is the buffer's own write index.
+ */
+void record(const Event &event);
+
+/**
+ * @brief Turn recording on/off at runtime (on by default). Only meaningful
+ * when built with VKC_ENABLE_TRACING.
+ */
+void set_enabled(bool enabled);
+[[nodiscard]] bool is_enabled();
+
+/**
+ * @brief Write the events of all threads as Chrome trace JSON (viewable in
+ * chrome://tracing or Perfetto). Threads may keep recording while this runs,
+ * events overwritten meanwhile may be dropped.
+ *
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void write_chrome_trace(const std::filesystem::path &path);
+
+/**
+ * @brief Drop all recorded events.
+ */
+void clear();
+
+/**
+ * @brief RAII span, see VKC_TRACE_SCOPE.
+ */
+class Scope {
+ public:
+  Scope(const char *category, const char *name, const int64_t arg)
+      : category_(category),
+        name_(name),
+        arg_(arg),
+        begin_ns_(is_enabled() ? now_ns() : 0) {}
+
+  ~Scope() {
+    if (begin_ns_ != 0) {
+      record({category_, name_, begin_ns_, now_ns(), arg_});
+    }
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+ private:
+  const char *category_;
+  const char *name_;
+  int64_t arg_;
+  uint64_t begin_ns_;  // 0 if tracing was off when the scope opened
+};
+
+}  // namespace core::trace
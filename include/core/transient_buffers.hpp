@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "buffer.hpp"
+#include "memory_tracker.hpp"
+
+namespace core {
+
+/**
+ * @brief A device-only buffer that is only needed from one stage of a
+ * multi-stage computation to another (both included). Stages are numbered in
+ * the order they are recorded.
+ */
+struct TransientBufferDesc {
+  vk::DeviceSize size = 0;
+  uint32_t first_stage = 0;
+  uint32_t last_stage = 0;
+  vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer;
+};
+
+/**
+ * @brief The intermediate buffers of a multi-stage computation, e.g.
+ *
+ *   TransientPlan plan;
+ *   const auto codes = plan.add(n * 4, 0, 2);         // morton .. tree build
+ *   const auto scratch = plan.add(n * 4, 1, 1);       // sort only
+ *   const auto nodes = plan.add(n * 16, 2, 3);        // tree build .. last
+ *   const auto transients = engine.transient_buffers(plan);
+ *   transients->get(codes);  // a Buffer, like engine.buffer()
+ *
+ * Buffers whose stages do not overlap share memory.
+ */
+class TransientPlan {
+ public:
+  /**
+   * @brief Declare a buffer used by stages [first_stage, last_stage].
+   *
+   * @return Its index, for TransientBuffers::get().
+   * @throws std::invalid_argument if 'size' is 0 or the stages are reversed.
+   */
+  size_t add(vk::DeviceSize size,
+             uint32_t first_stage,
+             uint32_t last_stage,
+             vk::BufferUsageFlags usage =
+                 vk::BufferUsageFlagBits::eStorageBuffer);
+
+  [[nodiscard]] const std::vector<TransientBufferDesc> &get_buffers() const {
+    return buffers_;
+  }
+
+ private:
+  std::vector<TransientBufferDesc> buffers_;
+};
+
+/**
+ * @brief Where a transient buffer goes in the shared memory block.
+ */
+struct TransientRange {
+  vk::DeviceSize size = 0;
+  vk::DeviceSize alignment = 1;
+  uint32_t first_stage = 0;
+  uint32_t last_stage = 0;
+
+  vk::DeviceSize offset = 0;  // output of pack_transient_ranges()
+};
+
+/**
+ * @brief Assign offsets so that ranges alive at the same stage never overlap,
+ * while the others reuse each other's memory. Greedy: the biggest ranges are
+ * placed first, each one at the lowest aligned offset that does not collide
+ * with a placed range of overlapping stages.
+ *
+ * @param ranges In: sizes, alignments and stages. Out: offsets.
+ * @return Size of the block holding all of them.
+ */
+vk::DeviceSize pack_transient_ranges(std::vector<TransientRange> &ranges);
+
+/**
+ * @brief The buffers of a TransientPlan, bound to one device-local memory
+ * block (a VMA allocation) that is only as big as the worst stage needs,
+ * instead of one allocation per buffer. Created by
+ * ComputeEngine::transient_buffers().
+ *
+ * Buffers sharing memory hold garbage when their first stage begins, whatever
+ * the previous user left. They are not mapped (get_data() is nullptr), copy
+ * results that the host needs into a regular buffer, or make it the output of
+ * the last stage.
+ *
+ * When a stage starts using memory that an earlier stage used for another
+ * buffer, that earlier stage must be finished first. A
+ * Sequence::record_compute_barrier() between the two stages, which dependent
+ * stages record anyway, is enough. For stages that do not otherwise depend on
+ * each other, use record_stage_barrier().
+ */
+class TransientBuffers {
+ public:
+  /**
+   * @brief Checks (and may reject) a block of the given size before it is
+   * allocated, e.g. against the engine's memory budget.
+   */
+  using ReserveFn = std::function<void(vk::DeviceSize size)>;
+
+  /**
+   * @brief Create the buffers of 'plan' and bind them to a new memory block.
+   *
+   * @param device_ptr Pointer to the device
+   * @param allocator The VMA allocator of the engine, the block comes from it.
+   * @param plan The buffers and their stages.
+   * @param memory_tracker The block is counted as BufferClass::kTransient.
+   * @param reserve Called with the block size before allocating it.
+   * @throws std::invalid_argument if the plan is empty.
+   * @throws std::runtime_error if the memory cannot be allocated.
+   */
+  explicit TransientBuffers(std::shared_ptr<vk::Device> device_ptr,
+                            VmaAllocator allocator,
+                            const TransientPlan &plan,
+                            std::shared_ptr<MemoryTracker> memory_tracker,
+                            const ReserveFn &reserve = nullptr);
+
+  ~TransientBuffers() { destroy(); }
+
+  TransientBuffers(const TransientBuffers &) = delete;
+  TransientBuffers &operator=(const TransientBuffers &) = delete;
+
+  /**
+   * @brief Destroy the buffers, then free the block.
+   */
+  void destroy();
+
+  /**
+   * @brief The buffer declared by TransientPlan::add() as 'index'.
+   */
+  [[nodiscard]] const std::shared_ptr<Buffer> &get(const size_t index) const {
+    return buffers_.at(index);
+  }
+
+  [[nodiscard]] size_t size() const { return buffers_.size(); }
+
+  /**
+   * @brief Offset of a buffer in the block.
+   */
+  [[nodiscard]] vk::DeviceSize get_offset(const size_t index) const {
+    return ranges_.at(index).offset;
+  }
+
+  /**
+   * @brief Bytes actually allocated, the size of the block.
+   */
+  [[nodiscard]] vk::DeviceSize get_block_size() const { return block_size_; }
+
+  /**
+   * @brief Bytes the buffers would take without sharing memory.
+   */
+  [[nodiscard]] vk::DeviceSize get_unaliased_size() const;
+
+  /**
+   * @brief Whether a buffer first used by 'stage' shares memory with one whose
+   * last stage is before 'stage'.
+   */
+  [[nodiscard]] bool reuses_memory(uint32_t stage) const;
+
+  /**
+   * @brief If reuses_memory(stage), record a compute -> compute barrier so the
+   * earlier stages are done with the memory. Record it right before the
+   * stage's first dispatch.
+   *
+   * @return Whether a barrier was recorded.
+   */
+  bool record_stage_barrier(const vk::CommandBuffer &cmd_buf,
+                            uint32_t stage) const;
+
+ private:
+  std::shared_ptr<vk::Device> device_ptr_;
+  std::vector<TransientRange> ranges_;
+  std::vector<std::shared_ptr<Buffer>> buffers_;
+  vk::DeviceSize block_size_ = 0;
+
+  // Frees the memory when the last user (this or one of the buffers) is gone
+  std::shared_ptr<const void> block_;
+};
+
+}  // namespace core
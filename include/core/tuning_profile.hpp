@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "spec_constants.hpp"
+
+namespace core {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The winning configuration of a kernel for one problem size bucket.
+ */
+struct TuningEntry {
+  uint32_t threads_per_block = 0;
+  SpecConstants spec_constants;
+  double time_ms = 0.0;  // average time of one dispatch when it was tuned
+};
+
+/**
+ * @brief One configuration to try when autotuning a kernel.
+ */
+struct TuningCandidate {
+  uint32_t threads_per_block = 0;
+  SpecConstants spec_constants;
+};
+
+/**
+ * @brief Stores the autotuning results of a device, i.e., the best workgroup
+ * size (and specialization constants) per kernel and per problem size bucket.
+ * Buckets are powers of two, so 1M and 1.5M elements share the same entry.
+ *
+ * It is saved as a small text file, one per device. The file is tied to the
+ * vendor/device ID and the driver version, and a profile made by another
+ * driver is ignored when loading.
+ */
+class TuningProfile {
+ public:
+  TuningProfile() = default;
+
+  explicit TuningProfile(std::string device_key)
+      : device_key_(std::move(device_key)) {}
+
+  /**
+   * @brief e.g. "10de_2684_2300a000" (vendor ID, device ID, driver version).
+   */
+  [[nodiscard]] static std::string make_device_key(uint32_t vendor_id,
+                                                   uint32_t device_id,
+                                                   uint32_t driver_version);
+
+  /**
+   * @brief Where the profile of a device lives. The directory can be set with
+   * the environment variable VKC_TUNING_DIR, by default it is the current
+   * working directory.
+   */
+  [[nodiscard]] static fs::path default_path(std::string_view device_key);
+
+  /**
+   * @brief floor(log2(n)), the problem size bucket of n elements.
+   */
+  [[nodiscard]] static uint32_t size_bucket(uint32_t n);
+
+  /**
+   * @brief Power of two workgroup sizes from 32 up to 'max_threads'.
+   */
+  [[nodiscard]] static std::vector<TuningCandidate> workgroup_candidates(
+      uint32_t max_threads);
+
+  /**
+   * @brief Look up the best configuration of a kernel for n elements. If the
+   * exact bucket was never tuned, the closest tuned bucket is used.
+   *
+   * @param kernel The kernel name (spirv filename).
+   * @param n The problem size.
+   * @return The entry, or std::nullopt if the kernel was never tuned.
+   */
+  [[nodiscard]] std::optional<TuningEntry> find(std::string_view kernel,
+                                                uint32_t n) const;
+
+  /**
+   * @brief All tuned configurations of a kernel, one per size bucket.
+   */
+  [[nodiscard]] std::vector<TuningEntry> entries_of(
+      std::string_view kernel) const;
+
+  /**
+   * @brief Record a tuning result, replacing the old entry of that bucket.
+   */
+  void update(std::string_view kernel, uint32_t n, const TuningEntry &entry);
+
+  /**
+   * @brief Load entries from file. Returns false if the file does not exist,
+   * is malformed, or belongs to another device/driver.
+   */
+  bool load(const fs::path &path);
+
+  /**
+   * @brief Write all entries to file.
+   *
+   * @throws std::runtime_error if the file cannot be written.
+   */
+  void save(const fs::path &path) const;
+
+  [[nodiscard]] const std::string &get_device_key() const {
+    return device_key_;
+  }
+  [[nodiscard]] size_t size() const { return entries_.size(); }
+  [[nodiscard]] bool empty() const { return entries_.empty(); }
+
+ private:
+  std::string device_key_;
+
+  // (kernel, size bucket) -> best configuration
+  std::map<std::pair<std::string, uint32_t>, TuningEntry, std::less<>>
+      entries_;
+};
+
+}  // namespace core
@@ -1,13 +1,4 @@
 #pragma once
 
-#include "vk_mem_alloc.h"
-
-namespace core {
-
-/**
- * @brief Global VMA allocator. Only 1 instance of VmaAllocator will be created
- * for this project.
- */
-extern VmaAllocator g_allocator;
-
-}  // namespace core
\ No newline at end of file
+// The VMA allocator is owned by each engine, see BaseEngine::get_allocator().
+#include "vk_mem_alloc.h"
\ No newline at end of file
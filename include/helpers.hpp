@@ -1,25 +1,63 @@
 #pragma once
 
+#include <array>
+#include <cstring>
 #include <type_traits>
-#include <vector>
+
+#include "core/push_constants.hpp"
 
 template <typename T>
 concept NumericT = std::is_arithmetic_v<std::remove_cvref_t<T>>;
 
 /**
- * @brief Make a vector of floats that can be used as push constants. The
- * first 3 floats are 'region_offset'. In CLSPV, the first 20 bytes of push
- * constants is reserved. You can assume zeros for now. This function takes the
- * actual push constants.
+ * @brief A push constant argument must be exactly 4 bytes wide (uint32_t,
+ * int32_t, float), so that it lines up with the kernel's argument.
+ */
+template <typename T>
+concept PushArgT = NumericT<T> && sizeof(std::remove_cvref_t<T>) == 4;
+
+/**
+ * @brief Make the push constants for a CLSPV kernel from a user struct. The
+ * struct must match the POD arguments of the kernel, in order. The first 16
+ * bytes (global offset) is prepended automatically.
+ *
+ * e.g. for `kernel void foo(global float4 *in, global uint *out, uint n,
+ * float min_coord, float range)`:
  *
- * Check  https://github.com/google/clspv/blob/main/docs/OpenCLCOnVulkan.md
- * for more details.
- * @tparam Args The types of the push constants.
+ *   struct MortonPushConstants {
+ *     uint32_t n;
+ *     float min_coord;
+ *     float range;
+ *   };
+ *
+ * @tparam T The struct of push constants.
  * @param args The push constants.
  */
-template <NumericT... Args>
-[[nodiscard]] constexpr std::vector<float> make_clspv_push_const(
-    Args &&...args) {
-  return std::vector{
-      0.0f, 0.0f, 0.0f, 0.0f, static_cast<float>(std::forward<Args>(args))...};
+template <core::PushConstantT T>
+[[nodiscard]] core::PushConstants make_clspv_push_const(const T &args)
+  requires std::is_class_v<T>
+{
+  return core::PushConstants(core::ClspvPushConstants<T>{.args = args});
+}
+
+/**
+ * @brief Shorthand of the above when the kernel takes a few scalars. Each
+ * argument keeps its own type (no float encoding), so pass uint32_t for
+ * element counts.
+ *
+ * @tparam Args The types of the push constants (each 4 bytes).
+ * @param args The push constants.
+ */
+template <PushArgT... Args>
+[[nodiscard]] core::PushConstants make_clspv_push_const(Args &&...args)
+  requires(sizeof...(Args) > 0)
+{
+  struct Packed {
+    std::array<std::byte, 4 * sizeof...(Args)> bytes;
+  } packed{};
+
+  auto *dst = packed.bytes.data();
+  ((std::memcpy(dst, &args, 4), dst += 4), ...);
+
+  return make_clspv_push_const(packed);
 }
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "core/engine_config.hpp"
+#include "morton.hpp"
+
+// CPU reference of the Hilbert keys of shaders/hilbert.h. Same interface as
+// the morton namespace, so either can produce the keys of a radix tree.
+namespace hilbert {
+
+/**
+ * @brief Skilling's transform of the cell coordinates ('bits' per axis) into
+ * the transposed Hilbert index, as hilbert_transpose() in hilbert.h.
+ */
+inline glm::uvec3 transpose(glm::uvec3 v, const uint32_t bits) {
+  const uint32_t m = 1u << (bits - 1u);
+
+  // Inverse undo
+  for (uint32_t q = m; q > 1u; q >>= 1) {
+    const uint32_t p = q - 1u;
+    if (v.x & q) {
+      v.x ^= p;
+    }
+    for (const auto axis : {&v.y, &v.z}) {
+      if (*axis & q) {
+        v.x ^= p;
+      } else {
+        const uint32_t t = (v.x ^ *axis) & p;
+        v.x ^= t;
+        *axis ^= t;
+      }
+    }
+  }
+
+  // Gray encode
+  v.y ^= v.x;
+  v.z ^= v.y;
+  uint32_t t = 0u;
+  for (uint32_t q = m; q > 1u; q >>= 1) {
+    if (v.z & q) {
+      t ^= q - 1u;
+    }
+  }
+  return v ^ glm::uvec3(t);
+}
+
+/**
+ * @brief 30 bit key (10 bits per axis) of the cell (i, j, k).
+ */
+inline glm::uint encode(const glm::uint i,
+                        const glm::uint j,
+                        const glm::uint k) {
+  const auto t = transpose(glm::uvec3(i, j, k) & 0x3FFu, 10);
+  return morton::encode(t.z, t.y, t.x);
+}
+
+inline uint64_t expand_bit64(const uint32_t a) {
+  uint64_t x = a & 0x1FFFFFu;
+  x = (x | (x << 32)) & 0x1F00000000FFFFull;
+  x = (x | (x << 16)) & 0x1F0000FF0000FFull;
+  x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+  x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+  x = (x | (x << 2)) & 0x1249249249249249ull;
+  return x;
+}
+
+/**
+ * @brief 63 bit key (21 bits per axis) of the cell (i, j, k).
+ */
+inline uint64_t encode64(const uint32_t i, const uint32_t j, const uint32_t k) {
+  const auto t = transpose(glm::uvec3(i, j, k) & 0x1FFFFFu, 21);
+  return expand_bit64(t.z) | expand_bit64(t.y) << 1 | expand_bit64(t.x) << 2;
+}
+
+/**
+ * @brief Key of a point inside the cube [min_coord, min_coord + range),
+ * quantized like morton::point_code(). See hilbert32_point().
+ */
+inline glm::uint point_code(const float x,
+                            const float y,
+                            const float z,
+                            const float min_coord,
+                            const float range) {
+  constexpr float bit_scale_f = 1023.0f;
+
+  const glm::uint i = (bit_scale_f * ((x - min_coord) / range));
+  const glm::uint j = (bit_scale_f * ((y - min_coord) / range));
+  const glm::uint k = (bit_scale_f * ((z - min_coord) / range));
+
+  return encode(i, j, k);
+}
+
+/**
+ * @brief 64 bit version, see hilbert64_point().
+ */
+inline uint64_t point_code64(const float x,
+                             const float y,
+                             const float z,
+                             const float min_coord,
+                             const float range) {
+  constexpr float bit_scale_f = 2097151.0f;  // 2^21 - 1
+
+  const uint32_t i = (bit_scale_f * ((x - min_coord) / range));
+  const uint32_t j = (bit_scale_f * ((y - min_coord) / range));
+  const uint32_t k = (bit_scale_f * ((z - min_coord) / range));
+
+  return encode64(i, j, k);
+}
+
+/**
+ * @brief CPU reference of hilbert32.cl.
+ */
+inline void foo(const glm::vec4 *in_xyz,
+                glm::uint *out,
+                const size_t n,
+                const float min_coord,
+                const float range) {
+  for (size_t index = 0; index < n; ++index) {
+    const auto &p = in_xyz[index];
+    out[index] = point_code(p.x, p.y, p.z, min_coord, range);
+  }
+}
+
+/**
+ * @brief CPU reference of hilbert64.cl.
+ */
+inline void foo64(const glm::vec4 *in_xyz,
+                  uint64_t *out,
+                  const size_t n,
+                  const float min_coord,
+                  const float range) {
+  for (size_t index = 0; index < n; ++index) {
+    const auto &p = in_xyz[index];
+    out[index] = point_code64(p.x, p.y, p.z, min_coord, range);
+  }
+}
+
+}  // namespace hilbert
+
+// -----------------------------------------------------------------------------
+//          Choosing the curve
+// -----------------------------------------------------------------------------
+
+namespace sfc {
+
+/**
+ * @brief The space-filling curve that orders the points. Hilbert keys cost a
+ * little more to encode, but keep neighbouring points closer in the sorted
+ * order, so tree traversals touch fewer cache lines.
+ */
+enum class Curve : uint8_t {
+  kMorton,
+  kHilbert,
+};
+
+[[nodiscard]] constexpr const char *to_string(const Curve curve) {
+  return curve == Curve::kHilbert ? "hilbert" : "morton";
+}
+
+/**
+ * @brief "morton" or "hilbert".
+ *
+ * @throws std::invalid_argument for anything else.
+ */
+[[nodiscard]] inline Curve parse_curve(const std::string_view name) {
+  if (name == "morton") {
+    return Curve::kMorton;
+  }
+  if (name == "hilbert") {
+    return Curve::kHilbert;
+  }
+  throw std::invalid_argument("Unknown curve: " + std::string(name));
+}
+
+/**
+ * @brief The 30 bit key kernel of a curve. They all take a float4 input, a
+ * uint output and the MortonPushConstants arguments {n, min_coord, range}.
+ */
+[[nodiscard]] constexpr const char *kernel_name(const Curve curve) {
+  return curve == Curve::kHilbert ? "hilbert32.spv" : "morton32.spv";
+}
+
+/**
+ * @brief The 63 bit key kernel of a curve, with a ulong output and otherwise
+ * the arguments of kernel_name(). CPU reference: hilbert::foo64().
+ *
+ * @param features The engine's enabled features, the kernel needs
+ * shader_int64.
+ * @throws std::invalid_argument for the morton curve, which has none.
+ * @throws std::runtime_error if shader_int64 is not enabled.
+ */
+[[nodiscard]] inline const char *kernel_name64(
+    const Curve curve, const core::DeviceFeatures &features) {
+  if (curve != Curve::kHilbert) {
+    throw std::invalid_argument("No 64 bit kernel for the " +
+                                std::string(to_string(curve)) + " curve");
+  }
+  if (!features.shader_int64) {
+    throw std::runtime_error(
+        "The 64 bit kernels need shaderInt64, which is not enabled");
+  }
+  return "hilbert64.spv";
+}
+
+/**
+ * @brief CPU reference of kernel_name(curve).
+ */
+inline void encode_points(const Curve curve,
+                          const glm::vec4 *in_xyz,
+                          glm::uint *out,
+                          const size_t n,
+                          const float min_coord,
+                          const float range) {
+  if (curve == Curve::kHilbert) {
+    hilbert::foo(in_xyz, out, n, min_coord, range);
+  } else {
+    morton::foo(in_xyz, out, n, min_coord, range);
+  }
+}
+
+}  // namespace sfc
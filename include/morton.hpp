@@ -1,6 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <limits>
+#include <vector>
 
 namespace morton {
 
@@ -19,23 +28,308 @@ inline glm::uint encode(const glm::uint i,
   return expand_bit(i) | expand_bit(j) << 1 | expand_bit(k) << 2;
 }
 
+/**
+ * @brief 30 bit code of a point inside the cube [min_coord, min_coord + range),
+ * as computed by morton32_xyz() in morton32.h.
+ */
+inline glm::uint point_code(const float x,
+                            const float y,
+                            const float z,
+                            const float min_coord,
+                            const float range) {
+  constexpr glm::uint code_len = 31;
+  constexpr glm::uint bit_scale =
+      0xFFFFFFFFu >> (32 - (code_len / 3));   // 1023
+  constexpr float bit_scale_f = (bit_scale);  // 1023
+
+  const glm::uint i = (bit_scale_f * ((x - min_coord) / range));
+  const glm::uint j = (bit_scale_f * ((y - min_coord) / range));
+  const glm::uint k = (bit_scale_f * ((z - min_coord) / range));
+
+  return encode(i, j, k);
+}
+
 inline void foo(const glm::vec4 *in_xyz,
                 glm::uint *out,
-                const float n,
+                const size_t n,
                 const float min_coord,
                 const float range) {
-  for (int index = 0; index < n; ++index) {
-    constexpr glm::uint code_len = 31;
-    const float x = in_xyz[index].x;
-    const float y = in_xyz[index].y;
-    const float z = in_xyz[index].z;
-    constexpr glm::uint bit_scale =
-        0xFFFFFFFFu >> (32 - (code_len / 3));   // 1023
-    constexpr float bit_scale_f = (bit_scale);  // 1023
-
-    const glm::uint i = (bit_scale_f * ((x - min_coord) / range));
-    const glm::uint j = (bit_scale_f * ((y - min_coord) / range));
-    const glm::uint k = (bit_scale_f * ((z - min_coord) / range));
+  for (size_t index = 0; index < n; ++index) {
+    const auto &p = in_xyz[index];
+    out[index] = point_code(p.x, p.y, p.z, min_coord, range);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//          Compact input layouts (morton32_{xyz,soa,half,quantized}.cl)
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Packed xyz floats, 12 bytes per point (morton32_xyz.cl).
+ */
+inline std::vector<float> to_xyz(const glm::vec4 *in_xyz, const size_t n) {
+  std::vector<float> xyz(3 * n);
+  for (size_t index = 0; index < n; ++index) {
+    xyz[3 * index] = in_xyz[index].x;
+    xyz[3 * index + 1] = in_xyz[index].y;
+    xyz[3 * index + 2] = in_xyz[index].z;
+  }
+  return xyz;
+}
+
+/**
+ * @brief Separate x, y and z arrays (morton32_soa.cl).
+ */
+struct SoaPoints {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+};
+
+inline SoaPoints to_soa(const glm::vec4 *in_xyz, const size_t n) {
+  SoaPoints soa;
+  soa.x.resize(n);
+  soa.y.resize(n);
+  soa.z.resize(n);
+  for (size_t index = 0; index < n; ++index) {
+    soa.x[index] = in_xyz[index].x;
+    soa.y[index] = in_xyz[index].y;
+    soa.z[index] = in_xyz[index].z;
+  }
+  return soa;
+}
+
+/**
+ * @brief IEEE half (round to nearest even) of a float.
+ */
+inline uint16_t float_to_half(const float f) {
+  const auto u = std::bit_cast<uint32_t>(f);
+  const auto sign = static_cast<uint16_t>((u >> 16) & 0x8000u);
+  const uint32_t abs = u & 0x7FFFFFFFu;
+
+  if (abs >= 0x7F800000u) {  // inf, nan
+    return sign | 0x7C00u | (abs > 0x7F800000u ? 0x200u : 0u);
+  }
+  if (abs >= 0x477FF000u) {  // rounds to more than 65504
+    return sign | 0x7C00u;
+  }
+  if (abs < 0x38800000u) {  // below 2^-14, subnormal (exact scaling by 2^24)
+    const auto f_abs = std::bit_cast<float>(abs);
+    return sign | static_cast<uint16_t>(std::nearbyint(f_abs * 16777216.0f));
+  }
+  // Rebias the exponent, round the mantissa to nearest even
+  const uint32_t rounded = abs + 0xFFFu + ((abs >> 13) & 1u);
+  return sign | static_cast<uint16_t>((rounded - 0x38000000u) >> 13);
+}
+
+/**
+ * @brief Float of an IEEE half, as half_to_float() in morton32.h.
+ */
+inline float half_to_float(const uint16_t h) {
+  const uint32_t sign = (h & 0x8000u) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1Fu;
+  const uint32_t mantissa = h & 0x3FFu;
+
+  if (exponent == 0u) {
+    const float f = static_cast<float>(mantissa) * 5.9604645e-8f;
+    return sign != 0u ? -f : f;
+  }
+  if (exponent == 31u) {
+    return std::bit_cast<float>(sign | 0x7F800000u | (mantissa << 13));
+  }
+  return std::bit_cast<float>(sign | ((exponent + 112u) << 23) |
+                              (mantissa << 13));
+}
+
+/**
+ * @brief Packed xyz halves, 6 bytes per point (morton32_half.cl). Halves have
+ * 11 significant bits, so only coordinates well within the range of a half
+ * (e.g. already normalized) keep all 10 bits of the code. Padded to a multiple
+ * of 4 bytes, the kernel reads 32 bit words.
+ */
+inline std::vector<uint16_t> to_half(const glm::vec4 *in_xyz, const size_t n) {
+  std::vector<uint16_t> xyz((3 * n + 1) / 2 * 2, 0);
+  for (size_t index = 0; index < n; ++index) {
+    xyz[3 * index] = float_to_half(in_xyz[index].x);
+    xyz[3 * index + 1] = float_to_half(in_xyz[index].y);
+    xyz[3 * index + 2] = float_to_half(in_xyz[index].z);
+  }
+  return xyz;
+}
+
+/**
+ * @brief Quantize coordinates inside the cube [min_coord, min_coord + range)
+ * to 16 bits per axis, 6 bytes per point (morton32_quantized.cl). Padded to a
+ * multiple of 4 bytes like to_half().
+ */
+inline std::vector<uint16_t> quantize(const glm::vec4 *in_xyz,
+                                      const size_t n,
+                                      const float min_coord,
+                                      const float range) {
+  // 1023 << 6, so that the top 10 bits land in the same cells as the float
+  // kernels (1023 * t)
+  constexpr float scale = 65472.0f;
+  const auto q = [&](const float v) {
+    const float t = std::clamp((v - min_coord) / range, 0.0f, 1.0f);
+    return static_cast<uint16_t>(scale * t);
+  };
+
+  std::vector<uint16_t> xyz((3 * n + 1) / 2 * 2, 0);
+  for (size_t index = 0; index < n; ++index) {
+    xyz[3 * index] = q(in_xyz[index].x);
+    xyz[3 * index + 1] = q(in_xyz[index].y);
+    xyz[3 * index + 2] = q(in_xyz[index].z);
+  }
+  return xyz;
+}
+
+/**
+ * @brief CPU reference of morton32_xyz.cl.
+ */
+inline void foo_xyz(const float *in_xyz,
+                    glm::uint *out,
+                    const size_t n,
+                    const float min_coord,
+                    const float range) {
+  for (size_t index = 0; index < n; ++index) {
+    const auto *p = in_xyz + 3 * index;
+    out[index] = point_code(p[0], p[1], p[2], min_coord, range);
+  }
+}
+
+/**
+ * @brief CPU reference of morton32_soa.cl.
+ */
+inline void foo_soa(const SoaPoints &in,
+                    glm::uint *out,
+                    const size_t n,
+                    const float min_coord,
+                    const float range) {
+  for (size_t index = 0; index < n; ++index) {
+    out[index] =
+        point_code(in.x[index], in.y[index], in.z[index], min_coord, range);
+  }
+}
+
+/**
+ * @brief CPU reference of morton32_half.cl.
+ */
+inline void foo_half(const uint16_t *in_xyz,
+                     glm::uint *out,
+                     const size_t n,
+                     const float min_coord,
+                     const float range) {
+  for (size_t index = 0; index < n; ++index) {
+    const auto *p = in_xyz + 3 * index;
+    out[index] = point_code(half_to_float(p[0]),
+                            half_to_float(p[1]),
+                            half_to_float(p[2]),
+                            min_coord,
+                            range);
+  }
+}
+
+/**
+ * @brief CPU reference of morton32_quantized.cl, the top 10 bits per axis.
+ */
+inline void foo_quantized(const uint16_t *in_q,
+                          glm::uint *out,
+                          const size_t n) {
+  for (size_t index = 0; index < n; ++index) {
+    const auto *q = in_q + 3 * index;
+    out[index] = encode(q[0] >> 6, q[1] >> 6, q[2] >> 6);
+  }
+}
+
+/**
+ * @brief CPU reference of morton32_batched.cl: point sets packed back to back,
+ * set 'p' being [offsets[p], offsets[p + 1]) in the cube
+ * (cubes[2p], cubes[2p + 1]) = (min_coord, range).
+ */
+inline void foo_batched(const glm::vec4 *in_xyz,
+                        glm::uint *out,
+                        const glm::uint *offsets,
+                        const float *cubes,
+                        const size_t num_segments) {
+  for (size_t p = 0; p < num_segments; ++p) {
+    const auto first = offsets[p];
+    foo(in_xyz + first,
+        out + first,
+        offsets[p + 1] - first,
+        cubes[2 * p],
+        cubes[2 * p + 1]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//          Bounds computed on the device (bounding_box.cl, bounds.h)
+// -----------------------------------------------------------------------------
+
+struct Bounds {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+/**
+ * @brief Maps floats to uints of the same order, how the bounds buffer stores
+ * them.
+ */
+inline glm::uint float_to_ordered(const float f) {
+  const auto u = std::bit_cast<glm::uint>(f);
+  return (u & 0x80000000u) != 0u ? ~u : (u | 0x80000000u);
+}
+
+inline float ordered_to_float(const glm::uint u) {
+  return std::bit_cast<float>((u & 0x80000000u) != 0u ? (u & 0x7FFFFFFFu)
+                                                       : ~u);
+}
+
+/**
+ * @brief Contents of a bounds buffer before a reduction (empty box).
+ */
+inline constexpr std::array<glm::uint, 8> kEmptyBoundsBuffer = {
+    0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0u, 0u, 0u, 0u};
+
+inline Bounds decode_bounds(const glm::uint *g_bounds) {
+  return {{ordered_to_float(g_bounds[0]),
+           ordered_to_float(g_bounds[1]),
+           ordered_to_float(g_bounds[2])},
+          {ordered_to_float(g_bounds[4]),
+           ordered_to_float(g_bounds[5]),
+           ordered_to_float(g_bounds[6])}};
+}
+
+/**
+ * @brief CPU reference of bounding_box.cl.
+ */
+inline Bounds compute_bounds(const glm::vec4 *in_xyz, const size_t n) {
+  constexpr auto inf = std::numeric_limits<float>::infinity();
+  Bounds bounds{glm::vec3(inf), glm::vec3(-inf)};
+  for (size_t index = 0; index < n; ++index) {
+    bounds.min = glm::min(bounds.min, glm::vec3(in_xyz[index]));
+    bounds.max = glm::max(bounds.max, glm::vec3(in_xyz[index]));
+  }
+  return bounds;
+}
+
+/**
+ * @brief CPU reference of morton32_bounds.cl, each axis scaled to its own
+ * extent.
+ */
+inline void foo_bounds(const glm::vec4 *in_xyz,
+                       glm::uint *out,
+                       const size_t n,
+                       const Bounds &bounds) {
+  constexpr float bit_scale_f = 1023.0f;
+  const float ex = std::max(bounds.max.x - bounds.min.x, FLT_MIN);
+  const float ey = std::max(bounds.max.y - bounds.min.y, FLT_MIN);
+  const float ez = std::max(bounds.max.z - bounds.min.z, FLT_MIN);
+
+  for (size_t index = 0; index < n; ++index) {
+    const auto &p = in_xyz[index];
+    const glm::uint i = (bit_scale_f * ((p.x - bounds.min.x) / ex));
+    const glm::uint j = (bit_scale_f * ((p.y - bounds.min.y) / ey));
+    const glm::uint k = (bit_scale_f * ((p.z - bounds.min.z) / ez));
 
     out[index] = encode(i, j, k);
   }
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "core/thread_pool.hpp"
+
+namespace morton {
+
+// -----------------------------------------------------------------------------
+//                    CPU LSD radix sort (host path of the sort)
+// -----------------------------------------------------------------------------
+
+namespace detail {
+
+inline constexpr uint32_t kRadixBits = 8;
+inline constexpr uint32_t kRadixBins = 1u << kRadixBits;
+
+// Fewer keys per thread than this are not worth a thread
+inline constexpr size_t kMinKeysPerThread = size_t{1} << 16;
+
+inline constexpr size_t kCacheLine = 64;
+
+template <typename Key>
+uint32_t digit(const Key key, const uint32_t pass) {
+  return static_cast<uint32_t>(key >> (pass * kRadixBits)) & (kRadixBins - 1);
+}
+
+/**
+ * @brief Write-combining staging for the scatter of one thread. Elements are
+ * collected per bin into cache line sized chunks and written out a full line
+ * at a time, instead of one element at a time into 256 output streams.
+ */
+template <typename Key>
+class ScatterBuffer {
+ public:
+  static constexpr uint32_t kPerBin = kCacheLine / sizeof(Key);
+
+  void scatter(const Key *src_keys,
+               const uint32_t *src_payload,
+               const size_t first,
+               const size_t last,
+               const uint32_t pass,
+               std::array<size_t, kRadixBins> &offsets,
+               Key *dst_keys,
+               uint32_t *dst_payload) {
+    fill_.fill(0);
+    for (auto i = first; i < last; ++i) {
+      const auto bin = digit(src_keys[i], pass);
+      const auto slot = bin * kPerBin + fill_[bin];
+      keys_[slot] = src_keys[i];
+      if (src_payload != nullptr) {
+        payload_[slot] = src_payload[i];
+      }
+      if (++fill_[bin] == kPerBin) {
+        flush(bin, offsets, dst_keys, dst_payload);
+      }
+    }
+    for (uint32_t bin = 0; bin < kRadixBins; ++bin) {
+      flush(bin, offsets, dst_keys, dst_payload);
+    }
+  }
+
+ private:
+  void flush(const uint32_t bin,
+             std::array<size_t, kRadixBins> &offsets,
+             Key *dst_keys,
+             uint32_t *dst_payload) {
+    const auto count = fill_[bin];
+    if (count == 0) {
+      return;
+    }
+    std::memcpy(dst_keys + offsets[bin],
+                &keys_[bin * kPerBin],
+                count * sizeof(Key));
+    if (dst_payload != nullptr) {
+      std::memcpy(dst_payload + offsets[bin],
+                  &payload_[bin * kPerBin],
+                  count * sizeof(uint32_t));
+    }
+    offsets[bin] += count;
+    fill_[bin] = 0;
+  }
+
+  alignas(kCacheLine) std::array<Key, kRadixBins * kPerBin> keys_;
+  alignas(kCacheLine) std::array<uint32_t, kRadixBins * kPerBin> payload_;
+  std::array<uint32_t, kRadixBins> fill_;
+};
+
+template <typename Key>
+void radix_sort(const std::span<Key> keys,
+                const std::span<uint32_t> payload,
+                core::ThreadPool *pool) {
+  constexpr uint32_t num_passes = sizeof(Key) * 8 / kRadixBits;
+  using Histogram = std::array<size_t, kRadixBins>;
+
+  if (!payload.empty() && payload.size() != keys.size()) {
+    throw std::invalid_argument("radix_sort: payload and keys sizes differ");
+  }
+  const auto n = keys.size();
+  if (n < 2) {
+    return;
+  }
+  const bool has_payload = !payload.empty();
+
+  // Contiguous blocks, one per thread
+  const size_t num_blocks =
+      pool == nullptr
+          ? 1
+          : std::clamp<size_t>(n / kMinKeysPerThread, 1, pool->size());
+  const auto block_first = [&](const size_t b) { return n * b / num_blocks; };
+  const auto for_each_block = [&](auto &&fn) {
+    if (num_blocks == 1) {
+      fn(size_t{0});
+      return;
+    }
+    std::vector<std::future<void>> results;
+    results.reserve(num_blocks);
+    for (size_t b = 0; b < num_blocks; ++b) {
+      results.push_back(pool->submit([&fn, b] { fn(b); }));
+    }
+    for (auto &result : results) {
+      result.get();
+    }
+  };
+
+  // One read for the histograms of all digits. The totals per digit do not
+  // change from pass to pass, so they tell up front which passes to skip.
+  std::vector<std::array<Histogram, num_passes>> counts(num_blocks);
+  for_each_block([&](const size_t b) {
+    auto &c = counts[b];
+    for (auto &h : c) {
+      h.fill(0);
+    }
+    for (auto i = block_first(b); i < block_first(b + 1); ++i) {
+      for (uint32_t pass = 0; pass < num_passes; ++pass) {
+        ++c[pass][digit(keys[i], pass)];
+      }
+    }
+  });
+
+  std::vector<uint32_t> passes;
+  for (uint32_t pass = 0; pass < num_passes; ++pass) {
+    // All keys sharing this digit, the pass would not move anything
+    bool skip = false;
+    for (uint32_t bin = 0; bin < kRadixBins && !skip; ++bin) {
+      size_t total = 0;
+      for (const auto &c : counts) {
+        total += c[pass][bin];
+      }
+      skip = total == n;
+    }
+    if (!skip) {
+      passes.push_back(pass);
+    }
+  }
+  if (passes.empty()) {
+    return;
+  }
+
+  std::vector<Key> tmp_keys(n);
+  std::vector<uint32_t> tmp_payload(has_payload ? n : 0);
+  auto *src_keys = keys.data();
+  auto *src_payload = has_payload ? payload.data() : nullptr;
+  auto *dst_keys = tmp_keys.data();
+  auto *dst_payload = has_payload ? tmp_payload.data() : nullptr;
+
+  std::vector<std::unique_ptr<ScatterBuffer<Key>>> buffers(num_blocks);
+  for (auto &buffer : buffers) {
+    buffer = std::make_unique<ScatterBuffer<Key>>();
+  }
+  std::vector<Histogram> offsets(num_blocks);
+
+  for (size_t p = 0; p < passes.size(); ++p) {
+    const auto pass = passes[p];
+
+    // The first pass reads the input order, which the histograms were counted
+    // in. After that the blocks hold other keys, count again.
+    if (p > 0) {
+      for_each_block([&](const size_t b) {
+        auto &h = counts[b][pass];
+        h.fill(0);
+        for (auto i = block_first(b); i < block_first(b + 1); ++i) {
+          ++h[digit(src_keys[i], pass)];
+        }
+      });
+    }
+
+    // Bin major, block minor, so that equal digits keep their order (stable)
+    size_t offset = 0;
+    for (uint32_t bin = 0; bin < kRadixBins; ++bin) {
+      for (size_t b = 0; b < num_blocks; ++b) {
+        offsets[b][bin] = offset;
+        offset += counts[b][pass][bin];
+      }
+    }
+
+    for_each_block([&](const size_t b) {
+      buffers[b]->scatter(src_keys,
+                          src_payload,
+                          block_first(b),
+                          block_first(b + 1),
+                          pass,
+                          offsets[b],
+                          dst_keys,
+                          dst_payload);
+    });
+
+    std::swap(src_keys, dst_keys);
+    std::swap(src_payload, dst_payload);
+  }
+
+  // Odd number of passes, the result is in the temporary
+  if (src_keys != keys.data()) {
+    for_each_block([&](const size_t b) {
+      const auto first = block_first(b);
+      const auto count = block_first(b + 1) - first;
+      std::memcpy(keys.data() + first, src_keys + first, count * sizeof(Key));
+      if (has_payload) {
+        std::memcpy(payload.data() + first,
+                    src_payload + first,
+                    count * sizeof(uint32_t));
+      }
+    });
+  }
+}
+
+template <typename Key>
+void radix_sort(const std::span<Key> keys,
+                const std::span<uint32_t> payload,
+                const size_t num_threads) {
+  // Starting threads costs more than sorting a few keys on this one
+  if (num_threads == 1 || keys.size() < 2 * kMinKeysPerThread) {
+    radix_sort(keys, payload, static_cast<core::ThreadPool *>(nullptr));
+    return;
+  }
+  core::ThreadPool pool(num_threads);
+  radix_sort(keys, payload, &pool);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Sort keys (e.g. morton codes) in place, ascending, with an LSD radix
+ * sort of 8 bits per pass. If given, 'payload' (same size) is permuted along
+ * with the keys, e.g. point indices. The sort is stable.
+ *
+ * Passes where all keys share the digit are skipped, so 30 bit morton codes
+ * take 4 passes at most, and fewer for clustered points.
+ *
+ * @param keys The keys.
+ * @param payload Values to carry along, or empty.
+ * @param num_threads Worker threads, 0 for one per hardware thread. Small
+ * inputs are sorted on the calling thread.
+ * @throws std::invalid_argument if payload is not empty and its size differs.
+ */
+inline void radix_sort(const std::span<uint32_t> keys,
+                       const std::span<uint32_t> payload = {},
+                       const size_t num_threads = 0) {
+  detail::radix_sort(keys, payload, num_threads);
+}
+
+inline void radix_sort(const std::span<uint64_t> keys,
+                       const std::span<uint32_t> payload = {},
+                       const size_t num_threads = 0) {
+  detail::radix_sort(keys, payload, num_threads);
+}
+
+/**
+ * @brief Same, on the workers of an existing pool (e.g. when sorting every
+ * frame, to not start threads each time).
+ */
+inline void radix_sort(const std::span<uint32_t> keys,
+                       const std::span<uint32_t> payload,
+                       core::ThreadPool &pool) {
+  detail::radix_sort(keys, payload, &pool);
+}
+
+inline void radix_sort(const std::span<uint64_t> keys,
+                       const std::span<uint32_t> payload,
+                       core::ThreadPool &pool) {
+  detail::radix_sort(keys, payload, &pool);
+}
+
+}  // namespace morton
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include "radix_sort.hpp"
+
+namespace brt {
+
+// Must match InnerNode in shaders/build_radix_tree.h
+struct InnerNode {
+  int32_t delta;
+  int32_t left;
+  int32_t right;
+  int32_t parent;
+};
+
+// -----------------------------------------------------------------------------
+//          CPU reference of shaders/build_radix_tree.h, line by line
+// -----------------------------------------------------------------------------
+
+inline int sign(const int val) { return (0 < val) - (val < 0); }
+
+inline int div2ceil(const int val) { return (val + 1) >> 1; }
+
+inline int make_leaf(const int index) {
+  return static_cast<int>(static_cast<uint32_t>(index) ^
+                          ((~static_cast<uint32_t>(index)) & (1u << 31)));
+}
+
+// Equal keys compare by their indices, see delta() in build_radix_tree.h
+inline int delta(const uint32_t *keys, const int i, const int j) {
+  if (keys[i] == keys[j]) {
+    return 31 + std::countl_zero(static_cast<uint32_t>(i ^ j));
+  }
+  return std::countl_zero(keys[i] ^ keys[j]) - 1;
+}
+
+inline int delta_safe(const uint32_t *keys,
+                      const int key_num,
+                      const int i,
+                      const int j) {
+  return (j < 0 || j >= key_num) ? -1 : delta(keys, i, j);
+}
+
+/**
+ * @brief Inner node 'i' of the radix tree over 'num_keys' sorted keys.
+ * Duplicates are fine, each key is a leaf.
+ */
+inline void build_node(const uint32_t *keys,
+                       InnerNode *nodes,
+                       const uint32_t num_keys,
+                       const int i) {
+  const auto n = static_cast<int>(num_keys);
+  if (i + 1 >= n) {
+    return;
+  }
+
+  const int direction =
+      sign(delta(keys, i, i + 1) - delta_safe(keys, n, i, i - 1));
+  const int delta_min = delta_safe(keys, n, i, i - direction);
+
+  int I_max = 2;
+  while (delta_safe(keys, n, i, i + I_max * direction) > delta_min) {
+    I_max <<= 2;
+  }
+
+  int I = 0;
+  for (int t = I_max / 2; t; t /= 2) {
+    if (delta_safe(keys, n, i, i + (I + t) * direction) > delta_min) {
+      I += t;
+    }
+  }
+
+  const int j = i + I * direction;
+
+  const int delta_node = delta_safe(keys, n, i, j);
+  int s = 0;
+  int t = I;
+  do {
+    t = div2ceil(t);
+    if (delta_safe(keys, n, i, i + (s + t) * direction) > delta_node) {
+      s += t;
+    }
+  } while (t > 1);
+
+  const int split = i + s * direction + std::min(direction, 0);
+
+  const int left = std::min(i, j) == split ? make_leaf(std::min(i, j)) : split;
+  const int right =
+      std::max(i, j) == split + 1 ? make_leaf(split + 1) : split + 1;
+
+  nodes[i].delta = delta_node;
+  nodes[i].left = left;
+  nodes[i].right = right;
+
+  if (std::min(i, j) != split) {
+    nodes[left].parent = i;
+  }
+  if (std::max(i, j) != split + 1) {
+    nodes[right].parent = i;
+  }
+}
+
+/**
+ * @brief Build all 'num_keys - 1' inner nodes.
+ */
+inline void build(const uint32_t *keys,
+                  InnerNode *nodes,
+                  const uint32_t num_keys) {
+  for (int i = 0; i + 1 < static_cast<int>(num_keys); ++i) {
+    build_node(keys, nodes, num_keys, i);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//          Batches of independent trees (build_radix_tree_batched.cl)
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Offsets table of problems packed back to back (see
+ * shaders/segments.h): problem 'p' is the elements [offsets[p], offsets[p + 1]),
+ * the last entry is the total.
+ */
+inline std::vector<uint32_t> make_offsets(std::span<const uint32_t> sizes) {
+  std::vector<uint32_t> offsets(sizes.size() + 1, 0);
+  std::inclusive_scan(sizes.begin(), sizes.end(), offsets.begin() + 1);
+  return offsets;
+}
+
+/**
+ * @brief Sort every segment of 'keys' on its own, in place. The offsets stay
+ * the same: duplicates are kept, the trees have a leaf per key.
+ */
+inline void sort_segments(std::span<uint32_t> keys,
+                          std::span<const uint32_t> offsets) {
+  for (size_t p = 0; p + 1 < offsets.size(); ++p) {
+    morton::radix_sort(
+        keys.subspan(offsets[p], offsets[p + 1] - offsets[p]), {}, 1);
+  }
+}
+
+/**
+ * @brief CPU reference of build_radix_tree_batched.cl: the tree of segment 'p'
+ * in nodes[offsets[p]...] (one slot per key, the last is unused), with
+ * indices relative to offsets[p].
+ */
+inline void build_batched(const uint32_t *keys,
+                          InnerNode *nodes,
+                          std::span<const uint32_t> offsets) {
+  for (size_t p = 0; p + 1 < offsets.size(); ++p) {
+    build(keys + offsets[p], nodes + offsets[p], offsets[p + 1] - offsets[p]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//                          Incremental updates
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Positions [first, last] (inclusive) of the sorted keys.
+ */
+struct KeyRange {
+  uint32_t first;
+  uint32_t last;
+};
+
+/**
+ * @brief The inner nodes to rebuild after the sorted keys changed in the given
+ * ranges, the number of keys staying the same.
+ *
+ * A node only reads keys inside its range and one past each end (keys are
+ * sorted, so the searches never look further). So the nodes to rebuild are
+ * those around the changed keys, [first - 2, last + 2], and their ancestors,
+ * whose split may move into the changed keys. Ancestors are found by walking
+ * up the parent links of the current tree, until the root (node 0) or an
+ * already collected node.
+ *
+ * @return Node indices, sorted.
+ */
+inline std::vector<uint32_t> affected_nodes(const InnerNode *nodes,
+                                            const uint32_t num_keys,
+                                            std::span<const KeyRange> changed) {
+  if (num_keys < 2) {
+    return {};
+  }
+  const auto num_nodes = num_keys - 1;
+
+  std::vector<bool> marked(num_nodes, false);
+  std::vector<uint32_t> result;
+  for (const auto &[first, last] : changed) {
+    if (first > last || first >= num_keys) {
+      continue;
+    }
+    const auto lo = first >= 2 ? first - 2 : 0u;
+    const auto hi = std::min(last + 2, num_nodes - 1);
+    for (auto i = lo; i <= hi; ++i) {
+      for (auto node = i; !marked[node];) {
+        marked[node] = true;
+        result.push_back(node);
+        if (node == 0) {
+          break;
+        }
+        node = static_cast<uint32_t>(nodes[node].parent);
+      }
+    }
+  }
+  std::ranges::sort(result);
+  return result;
+}
+
+/**
+ * @brief Keeps the sorted keys of a dynamic point set (one per point,
+ * duplicates included) in sync with the points, so that moving a few points
+ * only touches small windows of the sorted array instead of sorting
+ * everything again. There is always one key per point, so indices outside of
+ * the windows never move and the tree can always be updated in place.
+ *
+ *   DynamicKeys keys;
+ *   keys.reset(codes);  // full build over keys.sorted_keys()
+ *   ...
+ *   const auto change = keys.update(ids, new_codes);
+ *   upload keys in change.ranges, rebuild affected_nodes(...)
+ */
+class DynamicKeys {
+ public:
+  struct Change {
+    // Windows of the sorted keys that changed, sorted and disjoint. Keys
+    // outside of them are the same as before.
+    std::vector<KeyRange> ranges;
+
+    [[nodiscard]] bool empty() const { return ranges.empty(); }
+  };
+
+  /**
+   * @brief Start over with the keys (e.g. morton codes) of all points.
+   */
+  void reset(std::span<const uint32_t> point_keys) {
+    point_keys_.assign(point_keys.begin(), point_keys.end());
+    sorted_keys_ = point_keys_;
+    morton::radix_sort(sorted_keys_);
+  }
+
+  /**
+   * @brief Give some points new keys.
+   *
+   * Keys that disappear and keys that appear are paired up in sorted order
+   * into the smallest windows that keep their size; each window is merged on
+   * its own, at a cost proportional to its size.
+   */
+  Change update(std::span<const uint32_t> point_ids,
+                std::span<const uint32_t> new_keys) {
+    // Net change of the number of points per key
+    std::map<uint32_t, int64_t> diff;
+    for (size_t c = 0; c < point_ids.size(); ++c) {
+      auto &key = point_keys_[point_ids[c]];
+      if (key == new_keys[c]) {
+        continue;
+      }
+      --diff[key];
+      ++diff[new_keys[c]];
+      key = new_keys[c];
+    }
+
+    // Removing the key at position p sits at 2p + 1, inserting one before
+    // position p at 2p. Copies of a key go after the last one and leave from
+    // the last ones, so iterating the keys in order keeps the events sorted.
+    std::vector<Event> events;
+    for (const auto &[key, d] : diff) {
+      const auto end = static_cast<uint32_t>(
+          std::ranges::upper_bound(sorted_keys_, key) - sorted_keys_.begin());
+      for (int64_t c = d; c < 0; ++c) {
+        events.push_back({2 * static_cast<uint32_t>(end + c) + 1, key, false});
+      }
+      for (int64_t c = 0; c < d; ++c) {
+        events.push_back({2 * end, key, true});
+      }
+    }
+
+    // A window closes as soon as it has as many insertions as removals. They
+    // balance out overall, so the last event always closes one.
+    Change change;
+    int64_t balance = 0;
+    size_t begin = 0;
+    for (size_t e = 0; e < events.size(); ++e) {
+      balance += events[e].insert ? 1 : -1;
+      if (balance == 0) {
+        const auto lo = events[begin].coord / 2;
+        const auto hi = (events[e].coord - 1) / 2;
+        rebuild_window(lo, hi, std::span(events).subspan(begin, e + 1 - begin));
+        change.ranges.push_back({lo, hi});
+        begin = e + 1;
+      }
+    }
+    return change;
+  }
+
+  [[nodiscard]] const std::vector<uint32_t> &sorted_keys() const {
+    return sorted_keys_;
+  }
+  [[nodiscard]] const std::vector<uint32_t> &point_keys() const {
+    return point_keys_;
+  }
+
+ private:
+  struct Event {
+    uint32_t coord;
+    uint32_t key;
+    bool insert;
+  };
+
+  /**
+   * @brief Replace sorted_keys_[lo, hi] by its keys minus the removed ones
+   * plus the inserted ones of 'events' (all inside the window), in order.
+   */
+  void rebuild_window(const uint32_t lo,
+                      const uint32_t hi,
+                      std::span<const Event> events) {
+    std::vector<uint32_t> keys;
+    keys.reserve(hi - lo + 1);
+
+    auto e = events.begin();
+    for (auto i = lo; i <= hi; ++i) {
+      for (; e != events.end() && e->coord == 2 * i; ++e) {
+        keys.push_back(e->key);
+      }
+      if (e != events.end() && e->coord == 2 * i + 1) {
+        ++e;  // removed
+        continue;
+      }
+      keys.push_back(sorted_keys_[i]);
+    }
+    for (; e != events.end(); ++e) {
+      keys.push_back(e->key);
+    }
+
+    std::ranges::copy(keys, sorted_keys_.begin() + lo);
+  }
+
+  std::vector<uint32_t> point_keys_;   // current key of every point
+  std::vector<uint32_t> sorted_keys_;  // the same keys, sorted
+};
+
+}  // namespace brt
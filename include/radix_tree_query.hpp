@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <glm/glm.hpp>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/thread_pool.hpp"
+#include "radix_sort.hpp"
+#include "radix_tree.hpp"
+
+namespace brt {
+
+// -----------------------------------------------------------------------------
+//      CPU reference of the query kernels (shaders/radix_tree_query.h)
+// -----------------------------------------------------------------------------
+
+// Must match the node boxes of shaders/radix_tree_query.h (two float4)
+struct Aabb {
+  glm::vec4 min;
+  glm::vec4 max;
+};
+
+// Children references of InnerNode: leaves have the top bit set (make_leaf)
+inline bool is_leaf(const int32_t ref) { return ref < 0; }
+
+inline uint32_t leaf_index(const int32_t ref) {
+  return static_cast<uint32_t>(ref) & 0x7FFFFFFFu;
+}
+
+/**
+ * @brief Index of a node in the box array: inner node i at i, leaf l after
+ * the 'num_leaves - 1' inner nodes.
+ */
+inline uint32_t aabb_slot(const int32_t ref, const uint32_t num_leaves) {
+  return is_leaf(ref) ? num_leaves - 1 + leaf_index(ref)
+                      : static_cast<uint32_t>(ref);
+}
+
+/**
+ * @brief The root: inner node 0, or the only leaf.
+ */
+inline int32_t root_ref(const uint32_t num_leaves) {
+  return num_leaves == 1 ? make_leaf(0) : 0;
+}
+
+/**
+ * @brief Points sorted by morton code and grouped by code. Each unique code
+ * is one leaf of the radix tree.
+ */
+struct SortedPoints {
+  std::vector<uint32_t> keys;          // unique codes, sorted (the leaves)
+  std::vector<uint32_t> leaf_offsets;  // leaf l: [offsets[l], offsets[l + 1])
+  std::vector<glm::vec4> points;       // sorted by code
+  std::vector<uint32_t> point_ids;     // input index of each sorted point
+};
+
+inline SortedPoints sort_points(std::span<const glm::vec4> points,
+                                std::span<const uint32_t> codes) {
+  SortedPoints sorted;
+  sorted.point_ids.resize(points.size());
+  std::iota(sorted.point_ids.begin(), sorted.point_ids.end(), 0u);
+  std::vector<uint32_t> sorted_codes(codes.begin(), codes.end());
+  morton::radix_sort(sorted_codes, sorted.point_ids);
+
+  sorted.points.reserve(points.size());
+  for (uint32_t i = 0; i < sorted.point_ids.size(); ++i) {
+    const auto code = sorted_codes[i];
+    if (sorted.keys.empty() || sorted.keys.back() != code) {
+      sorted.keys.push_back(code);
+      sorted.leaf_offsets.push_back(i);
+    }
+    sorted.points.push_back(points[sorted.point_ids[i]]);
+  }
+  sorted.leaf_offsets.push_back(static_cast<uint32_t>(points.size()));
+  return sorted;
+}
+
+/**
+ * @brief Parent inner node of every leaf (InnerNode only links inner nodes),
+ * -1 for a lone leaf. CPU reference of radix_tree_leaf_parents.cl.
+ */
+inline std::vector<int32_t> leaf_parents(const InnerNode *nodes,
+                                         const uint32_t num_leaves) {
+  std::vector<int32_t> parents(num_leaves, -1);
+  for (uint32_t i = 0; i + 1 < num_leaves; ++i) {
+    for (const auto child : {nodes[i].left, nodes[i].right}) {
+      if (is_leaf(child)) {
+        parents[leaf_index(child)] = static_cast<int32_t>(i);
+      }
+    }
+  }
+  return parents;
+}
+
+/**
+ * @brief Boxes of all nodes (see aabb_slot()): leaves bound their points,
+ * inner nodes their children. CPU reference of radix_tree_aabbs.cl.
+ */
+inline std::vector<Aabb> build_aabbs(const InnerNode *nodes,
+                                     const uint32_t num_leaves,
+                                     const uint32_t *leaf_offsets,
+                                     const glm::vec4 *points) {
+  std::vector<Aabb> aabbs(2 * num_leaves - 1);
+  for (uint32_t l = 0; l < num_leaves; ++l) {
+    auto &box = aabbs[num_leaves - 1 + l];
+    box = {points[leaf_offsets[l]], points[leaf_offsets[l]]};
+    for (auto p = leaf_offsets[l] + 1; p < leaf_offsets[l + 1]; ++p) {
+      box.min = glm::min(box.min, points[p]);
+      box.max = glm::max(box.max, points[p]);
+    }
+  }
+
+  // Post-order, children before parents
+  const auto merge = [&](const auto &self, const uint32_t i) -> void {
+    const auto left = nodes[i].left;
+    const auto right = nodes[i].right;
+    if (!is_leaf(left)) {
+      self(self, static_cast<uint32_t>(left));
+    }
+    if (!is_leaf(right)) {
+      self(self, static_cast<uint32_t>(right));
+    }
+    const auto &a = aabbs[aabb_slot(left, num_leaves)];
+    const auto &b = aabbs[aabb_slot(right, num_leaves)];
+    aabbs[i] = {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+  };
+  if (num_leaves > 1) {
+    merge(merge, 0);
+  }
+  return aabbs;
+}
+
+/**
+ * @brief Everything a query reads. All arrays are the ones of SortedPoints,
+ * plus the tree and its boxes.
+ */
+struct TreeView {
+  const InnerNode *nodes;
+  const Aabb *aabbs;
+  const uint32_t *leaf_offsets;
+  const glm::vec4 *points;
+  const uint32_t *point_ids;
+  uint32_t num_leaves;
+};
+
+// Inner node deltas strictly grow downwards and stay below 63, also on trees
+// over equal keys, so a depth first traversal never holds more than 63
+// entries.
+inline constexpr uint32_t kStackSize = 64;
+
+// Largest k of the kNN kernel (per thread arrays)
+inline constexpr uint32_t kMaxK = 32;
+
+/**
+ * @brief Check the 'k' of knn() and radix_tree_knn.cl, before dispatching.
+ *
+ * @throws std::invalid_argument unless 1 <= k <= kMaxK.
+ */
+inline void check_knn_k(const uint32_t k) {
+  if (k == 0 || k > kMaxK) {
+    throw std::invalid_argument("kNN needs 1 <= k <= " +
+                                std::to_string(kMaxK) + ", got " +
+                                std::to_string(k));
+  }
+}
+
+// Marks the unused result slots
+inline constexpr uint32_t kNoPoint = 0xFFFFFFFFu;
+
+inline float distance2(const glm::vec4 &a, const glm::vec4 &b) {
+  const auto dx = a.x - b.x;
+  const auto dy = a.y - b.y;
+  const auto dz = a.z - b.z;
+  return dx * dx + dy * dy + dz * dz;
+}
+
+inline float distance2(const Aabb &box, const glm::vec4 &q) {
+  const auto dx = std::max({box.min.x - q.x, 0.0f, q.x - box.max.x});
+  const auto dy = std::max({box.min.y - q.y, 0.0f, q.y - box.max.y});
+  const auto dz = std::max({box.min.z - q.z, 0.0f, q.z - box.max.z});
+  return dx * dx + dy * dy + dz * dz;
+}
+
+/**
+ * @brief The 'k' (<= kMaxK) nearest points of 'query' within 'max_radius'
+ * (infinity for no limit), nearest first. Unused slots get kNoPoint and
+ * infinity.
+ *
+ * @return Number of neighbours found.
+ * @throws std::invalid_argument see check_knn_k().
+ */
+inline uint32_t knn(const TreeView &tree,
+                    const glm::vec4 &query,
+                    const uint32_t k,
+                    const float max_radius,
+                    uint32_t *out_ids,
+                    float *out_dist2) {
+  check_knn_k(k);
+  const auto max_dist2 = max_radius * max_radius;
+  std::fill_n(out_ids, k, kNoPoint);
+  std::fill_n(out_dist2, k, std::numeric_limits<float>::infinity());
+
+  uint32_t count = 0;
+  auto bound = max_dist2;
+
+  int32_t stack[kStackSize];
+  uint32_t sp = 0;
+  stack[sp++] = root_ref(tree.num_leaves);
+  while (sp > 0) {
+    const auto ref = stack[--sp];
+    if (distance2(tree.aabbs[aabb_slot(ref, tree.num_leaves)], query) >
+        bound) {
+      continue;  // the bound shrank since it was pushed
+    }
+
+    if (is_leaf(ref)) {
+      const auto l = leaf_index(ref);
+      for (auto p = tree.leaf_offsets[l]; p < tree.leaf_offsets[l + 1]; ++p) {
+        const auto d = distance2(tree.points[p], query);
+        if (d > bound || (count == k && d >= out_dist2[k - 1])) {
+          continue;
+        }
+        // Insertion into the sorted list, dropping the farthest when full
+        auto c = count < k ? count++ : k - 1;
+        for (; c > 0 && out_dist2[c - 1] > d; --c) {
+          out_dist2[c] = out_dist2[c - 1];
+          out_ids[c] = out_ids[c - 1];
+        }
+        out_dist2[c] = d;
+        out_ids[c] = tree.point_ids[p];
+        if (count == k) {
+          bound = std::min(max_dist2, out_dist2[k - 1]);
+        }
+      }
+      continue;
+    }
+
+    // Nearer child on top, so it is visited first and shrinks the bound
+    const auto &node = tree.nodes[ref];
+    const auto dl =
+        distance2(tree.aabbs[aabb_slot(node.left, tree.num_leaves)], query);
+    const auto dr =
+        distance2(tree.aabbs[aabb_slot(node.right, tree.num_leaves)], query);
+    const auto near = dl <= dr ? node.left : node.right;
+    const auto far = dl <= dr ? node.right : node.left;
+    if (std::max(dl, dr) <= bound && sp < kStackSize) {
+      stack[sp++] = far;
+    }
+    if (std::min(dl, dr) <= bound && sp < kStackSize) {
+      stack[sp++] = near;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief All points within 'radius' of 'query', in traversal order. Only the
+ * first 'max_results' are written.
+ *
+ * @return Number of points found, can be more than 'max_results'.
+ */
+inline uint32_t radius_search(const TreeView &tree,
+                              const glm::vec4 &query,
+                              const float radius,
+                              const uint32_t max_results,
+                              uint32_t *out_ids) {
+  const auto r2 = radius * radius;
+  uint32_t count = 0;
+
+  int32_t stack[kStackSize];
+  uint32_t sp = 0;
+  stack[sp++] = root_ref(tree.num_leaves);
+  while (sp > 0) {
+    const auto ref = stack[--sp];
+    if (is_leaf(ref)) {
+      const auto l = leaf_index(ref);
+      for (auto p = tree.leaf_offsets[l]; p < tree.leaf_offsets[l + 1]; ++p) {
+        if (distance2(tree.points[p], query) <= r2) {
+          if (count < max_results) {
+            out_ids[count] = tree.point_ids[p];
+          }
+          ++count;
+        }
+      }
+      continue;
+    }
+
+    const auto &node = tree.nodes[ref];
+    for (const auto child : {node.right, node.left}) {
+      if (distance2(tree.aabbs[aabb_slot(child, tree.num_leaves)], query) <=
+              r2 &&
+          sp < kStackSize) {
+        stack[sp++] = child;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Run 'fn(first, last)' over [0, n) cut into chunks, on 'num_threads'
+ * threads (0 for one per hardware thread).
+ */
+template <typename Fn>
+void parallel_for(const uint32_t n, const size_t num_threads, Fn &&fn) {
+  core::ThreadPool pool(num_threads);
+  const auto num_chunks = static_cast<uint32_t>(pool.size() * 4);
+  const auto chunk = std::max(1u, (n + num_chunks - 1) / num_chunks);
+
+  std::vector<std::future<void>> results;
+  for (uint32_t first = 0; first < n; first += chunk) {
+    const auto last = std::min(n, first + chunk);
+    results.push_back(pool.submit([&fn, first, last] { fn(first, last); }));
+  }
+  for (auto &result : results) {
+    result.get();
+  }
+}
+
+/**
+ * @brief knn() for every query, multithreaded. Query q writes
+ * out_ids[q * k, (q + 1) * k) and the same range of out_dist2.
+ */
+inline void knn_batch(const TreeView &tree,
+                      std::span<const glm::vec4> queries,
+                      const uint32_t k,
+                      const float max_radius,
+                      uint32_t *out_ids,
+                      float *out_dist2,
+                      const size_t num_threads = 0) {
+  parallel_for(static_cast<uint32_t>(queries.size()),
+               num_threads,
+               [&](const uint32_t first, const uint32_t last) {
+                 for (auto q = first; q < last; ++q) {
+                   knn(tree,
+                       queries[q],
+                       k,
+                       max_radius,
+                       out_ids + size_t{q} * k,
+                       out_dist2 + size_t{q} * k);
+                 }
+               });
+}
+
+/**
+ * @brief radius_search() for every query, multithreaded. Query q writes
+ * out_ids[q * max_results, ...) and its total count to out_counts[q].
+ */
+inline void radius_batch(const TreeView &tree,
+                         std::span<const glm::vec4> queries,
+                         const float radius,
+                         const uint32_t max_results,
+                         uint32_t *out_ids,
+                         uint32_t *out_counts,
+                         const size_t num_threads = 0) {
+  parallel_for(static_cast<uint32_t>(queries.size()),
+               num_threads,
+               [&](const uint32_t first, const uint32_t last) {
+                 for (auto q = first; q < last; ++q) {
+                   out_counts[q] = radius_search(tree,
+                                                 queries[q],
+                                                 radius,
+                                                 max_results,
+                                                 out_ids + size_t{q} *
+                                                               max_results);
+                 }
+               });
+}
+
+}  // namespace brt
@@ -0,0 +1,43 @@
+#include "bounds.h"
+#include "dispatch.h"
+
+// Axis aligned bounding box of the xyz of 'n' points, written into the bounds
+// buffer (see bounds.h), which must be reset before the dispatch. Works for any
+// number of threads (grid-stride loop), e.g. one per point.
+kernel void foo(global const float4 *in_xyz, global uint *g_bounds, uint n) {
+  local uint l_bounds[8];
+
+  // Strided, so that workgroups smaller than 8 threads cover every slot
+  const uint lID = get_local_id(0);
+  const uint local_size = get_local_size(0);
+  for (uint b = lID; b < 8u; b += local_size) {
+    l_bounds[b] = b < 4u ? 0xFFFFFFFFu : 0u;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Threads without points keep +/-inf, which do not change the result
+  float4 lo = (float4)(INFINITY);
+  float4 hi = (float4)(-INFINITY);
+  // A dispatch spread over several rows has a thread per point, one row
+  // strides over all of them. Never steps past 'n', so it cannot wrap around.
+  const uint stride = get_global_size(1) > 1u ? n : get_global_size(0);
+  for (uint i = linear_global_id(n); i < n; i += min(stride, n - i)) {
+    const float4 p = in_xyz[i];
+    lo = fmin(lo, p);
+    hi = fmax(hi, p);
+  }
+
+  atomic_min(&l_bounds[0], float_to_ordered(lo.x));
+  atomic_min(&l_bounds[1], float_to_ordered(lo.y));
+  atomic_min(&l_bounds[2], float_to_ordered(lo.z));
+  atomic_max(&l_bounds[4], float_to_ordered(hi.x));
+  atomic_max(&l_bounds[5], float_to_ordered(hi.y));
+  atomic_max(&l_bounds[6], float_to_ordered(hi.z));
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // One global atomic per axis and workgroup
+  for (uint b = lID; b < 3u; b += local_size) {
+    atomic_min(&g_bounds[b], l_bounds[b]);
+    atomic_max(&g_bounds[4u + b], l_bounds[4u + b]);
+  }
+}
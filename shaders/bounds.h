@@ -0,0 +1,36 @@
+// Shared by bounding_box.cl and morton32_bounds.cl. Not a kernel by itself, so
+// compile_shaders.py skips it (.h).
+//
+// Bounds buffer layout (8 uint): min x, y, z, (unused), max x, y, z, (unused),
+// each stored with float_to_ordered(). Reset it to min = 0xFFFFFFFF, max = 0
+// before a reduction, see morton::kEmptyBoundsBuffer in morton.hpp.
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+// Maps floats to uints of the same order, so that atomic_min / atomic_max on
+// uint work as float min / max.
+inline uint float_to_ordered(float f) {
+  const uint u = as_uint(f);
+  return (u & 0x80000000u) != 0u ? ~u : (u | 0x80000000u);
+}
+
+inline float ordered_to_float(uint u) {
+  return as_float((u & 0x80000000u) != 0u ? (u & 0x7FFFFFFFu) : ~u);
+}
+
+inline float4 bounds_min(global const uint *g_bounds) {
+  return (float4)(ordered_to_float(g_bounds[0]),
+                  ordered_to_float(g_bounds[1]),
+                  ordered_to_float(g_bounds[2]),
+                  0.0f);
+}
+
+inline float4 bounds_max(global const uint *g_bounds) {
+  return (float4)(ordered_to_float(g_bounds[4]),
+                  ordered_to_float(g_bounds[5]),
+                  ordered_to_float(g_bounds[6]),
+                  0.0f);
+}
+
+#endif  // BOUNDS_H
@@ -0,0 +1,126 @@
+// Shared by build_radix_tree.cl, build_radix_tree_indirect.cl,
+// build_radix_tree_update.cl and build_radix_tree_batched.cl. Not a kernel by
+// itself, so compile_shaders.py skips it (.h).
+
+#ifndef BUILD_RADIX_TREE_H
+#define BUILD_RADIX_TREE_H
+
+#define CODE_BIT 32
+
+typedef struct {
+  int delta;
+  int left;
+  int right;
+  int parent;
+} InnerNode;
+
+int sign(int val) { return (0 < val) - (val < 0); }
+
+int div2ceil(int val) { return (val + 1) >> 1; }
+
+int make_leaf(int index) {
+  return index ^ ((-1 ^ index) & 1u << (CODE_BIT - 1));
+}
+
+int make_internal(int index) { return index; }
+
+// Keys 'i' and 'j' of the segment of keys starting at 'first'. Equal keys
+// compare by their indices instead, as if each key had its index appended
+// (Karras 2012): duplicates then get a leaf each, with no unique pass needed.
+int delta(uint *morton_keys, uint first, int i, int j) {
+  const uint li = morton_keys[first + i];
+  const uint lj = morton_keys[first + j];
+  if (li == lj) {
+    return CODE_BIT - 1 + clz((uint)i ^ (uint)j);
+  }
+  return clz(li ^ lj) - 1;
+}
+
+// -1 outside of the segment, so that searches stop at its ends
+int delta_safe(uint *morton_keys, uint first, int key_num, int i, int j) {
+  return (j < 0 || j >= key_num) ? -1 : delta(morton_keys, first, i, j);
+}
+
+// Ported from
+// https://github.com/xuyanwen2012/redwood-mapping/blob/quickly_change/bench_gpu/brt.cuh
+//
+// Computes inner node 'i' of the radix tree over the 'num_keys' sorted keys
+// starting at 'first', duplicates allowed. There are 'num_keys - 1' inner
+// nodes, stored from inner_nodes[first] on. Node and leaf indices are relative
+// to 'first', so each segment is a tree of its own (see
+// build_radix_tree_batched.cl).
+void build_radix_tree_segment_node(global uint *g_morton_keys,
+                                   global InnerNode *inner_nodes,
+                                   const uint first,
+                                   const uint num_keys,
+                                   const int i) {
+  if (i + 1 >= num_keys) return;
+
+  int direction =
+      sign(delta(g_morton_keys, first, i, i + 1) -
+           delta_safe(g_morton_keys, first, num_keys, i, i - 1));
+
+  int delta_min =
+      delta_safe(g_morton_keys, first, num_keys, i, i - direction);
+
+  int I_max = 2;
+  while (delta_safe(
+             g_morton_keys, first, num_keys, i, i + I_max * direction) >
+         delta_min) {
+    I_max <<= 2;
+  }
+
+  // Find the other end using binary search.
+  int I = 0;
+  for (int t = I_max / 2; t; t /= 2) {
+    if (delta_safe(
+            g_morton_keys, first, num_keys, i, i + (I + t) * direction) >
+        delta_min) {
+      I += t;
+    }
+  }
+
+  int j = i + I * direction;
+
+  // Find the split position using binary search.
+  int delta_node = delta_safe(g_morton_keys, first, num_keys, i, j);
+  int s = 0;
+  int t = I;
+
+  do {
+    t = div2ceil(t);
+    if (delta_safe(
+            g_morton_keys, first, num_keys, i, i + (s + t) * direction) >
+        delta_node) {
+      s += t;
+    }
+  } while (t > 1);
+
+  int split = i + s * direction + min(direction, 0);
+
+  int left = min(i, j) == split ? make_leaf(min(i, j)) : make_internal(split);
+  int right =
+      max(i, j) == split + 1 ? make_leaf(split + 1) : make_internal(split + 1);
+
+  inner_nodes[first + i].delta = delta_node;
+  inner_nodes[first + i].left = left;
+  inner_nodes[first + i].right = right;
+
+  if (min(i, j) != split) {
+    inner_nodes[first + left].parent = i;
+  }
+  if (max(i, j) != split + 1) {
+    inner_nodes[first + right].parent = i;
+  }
+}
+
+// Computes inner node 'i' of the radix tree over 'num_keys' sorted keys. There
+// are 'num_keys - 1' inner nodes.
+void build_radix_tree_node(global uint *g_morton_keys,
+                           global InnerNode *inner_nodes,
+                           const uint num_keys,
+                           const int i) {
+  build_radix_tree_segment_node(g_morton_keys, inner_nodes, 0u, num_keys, i);
+}
+
+#endif  // BUILD_RADIX_TREE_H
@@ -0,0 +1,25 @@
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+#include "build_radix_tree.h"
+#include "dispatch.h"
+#include "segments.h"
+
+// build_radix_tree.cl over many sorted key sets packed into one buffer
+// (see segments.h), in a single dispatch of one thread per key. Set 's' gets
+// its own tree in inner_nodes[offsets[s]...], with indices relative to
+// offsets[s]. The searches stop at the ends of the set, so trees never cross.
+kernel void foo(global uint *g_morton_keys,
+                global InnerNode *inner_nodes,
+                global const uint *offsets,
+                uint num_segments) {
+  const uint index = linear_global_id(offsets[num_segments]);
+  if (index >= offsets[num_segments]) return;
+
+  const uint s = find_segment(offsets, num_segments, index);
+  const uint first = offsets[s];
+  build_radix_tree_segment_node(g_morton_keys,
+                                inner_nodes,
+                                first,
+                                offsets[s + 1u] - first,
+                                index - first);
+}
@@ -0,0 +1,14 @@
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+#include "build_radix_tree.h"
+#include "dispatch.h"
+
+// Same as build_radix_tree.cl, but the number of keys is read from a device
+// buffer written by an earlier stage (e.g. a filter), so it can be dispatched
+// with vkCmdDispatchIndirect without a readback.
+kernel void foo(global uint *g_morton_keys,
+                global InnerNode *inner_nodes,
+                global const uint *num_keys) {
+  const uint n = num_keys[0];
+  build_radix_tree_node(g_morton_keys, inner_nodes, n, linear_global_id(n));
+}
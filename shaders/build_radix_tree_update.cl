@@ -0,0 +1,18 @@
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+#include "build_radix_tree.h"
+#include "dispatch.h"
+
+// Incremental version of build_radix_tree.cl: only rebuilds the inner nodes
+// listed in 'node_indices' (see brt::affected_nodes() in radix_tree.hpp),
+// after some keys changed and the number of keys stayed the same. One thread
+// per listed node.
+kernel void foo(global uint *g_morton_keys,
+                global InnerNode *inner_nodes,
+                global const uint *node_indices,
+                uint num_keys,
+                uint num_nodes) {
+  const uint t = linear_global_id(num_nodes);
+  if (t >= num_nodes) return;
+  build_radix_tree_node(g_morton_keys, inner_nodes, num_keys, node_indices[t]);
+}
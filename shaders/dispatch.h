@@ -0,0 +1,23 @@
+// Index of the work-item in a dispatch of Algorithm::record_dispatch_tmp(),
+// which spreads the workgroups over X and Y when there are more than a device
+// has to support in X. Not a kernel by itself, so compile_shaders.py skips it
+// (.h).
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+// maxComputeWorkGroupCount guaranteed by Vulkan, must match
+// Algorithm::kMaxWorkGroupCount
+#define MAX_WORKGROUP_COUNT 65535u
+
+// The element of this work-item, counting row by row over X and Y, or 'n' if
+// it has none. The last row can reach past 2^32, so the check is done before
+// the multiplication can wrap around onto a valid element.
+inline uint linear_global_id(uint n) {
+  const uint x = get_global_id(0);
+  const uint y = get_global_id(1);
+  if (x >= n || y > (n - 1u - x) / get_global_size(0)) return n;
+  return y * get_global_size(0) + x;
+}
+
+#endif  // DISPATCH_H
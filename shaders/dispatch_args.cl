@@ -0,0 +1,47 @@
+// clang-format off
+
+// RUN: clspv --spv-version=1.5 --cl-std=CLC++ -inline-entry-points dispatch_args.cl -o compiled_shaders/dispatch_args.spv
+//
+// RUN: clspv-reflection --target-env spv1.5 compiled_shaders/dispatch_args.spv
+
+// clang-format on
+
+#include "dispatch.h"
+
+// Turns an element count computed on the GPU into the arguments of a
+// vkCmdDispatchIndirect (VkDispatchIndirectCommand, 3 uints). Launch it with a
+// single work-item.
+__kernel void foo(__global const uint *count,
+                  __global uint *dispatch_args,
+                  int count_adjust,
+                  uint threads_per_block) {
+  if (get_global_id(0) != 0) return;
+
+  // Clamped to [0, 2^32 - 1] in 32 bits, 64 bit integers would need
+  // shaderInt64
+  const uint c = count[0];
+  const uint adjust = convert_uint(abs(count_adjust));
+  uint n;
+  if (count_adjust < 0) {
+    n = c > adjust ? c - adjust : 0u;
+  } else {
+    n = c > 0xFFFFFFFFu - adjust ? 0xFFFFFFFFu : c + adjust;
+  }
+
+  // Written this way so counts close to 2^32 do not wrap around
+  const uint blocks =
+      n / threads_per_block + (n % threads_per_block != 0u ? 1u : 0u);
+
+  // Spread over rows like Algorithm::num_blocks(), see dispatch.h. Nothing can
+  // be thrown here, so counts beyond MAX_WORKGROUP_COUNT rows are cut short.
+  if (blocks <= MAX_WORKGROUP_COUNT) {
+    dispatch_args[0] = blocks;
+    dispatch_args[1] = 1u;
+  } else {
+    const uint rows = blocks / MAX_WORKGROUP_COUNT +
+                      (blocks % MAX_WORKGROUP_COUNT != 0u ? 1u : 0u);
+    dispatch_args[0] = blocks / rows + (blocks % rows != 0u ? 1u : 0u);
+    dispatch_args[1] = min(rows, MAX_WORKGROUP_COUNT);
+  }
+  dispatch_args[2] = 1u;
+}
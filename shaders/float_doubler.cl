@@ -7,8 +7,10 @@
 
 // clang-format on
 
+#include "dispatch.h"
+
 __kernel void foo(__global float *in, __global float *out, const uint n) {
-  uint index = get_global_id(0);
+  uint index = linear_global_id(n);
   if (index >= n) return;
 
   out[index] = in[index] * 2.0f;
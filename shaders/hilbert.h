@@ -0,0 +1,99 @@
+// Shared by the hilbert*.cl kernels. Not a kernel by itself, so
+// compile_shaders.py skips it (.h).
+//
+// 3D Hilbert keys: like morton codes, one bit of each axis per level, so a
+// key prefix of 3l bits is still an octant at level l and the keys work with
+// the radix tree build unchanged. Consecutive keys are always neighbouring
+// cells though, which keeps nearby points closer in the sorted order.
+
+#ifndef HILBERT_H
+#define HILBERT_H
+
+#include "morton32.h"
+
+// Skilling's transform ("Programming the Hilbert curve", 2004) of the cell
+// coordinates, 'bits' per axis, into the transposed Hilbert index: bit b of
+// the key at level b is spread over x (most significant), y and z.
+inline uint3 hilbert_transpose(uint3 v, uint bits) {
+  const uint m = 1u << (bits - 1u);
+
+  // Inverse undo
+  for (uint q = m; q > 1u; q >>= 1) {
+    const uint p = q - 1u;
+    if (v.x & q) {
+      v.x ^= p;
+    }
+    if (v.y & q) {
+      v.x ^= p;
+    } else {
+      const uint t = (v.x ^ v.y) & p;
+      v.x ^= t;
+      v.y ^= t;
+    }
+    if (v.z & q) {
+      v.x ^= p;
+    } else {
+      const uint t = (v.x ^ v.z) & p;
+      v.x ^= t;
+      v.z ^= t;
+    }
+  }
+
+  // Gray encode
+  v.y ^= v.x;
+  v.z ^= v.y;
+  uint t = 0u;
+  for (uint q = m; q > 1u; q >>= 1) {
+    if (v.z & q) {
+      t ^= q - 1u;
+    }
+  }
+  return v ^ t;
+}
+
+// 30 bit key (10 bits per axis) of the cell (i, j, k)
+inline uint hilbert32_encode(uint i, uint j, uint k) {
+  const uint3 t = hilbert_transpose((uint3)(i, j, k) & 0x3FFu, 10u);
+  return encode(t.z, t.y, t.x);
+}
+
+// Spreads the low 21 bits of 'a' to every third bit of a 64 bit word
+inline ulong expand_bit64(uint a) {
+  ulong x = a & 0x1FFFFFu;
+  x = (x | (x << 32)) & 0x1F00000000FFFFul;
+  x = (x | (x << 16)) & 0x1F0000FF0000FFul;
+  x = (x | (x << 8)) & 0x100F00F00F00F00Ful;
+  x = (x | (x << 4)) & 0x10C30C30C30C30C3ul;
+  x = (x | (x << 2)) & 0x1249249249249249ul;
+  return x;
+}
+
+// 63 bit key (21 bits per axis) of the cell (i, j, k)
+inline ulong hilbert64_encode(uint i, uint j, uint k) {
+  const uint3 t = hilbert_transpose((uint3)(i, j, k) & 0x1FFFFFu, 21u);
+  return expand_bit64(t.z) | expand_bit64(t.y) << 1 | expand_bit64(t.x) << 2;
+}
+
+// Key of a point inside the cube [min_coord, min_coord + range), quantized
+// like morton32_xyz()
+inline uint hilbert32_point(float4 p, float min_coord, float range) {
+  const float bit_scale_f = 1023.0f;
+
+  const uint i = convert_uint(bit_scale_f * ((p.x - min_coord) / range));
+  const uint j = convert_uint(bit_scale_f * ((p.y - min_coord) / range));
+  const uint k = convert_uint(bit_scale_f * ((p.z - min_coord) / range));
+
+  return hilbert32_encode(i, j, k);
+}
+
+inline ulong hilbert64_point(float4 p, float min_coord, float range) {
+  const float bit_scale_f = 2097151.0f;  // 2^21 - 1
+
+  const uint i = convert_uint(bit_scale_f * ((p.x - min_coord) / range));
+  const uint j = convert_uint(bit_scale_f * ((p.y - min_coord) / range));
+  const uint k = convert_uint(bit_scale_f * ((p.z - min_coord) / range));
+
+  return hilbert64_encode(i, j, k);
+}
+
+#endif  // HILBERT_H
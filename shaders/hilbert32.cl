@@ -0,0 +1,15 @@
+#include "dispatch.h"
+#include "hilbert.h"
+
+// Drop-in replacement of morton32.cl (same arguments), writing 30 bit Hilbert
+// keys instead of morton codes.
+kernel void foo(global const float4 *in_xyz,
+                global uint *out,
+                uint n,
+                float min_coord,
+                float range) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  out[index] = hilbert32_point(in_xyz[index], min_coord, range);
+}
@@ -0,0 +1,16 @@
+#include "dispatch.h"
+#include "hilbert.h"
+
+// Same as hilbert32.cl with 21 bits per axis, for scenes where 10 bits leave
+// too many points in one cell. The 63 bit keys sort with the 64 bit radix
+// sort, the radix tree build takes 30 bit keys.
+kernel void foo(global const float4 *in_xyz,
+                global ulong *out,
+                uint n,
+                float min_coord,
+                float range) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  out[index] = hilbert64_point(in_xyz[index], min_coord, range);
+}
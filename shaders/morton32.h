@@ -0,0 +1,96 @@
+// Shared by the morton32*.cl kernels. Not a kernel by itself, so
+// compile_shaders.py skips it (.h).
+
+#ifndef MORTON32_H
+#define MORTON32_H
+
+// Forward declaration
+uint expand_bit(uint a);
+uint encode(uint i, uint j, uint k);
+
+inline uint expand_bit(uint a) {
+  uint x = a & 0x000003FF;
+  x = (x | (x << 16)) & 0x030000FF;
+  x = (x | (x << 8)) & 0x0300F00F;
+  x = (x | (x << 4)) & 0x030C30C3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+inline uint encode(uint i, uint j, uint k) {
+  return expand_bit(i) | expand_bit(j) << 1 | expand_bit(k) << 2;
+}
+
+// 30 bit code (10 bits per axis) of a point inside the cube
+// [min_coord, min_coord + range)
+inline uint morton32_xyz(float x,
+                         float y,
+                         float z,
+                         float min_coord,
+                         float range) {
+  uint kCodeLen = 31;
+
+  uint bit_scale = 0xFFFFFFFFu >> (32 - (kCodeLen / 3));  // 1023
+  float bit_scale_f = convert_float(bit_scale);           // 1023
+
+  uint i = convert_uint(bit_scale_f * ((x - min_coord) / range));
+  uint j = convert_uint(bit_scale_f * ((y - min_coord) / range));
+  uint k = convert_uint(bit_scale_f * ((z - min_coord) / range));
+
+  return encode(i, j, k);
+}
+
+inline uint morton32_point(float4 p, float min_coord, float range) {
+  return morton32_xyz(p.x, p.y, p.z, min_coord, range);
+}
+
+// 30 bit code of pre-quantized 16 bit coordinates (see morton::quantize),
+// the top 10 bits of each.
+inline uint morton32_quantized(uint qx, uint qy, uint qz) {
+  return encode(qx >> 6, qy >> 6, qz >> 6);
+}
+
+// -----------------------------------------------------------------------------
+// 16 bit inputs are read through 32 bit words, so the kernels do not need the
+// 16-bit storage feature. Buffers of them must be padded to a multiple of 4
+// bytes.
+
+// Element 'i' of a packed array of 16 bit values (little endian)
+inline uint load_u16(global const uint *words, uint i) {
+  return (words[i >> 1] >> ((i & 1u) << 4)) & 0xFFFFu;
+}
+
+// IEEE half (in the low 16 bits) to float, exact
+inline float half_to_float(uint h) {
+  const uint sign = (h & 0x8000u) << 16;
+  const uint exponent = (h >> 10) & 0x1Fu;
+  const uint mantissa = h & 0x3FFu;
+
+  if (exponent == 0u) {
+    // Zero or subnormal, mantissa * 2^-24
+    const float f = convert_float(mantissa) * 5.9604645e-8f;
+    return sign != 0u ? -f : f;
+  }
+  if (exponent == 31u) {
+    return as_float(sign | 0x7F800000u | (mantissa << 13));
+  }
+  return as_float(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+}
+
+// Same, for a point inside the box [lo, hi], each axis mapped to 10 bits on its
+// own. A flat axis (lo == hi) maps to 0.
+inline uint morton32_point_box(float4 p, float4 lo, float4 hi) {
+  const float bit_scale_f = 1023.0f;
+
+  const float ex = fmax(hi.x - lo.x, FLT_MIN);
+  const float ey = fmax(hi.y - lo.y, FLT_MIN);
+  const float ez = fmax(hi.z - lo.z, FLT_MIN);
+
+  uint i = convert_uint(bit_scale_f * ((p.x - lo.x) / ex));
+  uint j = convert_uint(bit_scale_f * ((p.y - lo.y) / ey));
+  uint k = convert_uint(bit_scale_f * ((p.z - lo.z) / ez));
+
+  return encode(i, j, k);
+}
+
+#endif  // MORTON32_H
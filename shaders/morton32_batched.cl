@@ -0,0 +1,19 @@
+#include "dispatch.h"
+#include "morton32.h"
+#include "segments.h"
+
+// morton32.cl over many point sets packed into one buffer (see segments.h),
+// in a single dispatch. Each set has its own cube, 'cubes' holds
+// (min_coord, range) per set.
+kernel void foo(global const float4 *in_xyz,
+                global uint *out,
+                global const uint *offsets,
+                global const float *cubes,
+                uint num_segments) {
+  const uint index = linear_global_id(offsets[num_segments]);
+  if (index >= offsets[num_segments]) return;
+
+  const uint s = find_segment(offsets, num_segments, index);
+  out[index] =
+      morton32_point(in_xyz[index], cubes[2u * s], cubes[2u * s + 1u]);
+}
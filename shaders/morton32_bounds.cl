@@ -0,0 +1,17 @@
+#include "bounds.h"
+#include "dispatch.h"
+#include "morton32.h"
+
+// Same as morton32.cl, but the bounds come from a buffer written on the device
+// (bounding_box.cl) instead of push constants, and each axis is scaled to its
+// own extent instead of a cube.
+kernel void foo(global const float4 *in_xyz,
+                global uint *out,
+                global const uint *g_bounds,
+                uint n) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  out[index] = morton32_point_box(
+      in_xyz[index], bounds_min(g_bounds), bounds_max(g_bounds));
+}
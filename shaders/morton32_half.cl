@@ -0,0 +1,20 @@
+#include "dispatch.h"
+#include "morton32.h"
+
+// Same as morton32.cl, for packed xyz halves (6 bytes per point). See
+// morton::to_half for the layout.
+kernel void foo(global const uint *in_xyz,
+                global uint *out,
+                uint n,
+                float min_coord,
+                float range) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  const uint base = 3u * index;
+  out[index] = morton32_xyz(half_to_float(load_u16(in_xyz, base)),
+                            half_to_float(load_u16(in_xyz, base + 1u)),
+                            half_to_float(load_u16(in_xyz, base + 2u)),
+                            min_coord,
+                            range);
+}
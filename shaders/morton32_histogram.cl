@@ -0,0 +1,45 @@
+#include "dispatch.h"
+#include "morton32.h"
+
+// Same as morton32.cl, and counts the codes per value of their lowest 8 bits
+// (the digit of the first radix sort pass) on the way, so the sort does not
+// have to read all codes back just to count them. See tmp_sort_histogram.comp.
+//
+// 'g_histogram' (256 uint) must be zeroed before the dispatch, every workgroup
+// adds its counts to it.
+
+#define RADIX_SORT_BINS 256
+
+kernel void foo(global float4 *in_xyz,
+                global uint *out,
+                global uint *g_histogram,
+                uint n,
+                float min_coord,
+                float range) {
+  local uint histogram[RADIX_SORT_BINS];
+
+  const uint lID = get_local_id(0);
+  const uint local_size = get_local_size(0);
+
+  for (uint bin = lID; bin < RADIX_SORT_BINS; bin += local_size) {
+    histogram[bin] = 0u;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // No early return, every thread has to reach the barriers
+  const uint index = linear_global_id(n);
+  if (index < n) {
+    const uint code = morton32_point(in_xyz[index], min_coord, range);
+    out[index] = code;
+    atomic_inc(&histogram[code & (RADIX_SORT_BINS - 1)]);
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // One global atomic per non-empty bin and workgroup
+  for (uint bin = lID; bin < RADIX_SORT_BINS; bin += local_size) {
+    const uint count = histogram[bin];
+    if (count != 0u) {
+      atomic_add(&g_histogram[bin], count);
+    }
+  }
+}
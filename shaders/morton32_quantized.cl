@@ -0,0 +1,15 @@
+#include "dispatch.h"
+#include "morton32.h"
+
+// Codes of points quantized to 16 bits per axis on the host (6 bytes per
+// point), see morton::quantize. The bounds are baked into the quantization, so
+// there is nothing to pass but 'n'.
+kernel void foo(global const uint *in_q, global uint *out, uint n) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  const uint base = 3u * index;
+  out[index] = morton32_quantized(load_u16(in_q, base),
+                                  load_u16(in_q, base + 1u),
+                                  load_u16(in_q, base + 2u));
+}
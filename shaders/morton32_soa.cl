@@ -0,0 +1,18 @@
+#include "dispatch.h"
+#include "morton32.h"
+
+// Same as morton32.cl, for coordinates in three separate buffers (structure of
+// arrays, 12 bytes per point).
+kernel void foo(global const float *in_x,
+                global const float *in_y,
+                global const float *in_z,
+                global uint *out,
+                uint n,
+                float min_coord,
+                float range) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  out[index] =
+      morton32_xyz(in_x[index], in_y[index], in_z[index], min_coord, range);
+}
@@ -0,0 +1,20 @@
+#include "dispatch.h"
+#include "morton32.h"
+
+// Same as morton32.cl, for packed xyz floats (12 bytes per point instead of a
+// float4 with an unused w).
+kernel void foo(global const float *in_xyz,
+                global uint *out,
+                uint n,
+                float min_coord,
+                float range) {
+  const uint index = linear_global_id(n);
+  if (index >= n) return;
+
+  const uint base = 3u * index;
+  out[index] = morton32_xyz(in_xyz[base],
+                            in_xyz[base + 1u],
+                            in_xyz[base + 2u],
+                            min_coord,
+                            range);
+}
@@ -15,7 +15,7 @@
 
 kernel void foo(__global uint *g_elements_in,
                 __global uint *g_elements_out,
-                float n) {
+                uint n) {
   const uint WORKGROUP_SIZE = 256;
   const uint RADIX_SORT_BINS = 256;
   const uint SUBGROUP_SIZE = 64;  // 32 NVIDIA; 64 AMD
@@ -33,7 +33,7 @@ kernel void foo(__global uint *g_elements_in,
   // uint index = get_global_id(0);
   // if (index >= g_num_elements) return;
 
-  const uint g_num_elements = convert_uint(n);
+  const uint g_num_elements = n;
   const uint lID = get_local_id(0);            // thread ID in workgroup(CUDA)
   const uint sID = get_sub_group_id();         // warp ID in workgroup (CUDA)
   const uint lsID = get_sub_group_local_id();  // thread ID in warp (CUDA)
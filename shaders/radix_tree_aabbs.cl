@@ -0,0 +1,50 @@
+#include "dispatch.h"
+#include "radix_tree_query.h"
+
+// Boxes of all nodes, bottom-up. One thread per leaf boxes its points, then
+// walks up: at every inner node the first child to arrive stops, the second
+// one (whose sibling is done) merges both boxes and goes on. Run
+// radix_tree_leaf_parents.cl first.
+kernel void foo(global const InnerNode *inner_nodes,
+                global const uint *leaf_offsets,
+                global const float4 *points,
+                global const int *leaf_parents,
+                global uint *visits,
+                global float4 *aabbs,
+                uint num_leaves) {
+  const uint l = linear_global_id(num_leaves);
+  if (l >= num_leaves) return;
+
+  float4 lo = points[leaf_offsets[l]];
+  float4 hi = lo;
+  for (uint p = leaf_offsets[l] + 1u; p < leaf_offsets[l + 1u]; ++p) {
+    lo = fmin(lo, points[p]);
+    hi = fmax(hi, points[p]);
+  }
+  const uint slot = num_leaves - 1u + l;
+  aabbs[2u * slot] = lo;
+  aabbs[2u * slot + 1u] = hi;
+
+  if (num_leaves == 1u) return;
+
+  // The sibling's box comes from another workgroup, read it past the cache
+  volatile global float4 *boxes = aabbs;
+  int node = leaf_parents[l];
+  while (true) {
+    // Release this child's box before telling the parent, and acquire the
+    // sibling's box after being the second to arrive
+    atomic_work_item_fence(
+        CLK_GLOBAL_MEM_FENCE, memory_order_release, memory_scope_device);
+    if (atomic_inc(&visits[node]) == 0u) return;
+    atomic_work_item_fence(
+        CLK_GLOBAL_MEM_FENCE, memory_order_acquire, memory_scope_device);
+
+    const uint a = aabb_slot(inner_nodes[node].left, num_leaves);
+    const uint b = aabb_slot(inner_nodes[node].right, num_leaves);
+    boxes[2u * node] = fmin(boxes[2u * a], boxes[2u * b]);
+    boxes[2u * node + 1u] = fmax(boxes[2u * a + 1u], boxes[2u * b + 1u]);
+
+    if (node == 0) return;
+    node = inner_nodes[node].parent;
+  }
+}
@@ -0,0 +1,84 @@
+#include "dispatch.h"
+#include "radix_tree_query.h"
+
+// The k (<= MAX_K) nearest points of every query within 'max_radius' (inf for
+// no limit), nearest first. Query q writes out_ids / out_dist2[q * k, +k),
+// unused slots get NO_POINT and inf. The host checks k (brt::check_knn_k()),
+// a bigger one only finds MAX_K points. One thread per query, depth first with
+// a short stack, nearer child first so the bound shrinks early.
+kernel void foo(global const InnerNode *inner_nodes,
+                global const float4 *aabbs,
+                global const uint *leaf_offsets,
+                global const float4 *points,
+                global const uint *point_ids,
+                global const float4 *queries,
+                global uint *out_ids,
+                global float *out_dist2,
+                uint num_queries,
+                uint num_leaves,
+                uint k,
+                float max_radius) {
+  const uint q = linear_global_id(num_queries);
+  if (q >= num_queries || k == 0u) return;
+
+  // Length of the lists, never past the per thread arrays
+  const uint kk = min(k, (uint)MAX_K);
+
+  const float4 query = queries[q];
+  const float max_dist2 = max_radius * max_radius;
+
+  float best_dist2[MAX_K];
+  uint best_ids[MAX_K];
+  uint count = 0u;
+  float bound = max_dist2;
+
+  int stack[STACK_SIZE];
+  uint sp = 0u;
+  stack[sp++] = root_ref(num_leaves);
+  while (sp > 0u) {
+    const int ref = stack[--sp];
+    if (box_distance2(aabbs, aabb_slot(ref, num_leaves), query) > bound) {
+      continue;  // the bound shrank since it was pushed
+    }
+
+    if (is_leaf(ref)) {
+      const uint l = leaf_index(ref);
+      for (uint p = leaf_offsets[l]; p < leaf_offsets[l + 1u]; ++p) {
+        const float d = distance2(points[p], query);
+        if (d > bound || (count == kk && d >= best_dist2[kk - 1u])) {
+          continue;
+        }
+        // Insertion into the sorted list, dropping the farthest when full
+        uint c = count < kk ? count++ : kk - 1u;
+        for (; c > 0u && best_dist2[c - 1u] > d; --c) {
+          best_dist2[c] = best_dist2[c - 1u];
+          best_ids[c] = best_ids[c - 1u];
+        }
+        best_dist2[c] = d;
+        best_ids[c] = point_ids[p];
+        if (count == kk) {
+          bound = fmin(max_dist2, best_dist2[kk - 1u]);
+        }
+      }
+      continue;
+    }
+
+    const int left = inner_nodes[ref].left;
+    const int right = inner_nodes[ref].right;
+    const float dl = box_distance2(aabbs, aabb_slot(left, num_leaves), query);
+    const float dr = box_distance2(aabbs, aabb_slot(right, num_leaves), query);
+    const int near = dl <= dr ? left : right;
+    const int far = dl <= dr ? right : left;
+    if (fmax(dl, dr) <= bound && sp < STACK_SIZE) {
+      stack[sp++] = far;
+    }
+    if (fmin(dl, dr) <= bound && sp < STACK_SIZE) {
+      stack[sp++] = near;
+    }
+  }
+
+  for (uint c = 0u; c < k; ++c) {
+    out_ids[q * k + c] = c < count ? best_ids[c] : NO_POINT;
+    out_dist2[q * k + c] = c < count ? best_dist2[c] : INFINITY;
+  }
+}
@@ -0,0 +1,23 @@
+#include "dispatch.h"
+#include "radix_tree_query.h"
+
+// InnerNode only links inner nodes to their parent, this adds the parent of
+// every leaf, for the bottom-up pass of radix_tree_aabbs.cl. It also resets
+// that pass's visit counters. One thread per inner node.
+kernel void foo(global const InnerNode *inner_nodes,
+                global int *leaf_parents,
+                global uint *visits,
+                uint num_leaves) {
+  const uint i = linear_global_id(num_leaves);
+  if (i + 1u >= num_leaves) return;
+
+  const int left = inner_nodes[i].left;
+  const int right = inner_nodes[i].right;
+  if (is_leaf(left)) {
+    leaf_parents[leaf_index(left)] = (int)i;
+  }
+  if (is_leaf(right)) {
+    leaf_parents[leaf_index(right)] = (int)i;
+  }
+  visits[i] = 0u;
+}
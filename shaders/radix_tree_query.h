@@ -0,0 +1,58 @@
+// Shared by the radix_tree_*.cl kernels that box and query the radix tree of
+// build_radix_tree.h. Not a kernel by itself, so compile_shaders.py skips it
+// (.h). The CPU reference is include/radix_tree_query.hpp.
+//
+// Points are sorted by morton code and grouped by code, each unique code is a
+// leaf: the points of leaf l are points[leaf_offsets[l], leaf_offsets[l + 1]),
+// and point_ids gives their index in the unsorted input.
+//
+// Node boxes are two float4 (min, max) per node: inner node i at slot i, leaf
+// l at slot num_leaves - 1 + l.
+
+#ifndef RADIX_TREE_QUERY_H
+#define RADIX_TREE_QUERY_H
+
+#include "build_radix_tree.h"
+
+// Inner node deltas strictly grow downwards and stay below 63, also on trees
+// over equal keys (delta() of build_radix_tree.h), so a depth first traversal
+// never holds more than 63 entries.
+#define STACK_SIZE 64
+
+// Largest k of radix_tree_knn.cl (per thread arrays)
+#define MAX_K 32
+
+// Marks the unused result slots
+#define NO_POINT 0xFFFFFFFFu
+
+// Children references of InnerNode: leaves have the top bit set (make_leaf)
+inline bool is_leaf(int ref) { return ref < 0; }
+
+inline uint leaf_index(int ref) { return as_uint(ref) & 0x7FFFFFFFu; }
+
+inline uint aabb_slot(int ref, uint num_leaves) {
+  return is_leaf(ref) ? num_leaves - 1u + leaf_index(ref) : as_uint(ref);
+}
+
+// Inner node 0, or the only leaf
+inline int root_ref(uint num_leaves) {
+  return num_leaves == 1u ? make_leaf(0) : 0;
+}
+
+inline float distance2(float4 a, float4 b) {
+  const float dx = a.x - b.x;
+  const float dy = a.y - b.y;
+  const float dz = a.z - b.z;
+  return dx * dx + dy * dy + dz * dz;
+}
+
+inline float box_distance2(global const float4 *aabbs, uint slot, float4 q) {
+  const float4 lo = aabbs[2u * slot];
+  const float4 hi = aabbs[2u * slot + 1u];
+  const float dx = fmax(fmax(lo.x - q.x, 0.0f), q.x - hi.x);
+  const float dy = fmax(fmax(lo.y - q.y, 0.0f), q.y - hi.y);
+  const float dz = fmax(fmax(lo.z - q.z, 0.0f), q.z - hi.z);
+  return dx * dx + dy * dy + dz * dz;
+}
+
+#endif  // RADIX_TREE_QUERY_H
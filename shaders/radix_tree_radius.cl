@@ -0,0 +1,57 @@
+#include "dispatch.h"
+#include "radix_tree_query.h"
+
+// All points within 'radius' of every query. Query q writes the first
+// 'max_results' ids to out_ids[q * max_results, ...) and the total number
+// found (possibly more) to out_counts[q]. One thread per query.
+kernel void foo(global const InnerNode *inner_nodes,
+                global const float4 *aabbs,
+                global const uint *leaf_offsets,
+                global const float4 *points,
+                global const uint *point_ids,
+                global const float4 *queries,
+                global uint *out_ids,
+                global uint *out_counts,
+                uint num_queries,
+                uint num_leaves,
+                uint max_results,
+                float radius) {
+  const uint q = linear_global_id(num_queries);
+  if (q >= num_queries) return;
+
+  const float4 query = queries[q];
+  const float r2 = radius * radius;
+  global uint *ids = out_ids + q * max_results;
+  uint count = 0u;
+
+  int stack[STACK_SIZE];
+  uint sp = 0u;
+  stack[sp++] = root_ref(num_leaves);
+  while (sp > 0u) {
+    const int ref = stack[--sp];
+    if (is_leaf(ref)) {
+      const uint l = leaf_index(ref);
+      for (uint p = leaf_offsets[l]; p < leaf_offsets[l + 1u]; ++p) {
+        if (distance2(points[p], query) <= r2) {
+          if (count < max_results) {
+            ids[count] = point_ids[p];
+          }
+          ++count;
+        }
+      }
+      continue;
+    }
+
+    const int right = inner_nodes[ref].right;
+    const int left = inner_nodes[ref].left;
+    if (box_distance2(aabbs, aabb_slot(right, num_leaves), query) <= r2 &&
+        sp < STACK_SIZE) {
+      stack[sp++] = right;
+    }
+    if (box_distance2(aabbs, aabb_slot(left, num_leaves), query) <= r2 &&
+        sp < STACK_SIZE) {
+      stack[sp++] = left;
+    }
+  }
+  out_counts[q] = count;
+}
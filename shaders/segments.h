@@ -0,0 +1,28 @@
+// Problems packed back to back into one buffer, for the *_batched.cl kernels.
+// Not a kernel by itself, so compile_shaders.py skips it (.h).
+//
+// 'offsets' has 'num_segments + 1' entries: segment 's' is the elements
+// [offsets[s], offsets[s + 1]), and offsets[num_segments] is the total.
+
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+// The segment of element 'index' (< offsets[num_segments]), i.e. the last 's'
+// with offsets[s] <= index, so empty segments are skipped.
+inline uint find_segment(global const uint *offsets,
+                         uint num_segments,
+                         uint index) {
+  uint lo = 0u;
+  uint hi = num_segments;  // offsets[hi] > index
+  while (hi - lo > 1u) {
+    const uint mid = (lo + hi) >> 1;
+    if (offsets[mid] <= index) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+#endif  // SEGMENTS_H
@@ -0,0 +1,165 @@
+// Body of tmp_sort.comp and tmp_sort_histogram.comp, included after the
+// #version and #extension lines. Not a shader by itself, so
+// compile_shaders.py skips it (.h).
+//
+// Define FIRST_PASS_HISTOGRAM before including it to read the histogram of the
+// first pass from binding 2 instead of counting the keys.
+
+// Tunables are specialization constants, set from the host with
+// core::SpecConstants. Constant ID 0 is the workgroup size (threads_per_block).
+// Algorithm::set_variant() checks them: BITS_PER_ITERATION divides 32 and is
+// at most 8 (exactly 8 with FIRST_PASS_HISTOGRAM), SUBGROUP_SIZE <=
+// RADIX_SORT_BINS <= WORKGROUP_SIZE, and WORKGROUP_SIZE is a multiple of 32.
+layout(local_size_x = 256, local_size_x_id = 0) in;
+#define WORKGROUP_SIZE gl_WorkGroupSize.x
+
+layout(constant_id = 3) const uint BITS_PER_ITERATION = 8;
+layout(constant_id = 4) const uint SUBGROUP_SIZE = 64;  // 32 NVIDIA; 64 AMD
+const uint RADIX_SORT_BINS = 1u << BITS_PER_ITERATION;
+
+#define BITS 32  // sorting uint32_t
+#define ITERATIONS (BITS / BITS_PER_ITERATION)
+
+layout(push_constant, std430) uniform PushConstants { uint g_num_elements; };
+
+layout(std430, set = 0, binding = 0) buffer elements_in {
+  uint g_elements_in[];
+};
+
+layout(std430, set = 0, binding = 1) buffer elements_out {
+  uint g_elements_out[];
+};
+
+#ifdef FIRST_PASS_HISTOGRAM
+// Counts of the lowest digit, written by the encoder (RADIX_SORT_BINS uint)
+layout(std430, set = 0, binding = 2) readonly buffer first_histogram {
+  uint g_first_histogram[];
+};
+#endif
+
+shared uint[RADIX_SORT_BINS] histogram;
+shared uint[RADIX_SORT_BINS / SUBGROUP_SIZE] sums;  // subgroup reductions
+shared uint[RADIX_SORT_BINS] local_offsets;  // local exclusive scan (prefix
+                                             // sum) (inside subgroups)
+shared
+    uint[RADIX_SORT_BINS] global_offsets;  // global exclusive scan (prefix sum)
+
+struct BinFlags {
+  uint flags[WORKGROUP_SIZE / BITS];
+};
+shared BinFlags[RADIX_SORT_BINS] bin_flags;
+
+#define ELEMENT_IN(index, iteration) \
+  (iteration % 2 == 0 ? g_elements_in[index] : g_elements_out[index])
+
+void main() {
+  uint lID = gl_LocalInvocationID.x;
+  uint sID = gl_SubgroupID;
+  uint lsID = gl_SubgroupInvocationID;
+
+  for (uint iteration = 0; iteration < ITERATIONS; iteration++) {
+    uint shift = BITS_PER_ITERATION * iteration;
+
+    // initialize histogram
+#ifdef FIRST_PASS_HISTOGRAM
+    // The first pass was counted by the encoder
+    const bool count_keys = iteration != 0;
+    if (lID < RADIX_SORT_BINS) {
+      histogram[lID] = count_keys ? 0U : g_first_histogram[lID];
+    }
+#else
+    const bool count_keys = true;
+    if (lID < RADIX_SORT_BINS) {
+      histogram[lID] = 0U;
+    }
+#endif
+    barrier();
+
+    for (uint ID = lID; count_keys && ID < g_num_elements;
+         ID += WORKGROUP_SIZE) {
+      // determine the bin
+      const uint bin =
+          (ELEMENT_IN(ID, iteration) >> shift) & (RADIX_SORT_BINS - 1);
+      // increment the histogram
+      atomicAdd(histogram[bin], 1U);
+    }
+    barrier();
+
+    // subgroup reductions and subgroup prefix sums
+    if (lID < RADIX_SORT_BINS) {
+      uint histogram_count = histogram[lID];
+      uint sum = subgroupAdd(histogram_count);
+      uint prefix_sum = subgroupExclusiveAdd(histogram_count);
+      local_offsets[lID] = prefix_sum;
+      if (subgroupElect()) {
+        // one thread inside the warp/subgroup enters this section
+        sums[sID] = sum;
+      }
+    }
+    barrier();
+
+    // global prefix sums (offsets)
+    if (sID == 0) {
+      uint offset = 0;
+      for (uint i = lsID; i < RADIX_SORT_BINS; i += SUBGROUP_SIZE) {
+        global_offsets[i] = offset + local_offsets[i];
+        offset += sums[i / SUBGROUP_SIZE];
+      }
+    }
+    barrier();
+
+    //     ==== scatter keys according to global offsets =====
+    const uint flags_bin = lID / BITS;
+    const uint flags_bit = 1 << (lID % BITS);
+
+    for (uint blockID = 0; blockID < g_num_elements;
+         blockID += WORKGROUP_SIZE) {
+      barrier();
+
+      const uint ID = blockID + lID;
+
+      // initialize bin flags
+      if (lID < RADIX_SORT_BINS) {
+        for (int i = 0; i < WORKGROUP_SIZE / BITS; i++) {
+          bin_flags[lID].flags[i] = 0U;  // init all bin flags to 0
+        }
+      }
+      barrier();
+
+      uint element_in = 0;
+      uint binID = 0;
+      uint binOffset = 0;
+      if (ID < g_num_elements) {
+        element_in = ELEMENT_IN(ID, iteration);
+        binID = (element_in >> shift) & uint(RADIX_SORT_BINS - 1);
+        // offset for group
+        binOffset = global_offsets[binID];
+        // add bit to flag
+        atomicAdd(bin_flags[binID].flags[flags_bin], flags_bit);
+      }
+      barrier();
+
+      if (ID < g_num_elements) {
+        // calculate output index of element
+        uint prefix = 0;
+        uint count = 0;
+        for (uint i = 0; i < WORKGROUP_SIZE / BITS; i++) {
+          const uint bits = bin_flags[binID].flags[i];
+          const uint full_count = bitCount(bits);
+          const uint partial_count = bitCount(bits & (flags_bit - 1));
+          prefix += (i < flags_bin) ? full_count : 0U;
+          prefix += (i == flags_bin) ? partial_count : 0U;
+          count += full_count;
+        }
+        if (iteration % 2 == 0) {
+          g_elements_out[binOffset + prefix] = element_in;
+        } else {
+          g_elements_in[binOffset + prefix] = element_in;
+        }
+        if (prefix == count - 1) {
+          atomicAdd(global_offsets[binID], count);
+        }
+      }
+    }
+  }
+}
\ No newline at end of file
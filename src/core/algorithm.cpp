@@ -1,46 +1,78 @@
 #include "core/algorithm.hpp"
 
+#include <spirv_cross/spirv_cross.hpp>
+
 #include <cstdint>
+#include <string>
 
 #include "core/shader_loader.hpp"
 
-// For CLSPV generated shader, need to use specialization constants to pass
-// Must need 3 uint32 at constant ID 0, 1, 2. The value of them is the workgroup
-// size. i.e., the number of threads you want the shader to launch with.
-//
-// I am hard coding the first three specialized entry right now.
-[[nodiscard]] constexpr auto clspv_default_spec_const() {
-  std::array<vk::SpecializationMapEntry, 3> spec_const;
-  for (int i = 0; i < 3; ++i) {
-    spec_const[i] = vk::SpecializationMapEntry()
-                        .setConstantID(i)
-                        .setOffset(i * sizeof(uint32_t))
-                        .setSize(sizeof(uint32_t));
+namespace core {
+
+namespace {
+
+// tmp_sort.h sizes its shared arrays from the constants and cannot check
+// them itself, a bad combination would silently sort wrong
+void check_tmp_sort_variant(const std::string &spirv_filename,
+                            const uint32_t threads_per_block,
+                            const SpecConstants &spec_constants) {
+  const bool histogram = spirv_filename == "tmp_sort_histogram.spv";
+  if (!histogram && spirv_filename != "tmp_sort.spv") {
+    return;
+  }
+
+  // Constant ID 3 and 4, with the shader's defaults
+  const auto bits = spec_constants.get_or(3, 8u);
+  const auto subgroup_size = spec_constants.get_or(4, 64u);
+  if (bits == 0 || bits > 8 || 32 % bits != 0) {
+    throw std::invalid_argument(spirv_filename +
+                                ": BITS_PER_ITERATION must divide 32 and be "
+                                "at most 8, got " +
+                                std::to_string(bits));
+  }
+  if (histogram && bits != 8) {
+    throw std::invalid_argument(
+        spirv_filename +
+        ": the encoder's histogram has 256 bins, BITS_PER_ITERATION must be 8");
+  }
+
+  const auto bins = 1u << bits;
+  if (subgroup_size == 0 || subgroup_size > bins) {
+    throw std::invalid_argument(
+        spirv_filename + ": SUBGROUP_SIZE must be in [1, " +
+        std::to_string(bins) + "], got " + std::to_string(subgroup_size));
+  }
+  if (threads_per_block < bins || threads_per_block % 32 != 0) {
+    throw std::invalid_argument(
+        spirv_filename + ": the workgroup size must be a multiple of 32 and " +
+        "at least " + std::to_string(bins) + " (the bins), got " +
+        std::to_string(threads_per_block));
   }
-  return spec_const;
 }
 
-namespace core {
+}  // namespace
 
 Algorithm::Algorithm(std::shared_ptr<vk::Device> device_ptr,
+                     const vk::PipelineCache pipeline_cache,
                      const std::string_view spirv_filename,
                      const std::vector<std::shared_ptr<Buffer>> &buffers,
                      const uint32_t threads_per_block,
                      const bool is_clspv,
-                     const std::vector<float> &push_constants)
+                     const PushConstants &push_constants,
+                     const SpecConstants &spec_constants)
     : VulkanResource(std::move(device_ptr)),
       spirv_filename_(spirv_filename),
+      is_clspv_(is_clspv),
+      pipeline_cache_(pipeline_cache),
       threads_per_block_(threads_per_block),
+      spec_constants_(spec_constants),
+      base_spec_constants_(spec_constants),
       usm_buffers_(buffers),
-      is_clspv_(is_clspv) {
+      push_constants_(push_constants) {
   spdlog::info("YxAlgorithm ({}) initializing with number of buffers: {}",
                spirv_filename,
                buffers.size());
 
-  if (!push_constants.empty()) {
-    set_push_constants(push_constants);
-  }
-
   create_shader_module();
   create_parameters();
   create_pipeline();
@@ -49,40 +81,71 @@ Algorithm::Algorithm(std::shared_ptr<vk::Device> device_ptr,
 void Algorithm::destroy() {
   spdlog::debug("YxAlgorithm::destroy");
   device_ptr_->destroyShaderModule(handle_);
-  device_ptr_->destroyPipeline(pipeline_);
-  device_ptr_->destroyPipelineCache(pipeline_cache_);
+  for (const auto &[key, pipeline] : pipelines_) {
+    device_ptr_->destroyPipeline(pipeline);
+  }
+  pipelines_.clear();
+  pipeline_ = nullptr;
+  if (owns_pipeline_cache_) {
+    device_ptr_->destroyPipelineCache(pipeline_cache_);
+  }
+  pipeline_cache_ = nullptr;
   device_ptr_->destroyPipelineLayout(pipeline_layout_);
   device_ptr_->destroyDescriptorSetLayout(descriptor_set_layout_);
   device_ptr_->destroyDescriptorPool(descriptor_pool_);
-  free(push_constants_data_);
 }
 
-// vk::SpecializationInfo Algorithm::make_spec_info() const {
-//   auto info = vk::SpecializationInfo();
+void Algorithm::set_push_constants(const PushConstants &push_constants) {
+  if (push_constants.size() != push_constants_.size()) {
+    throw std::invalid_argument("Push constant size mismatch");
+  }
+  push_constants_ = push_constants;
+}
 
-//   if (is_clspv_) {
-//     const auto spec_map = clspv_default_spec_const();
-//     const std::array spec_map_content{threads_per_block_, 1u, 1u};
+void Algorithm::set_variant(const uint32_t threads_per_block,
+                            const SpecConstants &spec_constants) {
+  VKC_TRACE_SCOPE_N("pipeline", "Algorithm::set_variant", threads_per_block);
+  check_tmp_sort_variant(spirv_filename_, threads_per_block, spec_constants);
+  auto key = std::make_pair(threads_per_block, spec_constants);
+  auto it = pipelines_.find(key);
+  if (it == pipelines_.end()) {
+    spdlog::debug("YxAlgorithm::set_variant, compiling variant #{}",
+                  pipelines_.size());
+    const auto pipeline =
+        create_pipeline_variant(threads_per_block, spec_constants);
+    it = pipelines_.emplace(std::move(key), pipeline).first;
+  }
 
-//     info.setMapEntries(spec_map).setData<uint32_t>(spec_map_content);
-//   }
+  pipeline_ = it->second;
+  threads_per_block_ = threads_per_block;
+  spec_constants_ = spec_constants;
+}
 
-//   return info;
-// }
+void Algorithm::set_tuning_profile(
+    std::shared_ptr<const TuningProfile> profile) {
+  tuning_profile_ = std::move(profile);
+}
 
-void Algorithm::set_push_constants(const void *data,
-                                   const uint32_t size,
-                                   const uint32_t memory_size) {
-  const uint32_t total_size = size * memory_size;
+bool Algorithm::tune_for(const uint32_t n) {
+  if (!tuning_profile_) {
+    return false;
+  }
 
-  push_constants_data_ = malloc(total_size);
-  std::memcpy(push_constants_data_, data, total_size);
+  const auto entry = tuning_profile_->find(spirv_filename_, n);
+  if (!entry.has_value()) {
+    return false;
+  }
 
-  push_constants_data_type_memory_size_ = memory_size;
-  push_constants_size_ = size;
+  spdlog::debug("YxAlgorithm::tune_for({}), {} threads per block",
+                n,
+                entry->threads_per_block);
+  set_variant(entry->threads_per_block,
+              SpecConstants(base_spec_constants_).merge(entry->spec_constants));
+  return true;
 }
 
 void Algorithm::record_bind_core(const vk::CommandBuffer &cmd_buf) const {
+  VKC_TRACE_SCOPE("record", "Algorithm::record_bind_core");
   cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
   cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
                              pipeline_layout_,
@@ -92,23 +155,50 @@ void Algorithm::record_bind_core(const vk::CommandBuffer &cmd_buf) const {
 }
 
 void Algorithm::record_bind_push(const vk::CommandBuffer &cmd_buf) const {
-  spdlog::debug("YxAlgorithm::record_bind_push, constants memory size: {}",
-                push_constants_size_ * push_constants_data_type_memory_size_);
+  VKC_TRACE_SCOPE_N(
+      "record", "Algorithm::record_bind_push", push_constants_.size());
+
+  if (push_constants_.empty()) {
+    return;
+  }
 
-  cmd_buf.pushConstants(
-      pipeline_layout_,
-      vk::ShaderStageFlagBits::eCompute,
-      0,
-      push_constants_size_ * push_constants_data_type_memory_size_,
-      push_constants_data_);
+  cmd_buf.pushConstants(pipeline_layout_,
+                        vk::ShaderStageFlagBits::eCompute,
+                        0,
+                        push_constants_.size(),
+                        push_constants_.data());
+}
+
+WorkGroup Algorithm::num_blocks(const uint32_t data_size) const {
+  const auto blocks =
+      (uint64_t{data_size} + threads_per_block_ - 1u) / threads_per_block_;
+  if (blocks <= kMaxWorkGroupCount) {
+    return {static_cast<uint32_t>(blocks), 1u, 1u};
+  }
+
+  const auto rows = (blocks + kMaxWorkGroupCount - 1u) / kMaxWorkGroupCount;
+  if (rows > kMaxWorkGroupCount) {
+    throw std::runtime_error(spirv_filename_ + ": " +
+                             std::to_string(data_size) + " elements need " +
+                             std::to_string(blocks) +
+                             " workgroups, more than a dispatch can hold");
+  }
+  const auto columns = (blocks + rows - 1u) / rows;
+  return {static_cast<uint32_t>(columns), static_cast<uint32_t>(rows), 1u};
 }
 
 void Algorithm::record_dispatch_tmp(const vk::CommandBuffer &cmd_buf,
                                     const uint32_t data_size) const {
-  const auto num_blocks =
-      (data_size + threads_per_block_ - 1u) / threads_per_block_;
-  spdlog::info("YxAlgorithm::record_dispatch_tmp, num_blocks: {}", num_blocks);
-  cmd_buf.dispatch(num_blocks, 1u, 1u);
+  const auto [x, y, z] = num_blocks(data_size);
+  VKC_TRACE_SCOPE_N("record", "Algorithm::record_dispatch_tmp", x * y);
+  cmd_buf.dispatch(x, y, z);
+}
+
+void Algorithm::record_dispatch_indirect(const vk::CommandBuffer &cmd_buf,
+                                         const Buffer &indirect_buf,
+                                         const vk::DeviceSize offset) const {
+  VKC_TRACE_SCOPE("record", "Algorithm::record_dispatch_indirect");
+  cmd_buf.dispatchIndirect(indirect_buf.get_handle(), offset);
 }
 
 void Algorithm::create_parameters() {
@@ -169,61 +259,165 @@ void Algorithm::create_pipeline() {
   const auto push_const = vk::PushConstantRange()
                               .setStageFlags(vk::ShaderStageFlagBits::eCompute)
                               .setOffset(0)
-                              .setSize(push_constants_data_type_memory_size_ *
-                                       push_constants_size_);
+                              .setSize(push_constants_.size());
 
   // Pipeline layout (2/3)
-  const auto layout_create_info = vk::PipelineLayoutCreateInfo()
-                                      .setSetLayoutCount(1)
-                                      .setSetLayouts(descriptor_set_layout_)
-                                      .setPushConstantRangeCount(1)
-                                      .setPushConstantRanges(push_const);
+  auto layout_create_info = vk::PipelineLayoutCreateInfo()
+                                .setSetLayoutCount(1)
+                                .setSetLayouts(descriptor_set_layout_);
+  if (!push_constants_.empty()) {
+    layout_create_info.setPushConstantRangeCount(1).setPushConstantRanges(
+        push_const);
+  }
 
   pipeline_layout_ = device_ptr_->createPipelineLayout(layout_create_info);
 
-  // Pipeline cache (2.5/3)
-  constexpr auto pipeline_cache_info = vk::PipelineCacheCreateInfo();
-  pipeline_cache_ = device_ptr_->createPipelineCache(pipeline_cache_info);
+  // Pipeline cache (2.5/3), the engine's one if given, so pipelines built by
+  // ComputeEngine::warm_up_pipelines() are reused.
+  if (!pipeline_cache_) {
+    constexpr auto pipeline_cache_info = vk::PipelineCacheCreateInfo();
+    pipeline_cache_ = device_ptr_->createPipelineCache(pipeline_cache_info);
+    owns_pipeline_cache_ = true;
+  }
 
-  // Specialization info (2.75/3) telling the shader the workgroup size
+  // Pipeline itself (3/3), the initial variant
+  set_variant(threads_per_block_, spec_constants_);
+}
+
+vk::Pipeline Algorithm::create_pipeline_variant(
+    const uint32_t threads_per_block,
+    const SpecConstants &spec_constants,
+    const vk::PipelineCreateFlags flags) const {
+  // Specialization info telling the shader the workgroup size (constant ID 0,
+  // 1, 2), followed by the user's constants. GLSL shaders can pick up the
+  // workgroup size with 'layout(local_size_x_id = 0) in;'.
   if (is_clspv_) {
     spdlog::debug("YxAlgorithm::create_pipeline, is CLSPV shader");
-
   } else {
     spdlog::debug("YxAlgorithm::create_pipeline, is not CLSPV shader");
   }
 
-  const auto spec_map = clspv_default_spec_const();
-  const std::array spec_map_content{threads_per_block_, 1u, 1u};
-  const auto spec_info =
-      vk::SpecializationInfo().setMapEntries(spec_map).setData<uint32_t>(
-          spec_map_content);
-
-  // const auto spec_info = make_spec_info();
+  std::vector<vk::SpecializationMapEntry> spec_map;
+  std::vector<uint32_t> spec_map_content;
+  const auto spec_info = spec_constants.make_spec_info(
+      threads_per_block, spec_map, spec_map_content);
 
   const auto p_name = is_clspv_ ? "foo" : "main";
 
-  // Pipeline itself (3/3)
-  auto shader_stage_create_info =
+  const auto shader_stage_create_info =
       vk::PipelineShaderStageCreateInfo()
           .setStage(vk::ShaderStageFlagBits::eCompute)
           .setModule(handle_)
-          .setPName(p_name);
-
-  if (is_clspv_) {
-    shader_stage_create_info.setPSpecializationInfo(&spec_info);
-  }
+          .setPName(p_name)
+          .setPSpecializationInfo(&spec_info);
 
   const auto create_info = vk::ComputePipelineCreateInfo()
+                               .setFlags(flags)
                                .setStage(shader_stage_create_info)
                                .setLayout(pipeline_layout_);
 
-  pipeline_ =
-      device_ptr_->createComputePipeline(pipeline_cache_, create_info).value;
+  // A cached pipeline may come without what the flags ask for
+  const auto cache = flags ? vk::PipelineCache{} : pipeline_cache_;
+  return device_ptr_->createComputePipeline(cache, create_info).value;
+}
+
+std::vector<PipelineExecutableStats> Algorithm::capture_statistics(
+    const vk::DispatchLoaderDynamic &dld) const {
+  VKC_TRACE_SCOPE("pipeline", "Algorithm::capture_statistics");
+  const auto pipeline = create_pipeline_variant(
+      threads_per_block_,
+      spec_constants_,
+      vk::PipelineCreateFlagBits::eCaptureStatisticsKHR);
+
+  std::vector<PipelineExecutableStats> executables;
+  try {
+    const auto properties = device_ptr_->getPipelineExecutablePropertiesKHR(
+        vk::PipelineInfoKHR().setPipeline(pipeline), dld);
+
+    for (auto i = 0u; i < properties.size(); ++i) {
+      PipelineExecutableStats stats{
+          .name = properties[i].name,
+          .description = properties[i].description,
+          .subgroup_size = properties[i].subgroupSize,
+      };
+
+      const auto statistics =
+          device_ptr_->getPipelineExecutableStatisticsKHR(
+              vk::PipelineExecutableInfoKHR()
+                  .setPipeline(pipeline)
+                  .setExecutableIndex(i),
+              dld);
+      for (const auto &statistic : statistics) {
+        double value = 0.0;
+        switch (statistic.format) {
+          case vk::PipelineExecutableStatisticFormatKHR::eBool32:
+            value = statistic.value.b32;
+            break;
+          case vk::PipelineExecutableStatisticFormatKHR::eInt64:
+            value = static_cast<double>(statistic.value.i64);
+            break;
+          case vk::PipelineExecutableStatisticFormatKHR::eUint64:
+            value = static_cast<double>(statistic.value.u64);
+            break;
+          case vk::PipelineExecutableStatisticFormatKHR::eFloat64:
+            value = statistic.value.f64;
+            break;
+        }
+        stats.statistics.push_back({
+            .name = statistic.name,
+            .description = statistic.description,
+            .value = value,
+        });
+      }
+
+      summarize_statistics(stats);
+      executables.push_back(std::move(stats));
+    }
+  } catch (...) {
+    device_ptr_->destroyPipeline(pipeline);
+    throw;
+  }
+
+  device_ptr_->destroyPipeline(pipeline);
+  return executables;
+}
+
+void Algorithm::validate_push_constants(
+    const std::vector<uint32_t> &spirv_binary) {
+  const spirv_cross::Compiler compiler(spirv_binary);
+  const auto resources = compiler.get_shader_resources();
+
+  uint32_t shader_size = 0;
+  for (const auto &block : resources.push_constant_buffers) {
+    const auto &type = compiler.get_type(block.base_type_id);
+    shader_size =
+        static_cast<uint32_t>(compiler.get_declared_struct_size(type));
+  }
+
+  spdlog::debug("YxAlgorithm::validate_push_constants, shader: {}, user: {}",
+                shader_size,
+                push_constants_.size());
+
+  // A CLSPV kernel without POD arguments may still reserve the global offset,
+  // which is all zeros.
+  if (is_clspv_ && push_constants_.empty() && shader_size > 0) {
+    push_constants_.set(std::array<uint32_t, 4>{});
+  }
+
+  // The user may pass a bigger block than the shader uses (e.g. trailing
+  // arguments the compiler optimized away), but never a smaller one.
+  if (push_constants_.size() < shader_size) {
+    throw std::runtime_error(
+        "Push constants of " + spirv_filename_ + " expect " +
+        std::to_string(shader_size) + " bytes, but " +
+        std::to_string(push_constants_.size()) + " bytes were given");
+  }
 }
 
 void Algorithm::create_shader_module() {
-  const auto spirv_binary = load_shader_from_file(spirv_filename_);
+  VKC_TRACE_SCOPE("pipeline", "Algorithm::create_shader_module");
+  const auto spirv_binary = load_shader(spirv_filename_);
+  validate_push_constants(spirv_binary);
   const auto create_info = vk::ShaderModuleCreateInfo().setCode(spirv_binary);
   handle_ = device_ptr_->createShaderModule(create_info);
 }
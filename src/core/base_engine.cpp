@@ -1,38 +1,76 @@
 #include "core/base_engine.hpp"
 
+#include <algorithm>
 #include <iostream>
-
-#include "core/vma_usage.hpp"
+#include <string>
+#include <string_view>
 
 namespace core {
 
-BaseEngine::BaseEngine() {
+BaseEngine::BaseEngine(const EngineConfig &config) {
   try {
-    device_initialization();
+    device_initialization(config);
     get_queues();
+    query_optional_extensions();
     vma_initialization();
+    pipeline_cache_initialization();
   } catch (std::exception &e) {
     std::cout << e.what() << std::endl;
     exit(EXIT_FAILURE);
   }
 }
 
-void BaseEngine::destroy() const {
-  if (g_allocator != VK_NULL_HANDLE) {
-    vmaDestroyAllocator(g_allocator);
+void BaseEngine::destroy() {
+  if (pipeline_cache_) {
+    vk::Device(device_.device).destroyPipelineCache(pipeline_cache_);
+    pipeline_cache_ = nullptr;
+  }
+  if (allocator_ != VK_NULL_HANDLE) {
+    vmaDestroyAllocator(allocator_);
+    allocator_ = VK_NULL_HANDLE;
   }
   destroy_device(device_);
   destroy_instance(instance_);
 }
 
-void BaseEngine::device_initialization() {
+namespace {
+
+// What DeviceFeatures::subgroup_ops stands for
+constexpr auto kSubgroupOps = vk::SubgroupFeatureFlagBits::eBasic |
+                              vk::SubgroupFeatureFlagBits::eVote |
+                              vk::SubgroupFeatureFlagBits::eArithmetic |
+                              vk::SubgroupFeatureFlagBits::eBallot |
+                              vk::SubgroupFeatureFlagBits::eShuffle;
+
+void check_required(const bool required,
+                    const bool supported,
+                    const std::string_view name) {
+  if (required && !supported) {
+    throw std::runtime_error("The selected device does not support " +
+                             std::string(name));
+  }
+}
+
+bool supports_extension(const vk::PhysicalDevice physical_device,
+                        const std::string_view name) {
+  const auto extensions = physical_device.enumerateDeviceExtensionProperties();
+  return std::ranges::any_of(
+      extensions, [name](const vk::ExtensionProperties &ext) {
+        return std::string_view(ext.extensionName) == name;
+      });
+}
+
+}  // namespace
+
+void BaseEngine::device_initialization(const EngineConfig &config) {
   // Vulkan instance creation (1/3)
   vkb::InstanceBuilder instance_builder;
-  auto inst_ret = instance_builder.set_app_name("Example Vulkan Application")
-                      .request_validation_layers()
-                      .use_default_debug_messenger()
-                      .require_api_version(1, 3, 0)
-                      .build();
+  instance_builder.set_app_name(config.app_name.c_str())
+      .require_api_version(1, 3, 0);
+  if (config.enable_validation) {
+    instance_builder.request_validation_layers().use_default_debug_messenger();
+  }
+  auto inst_ret = instance_builder.build();
   if (!inst_ret) {
     std::cerr << "Failed to create Vulkan instance. Error: "
               << inst_ret.error().message() << "\n";
@@ -40,16 +78,24 @@ void BaseEngine::device_initialization() {
   }
 
   instance_ = inst_ret.value();
+  spdlog::info("Validation layers {}",
+               config.enable_validation ? "requested" : "off");
 
   // Vulkan pick physical device (2/3)
   vkb::PhysicalDeviceSelector selector{instance_};
-  auto phys_ret =
-      selector.defer_surface_initialization()
-          .set_minimum_version(1, 2)
-          .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
-          //.prefer_gpu_device_type(vkb::PreferredDeviceType::integrated)
-          .allow_any_gpu_device_type(false)
-          .select();
+  selector.defer_surface_initialization()
+      .set_minimum_version(1, 2)
+      .prefer_gpu_device_type(config.device_type)
+      .allow_any_gpu_device_type(config.allow_other_device_types)
+      .add_desired_extension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)
+      .add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  for (const auto &extension : config.required_extensions) {
+    selector.add_required_extension(extension.c_str());
+  }
+  for (const auto &extension : config.desired_extensions) {
+    selector.add_desired_extension(extension.c_str());
+  }
+  auto phys_ret = selector.select();
 
   if (!phys_ret) {
     std::cerr << "Failed to select Vulkan Physical Device. Error: "
@@ -59,8 +105,133 @@ void BaseEngine::device_initialization() {
 
   spdlog::info("selected GPU: {}", phys_ret.value().properties.deviceName);
 
+  // What the device supports, out of the optional features
+  const vk::PhysicalDevice physical_device(phys_ret.value().physical_device);
+  const auto supported =
+      physical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                   vk::PhysicalDeviceVulkan11Features,
+                                   vk::PhysicalDeviceVulkan12Features>();
+  const auto &supported_11 =
+      supported.get<vk::PhysicalDeviceVulkan11Features>();
+  const auto &supported_12 =
+      supported.get<vk::PhysicalDeviceVulkan12Features>();
+  const auto properties =
+      physical_device.getProperties2<vk::PhysicalDeviceProperties2,
+                                     vk::PhysicalDeviceSubgroupProperties>();
+  const auto &subgroup = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+  subgroup_size_ = subgroup.subgroupSize;
+
+  // An extension's features can only be queried if the device has it
+  bool executable_info = false;
+  constexpr auto kExecutableProperties =
+      VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME;
+  if (supports_extension(physical_device, kExecutableProperties)) {
+    executable_info =
+        physical_device
+            .getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDevicePipelineExecutablePropertiesFeaturesKHR>()
+            .get<vk::PhysicalDevicePipelineExecutablePropertiesFeaturesKHR>()
+            .pipelineExecutableInfo == VK_TRUE;
+  }
+
+  const DeviceFeatures available{
+      .storage_buffer_16bit = supported_11.storageBuffer16BitAccess == VK_TRUE,
+      .subgroup_ops =
+          (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) &&
+          (subgroup.supportedOperations & kSubgroupOps) == kSubgroupOps,
+      .buffer_device_address = supported_12.bufferDeviceAddress == VK_TRUE,
+      .timeline_semaphores = supported_12.timelineSemaphore == VK_TRUE,
+      .pipeline_statistics_query =
+          supported.get<vk::PhysicalDeviceFeatures2>()
+              .features.pipelineStatisticsQuery == VK_TRUE,
+      .pipeline_executable_info = executable_info,
+      .shader_int64 =
+          supported.get<vk::PhysicalDeviceFeatures2>().features.shaderInt64 ==
+          VK_TRUE,
+  };
+
+  const auto &required = config.required_features;
+  check_required(required.storage_buffer_16bit,
+                 available.storage_buffer_16bit,
+                 "16-bit storage");
+  check_required(
+      required.subgroup_ops, available.subgroup_ops, "subgroup operations");
+  check_required(required.buffer_device_address,
+                 available.buffer_device_address,
+                 "buffer device address");
+  check_required(required.timeline_semaphores,
+                 available.timeline_semaphores,
+                 "timeline semaphores");
+  check_required(required.pipeline_statistics_query,
+                 available.pipeline_statistics_query,
+                 "pipeline statistics queries");
+  check_required(required.pipeline_executable_info,
+                 available.pipeline_executable_info,
+                 "pipeline executable properties");
+  check_required(
+      required.shader_int64, available.shader_int64, "64-bit shader integers");
+
+  // Required or desired, and supported
+  const auto &desired = config.desired_features;
+  const auto wanted = [](const bool required,
+                         const bool desired,
+                         const bool available) {
+    return (required || desired) && available;
+  };
+  features_ = DeviceFeatures{
+      .storage_buffer_16bit = wanted(required.storage_buffer_16bit,
+                                     desired.storage_buffer_16bit,
+                                     available.storage_buffer_16bit),
+      // Nothing to enable, always reported
+      .subgroup_ops = available.subgroup_ops,
+      .buffer_device_address = wanted(required.buffer_device_address,
+                                      desired.buffer_device_address,
+                                      available.buffer_device_address),
+      .timeline_semaphores = wanted(required.timeline_semaphores,
+                                    desired.timeline_semaphores,
+                                    available.timeline_semaphores),
+      .pipeline_statistics_query = wanted(required.pipeline_statistics_query,
+                                          desired.pipeline_statistics_query,
+                                          available.pipeline_statistics_query),
+      .pipeline_executable_info = wanted(required.pipeline_executable_info,
+                                         desired.pipeline_executable_info,
+                                         available.pipeline_executable_info),
+      .shader_int64 = wanted(required.shader_int64,
+                             desired.shader_int64,
+                             available.shader_int64),
+  };
+
   // Vulkan logical device creation (3/3)
-  vkb::DeviceBuilder device_builder{phys_ret.value()};
+  auto features_11 = vk::PhysicalDeviceVulkan11Features()
+                         .setStorageBuffer16BitAccess(
+                             features_.storage_buffer_16bit);
+  auto features_12 =
+      vk::PhysicalDeviceVulkan12Features()
+          .setBufferDeviceAddress(features_.buffer_device_address)
+          .setTimelineSemaphore(features_.timeline_semaphores);
+
+  auto features_executable =
+      vk::PhysicalDevicePipelineExecutablePropertiesFeaturesKHR()
+          .setPipelineExecutableInfo(VK_TRUE);
+
+  auto selected = phys_ret.value();
+  if (features_.pipeline_statistics_query || features_.shader_int64) {
+    VkPhysicalDeviceFeatures core_features{};
+    core_features.pipelineStatisticsQuery =
+        features_.pipeline_statistics_query ? VK_TRUE : VK_FALSE;
+    core_features.shaderInt64 = features_.shader_int64 ? VK_TRUE : VK_FALSE;
+    selected.enable_features_if_present(core_features);
+  }
+  if (features_.pipeline_executable_info) {
+    selected.enable_extension_if_present(kExecutableProperties);
+  }
+
+  vkb::DeviceBuilder device_builder{selected};
+  device_builder.add_pNext(&features_11).add_pNext(&features_12);
+  if (features_.pipeline_executable_info) {
+    device_builder.add_pNext(&features_executable);
+  }
   auto dev_ret = device_builder.build();
   if (!dev_ret) {
     std::cerr << "Failed to create Vulkan device. Error: "
@@ -69,6 +240,25 @@ void BaseEngine::device_initialization() {
   }
 
   device_ = dev_ret.value();
+  log_features();
+}
+
+void BaseEngine::log_features() const {
+  const auto state = [](const bool enabled) {
+    return enabled ? "enabled" : "off";
+  };
+  spdlog::info("16-bit storage {}", state(features_.storage_buffer_16bit));
+  spdlog::info("Subgroup operations {} (subgroup size {})",
+               state(features_.subgroup_ops),
+               subgroup_size_);
+  spdlog::info("Buffer device address {}",
+               state(features_.buffer_device_address));
+  spdlog::info("Timeline semaphores {}", state(features_.timeline_semaphores));
+  spdlog::info("Pipeline statistics queries {}",
+               state(features_.pipeline_statistics_query));
+  spdlog::info("Pipeline executable properties {}",
+               state(features_.pipeline_executable_info));
+  spdlog::info("64-bit shader integers {}", state(features_.shader_int64));
 }
 
 void BaseEngine::get_queues() {
@@ -79,17 +269,55 @@ void BaseEngine::get_queues() {
   queue_ = q_ret.value();
 }
 
-void BaseEngine::vma_initialization() const {
-  if (g_allocator != VK_NULL_HANDLE) {
+bool BaseEngine::has_device_extension(const std::string_view name) const {
+  // The extensions the device was created with, not all it supports
+  const auto enabled = device_.physical_device.get_extensions();
+  return std::ranges::find(enabled, name) != enabled.end();
+}
+
+void BaseEngine::query_optional_extensions() {
+  has_memory_budget_ =
+      has_device_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  spdlog::info("VK_EXT_memory_budget {}",
+               has_memory_budget_ ? "enabled" : "not supported");
+
+  if (!has_device_extension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+    spdlog::info("VK_EXT_external_memory_host not supported");
     return;
   }
 
+  const vk::PhysicalDevice physical_device(device_.physical_device);
+  const auto properties = physical_device.getProperties2<
+      vk::PhysicalDeviceProperties2,
+      vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
+  external_memory_host_alignment_ =
+      properties.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>()
+          .minImportedHostPointerAlignment;
+
+  spdlog::info("VK_EXT_external_memory_host enabled, alignment: {}",
+               external_memory_host_alignment_);
+}
+
+void BaseEngine::vma_initialization() {
   const VmaAllocatorCreateInfo allocator_create_info{
+      .flags = (has_memory_budget_
+                    ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT
+                    : VmaAllocatorCreateFlags{0}) |
+               (features_.buffer_device_address
+                    ? VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT
+                    : VmaAllocatorCreateFlags{0}),
       .physicalDevice = device_.physical_device,
       .device = device_.device,
       .instance = instance_.instance,
+      .vulkanApiVersion = VK_API_VERSION_1_2,
   };
 
-  vmaCreateAllocator(&allocator_create_info, &g_allocator);
+  vmaCreateAllocator(&allocator_create_info, &allocator_);
+}
+
+void BaseEngine::pipeline_cache_initialization() {
+  constexpr auto pipeline_cache_info = vk::PipelineCacheCreateInfo();
+  pipeline_cache_ =
+      vk::Device(device_.device).createPipelineCache(pipeline_cache_info);
 }
 }  // namespace core
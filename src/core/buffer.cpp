@@ -3,13 +3,16 @@
 namespace core {
 
 Buffer::Buffer(std::shared_ptr<vk::Device> device_ptr,
+               const VmaAllocator allocator,
                const vk::DeviceSize size,
                const vk::BufferUsageFlags buffer_usage,
                const VmaMemoryUsage memory_usage,
                const VmaAllocationCreateFlags flags)
     : VulkanResource(std::move(device_ptr)),
+      allocator_(allocator),
       size_(size),
       persistent_{(flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0} {
+  VKC_TRACE_SCOPE_N("alloc", "Buffer::Buffer", size);
   const auto buffer_create_info =
       vk::BufferCreateInfo().setSize(size).setUsage(buffer_usage);
 
@@ -21,7 +24,7 @@ Buffer::Buffer(std::shared_ptr<vk::Device> device_ptr,
   VmaAllocationInfo allocation_info{};
 
   if (const auto result = vmaCreateBuffer(
-          g_allocator,
+          allocator_,
           reinterpret_cast<const VkBufferCreateInfo *>(&buffer_create_info),
           &memory_info,
           reinterpret_cast<VkBuffer *>(&get_handle()),
@@ -44,6 +47,23 @@ Buffer::Buffer(std::shared_ptr<vk::Device> device_ptr,
   }
 }
 
+Buffer::Buffer(std::shared_ptr<vk::Device> device_ptr,
+               const vk::Buffer buffer,
+               const vk::DeviceMemory memory,
+               const vk::DeviceSize size,
+               std::byte *mapped_data,
+               std::shared_ptr<const void> keep_alive,
+               const bool owns_memory)
+    : VulkanResource(std::move(device_ptr)),
+      memory_(memory),
+      size_(size),
+      mapped_data_(mapped_data),
+      keep_alive_(std::move(keep_alive)),
+      owns_memory_(owns_memory) {
+  get_handle() = buffer;
+  spdlog::debug("Buffer::Buffer (adopted), size: {}", size);
+}
+
 vk::DescriptorBufferInfo Buffer::construct_descriptor_buffer_info() const {
   return vk::DescriptorBufferInfo()
       .setBuffer(get_handle())
@@ -51,10 +71,175 @@ vk::DescriptorBufferInfo Buffer::construct_descriptor_buffer_info() const {
       .setRange(size_);
 }
 
+void Buffer::flush(const vk::DeviceSize size,
+                   const vk::DeviceSize offset) const {
+  if (allocation_ == VK_NULL_HANDLE) {
+    return;
+  }
+  vmaFlushAllocation(allocator_, allocation_, offset, size);
+}
+
+void Buffer::invalidate(const vk::DeviceSize size,
+                        const vk::DeviceSize offset) const {
+  if (allocation_ == VK_NULL_HANDLE) {
+    return;
+  }
+  vmaInvalidateAllocation(allocator_, allocation_, offset, size);
+}
+
+vk::DeviceSize Buffer::flush_dirty() {
+  if (staging_) {
+    // The staging buffer has the same layout, so it just inherits the ranges
+    staging_->dirty_ = dirty_;
+    return staging_->flush_dirty();
+  }
+
+  if (dirty_.empty()) {
+    return 0;
+  }
+  if (allocation_ == VK_NULL_HANDLE) {
+    dirty_.clear();
+    return 0;
+  }
+
+  VkMemoryPropertyFlags memory_flags = 0;
+  vmaGetAllocationMemoryProperties(allocator_, allocation_, &memory_flags);
+  if (memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+    dirty_.clear();
+    return 0;
+  }
+
+  const VkPhysicalDeviceProperties *properties = nullptr;
+  vmaGetPhysicalDeviceProperties(allocator_, &properties);
+  const auto ranges =
+      dirty_.aligned(properties->limits.nonCoherentAtomSize, size_);
+
+  VKC_TRACE_SCOPE_N("transfer", "Buffer::flush_dirty", ranges.size());
+
+  // One call for all ranges
+  std::vector<VmaAllocation> allocations(ranges.size(), allocation_);
+  std::vector<VkDeviceSize> offsets;
+  std::vector<VkDeviceSize> sizes;
+  offsets.reserve(ranges.size());
+  sizes.reserve(ranges.size());
+  vk::DeviceSize bytes = 0;
+  for (const auto &range : ranges) {
+    offsets.push_back(range.begin);
+    sizes.push_back(range.size());
+    bytes += range.size();
+  }
+  vmaFlushAllocations(allocator_,
+                      static_cast<uint32_t>(ranges.size()),
+                      allocations.data(),
+                      offsets.data(),
+                      sizes.data());
+
+  dirty_.clear();
+  return bytes;
+}
+
+vk::DeviceSize Buffer::record_upload(const vk::CommandBuffer &cmd_buf) {
+  if (!staging_) {
+    flush_dirty();
+    return 0;
+  }
+  if (dirty_.empty()) {
+    return 0;
+  }
+
+  VKC_TRACE_SCOPE_N("record", "Buffer::record_upload", dirty_.size());
+
+  std::vector<vk::BufferCopy> regions;
+  regions.reserve(dirty_.size());
+  vk::DeviceSize bytes = 0;
+  for (const auto &range : dirty_.aligned(1, size_)) {
+    regions.emplace_back(range.begin, range.begin, range.size());
+    bytes += range.size();
+  }
+
+  // Host writes to the staging memory become visible at submission
+  flush_dirty();
+
+  // Earlier dispatches of the command buffer may still use the buffer
+  const auto before = vk::BufferMemoryBarrier()
+                          .setSrcAccessMask(vk::AccessFlagBits::eShaderRead |
+                                            vk::AccessFlagBits::eShaderWrite)
+                          .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+                          .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                          .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                          .setBuffer(get_handle())
+                          .setOffset(0)
+                          .setSize(VK_WHOLE_SIZE);
+  cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                          vk::PipelineStageFlagBits::eTransfer,
+                          {},
+                          nullptr,
+                          before,
+                          nullptr);
+
+  cmd_buf.copyBuffer(staging_->get_handle(), get_handle(), regions);
+
+  const auto after = vk::BufferMemoryBarrier()
+                         .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                         .setDstAccessMask(vk::AccessFlagBits::eShaderRead |
+                                           vk::AccessFlagBits::eShaderWrite)
+                         .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                         .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                         .setBuffer(get_handle())
+                         .setOffset(0)
+                         .setSize(VK_WHOLE_SIZE);
+  cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                          vk::PipelineStageFlagBits::eComputeShader,
+                          {},
+                          nullptr,
+                          after,
+                          nullptr);
+
+  dirty_.clear();
+  return bytes;
+}
+
+void Buffer::set_staging(std::unique_ptr<Buffer> staging) {
+  if (staging && (staging->size_ < size_ || !staging->mapped_data_)) {
+    throw std::invalid_argument("Staging buffer must be mapped and as big");
+  }
+  staging_ = std::move(staging);
+}
+
+void Buffer::set_memory_tracker(std::shared_ptr<MemoryTracker> tracker,
+                                const BufferClass buffer_class) {
+  memory_tracker_ = std::move(tracker);
+  buffer_class_ = buffer_class;
+  memory_tracker_->on_allocate(buffer_class_, size_);
+}
+
 void Buffer::destroy() {
-  if (get_handle() && allocation_ != VK_NULL_HANDLE) {
-    vmaDestroyBuffer(g_allocator, get_handle(), allocation_);
+  if (!get_handle()) {
+    return;
   }
+
+  if (memory_tracker_) {
+    memory_tracker_->on_free(buffer_class_, size_);
+    memory_tracker_.reset();
+  }
+
+  if (allocation_ != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(allocator_, get_handle(), allocation_);
+  } else {
+    device_ptr_->destroyBuffer(get_handle());
+    if (owns_memory_) {
+      device_ptr_->freeMemory(memory_);
+    }
+  }
+
+  // destroy() can be called by both the engine and the destructor
+  get_handle() = nullptr;
+  allocation_ = VK_NULL_HANDLE;
+  memory_ = nullptr;
+  mapped_data_ = nullptr;
+  keep_alive_.reset();
+  staging_.reset();
+  dirty_.clear();
 }
 
 }  // namespace core
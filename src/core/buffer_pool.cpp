@@ -0,0 +1,153 @@
+#include "core/buffer_pool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+namespace core {
+
+vk::DeviceSize BufferPool::class_size(const vk::DeviceSize size) const {
+  std::lock_guard lock(mutex_);
+  return std::max(policy_.min_class_size, std::bit_ceil(size));
+}
+
+std::shared_ptr<Buffer> BufferPool::acquire(const vk::DeviceSize size,
+                                            const vk::BufferUsageFlags usage) {
+  VKC_TRACE_SCOPE_N("alloc", "BufferPool::acquire", size);
+
+  const auto key =
+      ClassKey{class_size(size), static_cast<VkBufferUsageFlags>(usage)};
+
+  std::unique_ptr<Buffer> buffer;
+  {
+    std::lock_guard lock(mutex_);
+    if (auto it = free_lists_.find(key);
+        it != free_lists_.end() && !it->second.empty()) {
+      // Most recently released first, it is the most likely to be cached
+      auto idle = it->second.back();
+      it->second.pop_back();
+      buffer = std::move(idle->buffer);
+      idle_.erase(idle);
+
+      ++stats_.hits;
+      --stats_.idle_buffers;
+      stats_.idle_bytes -= key.first;
+    } else {
+      ++stats_.misses;
+    }
+  }
+
+  if (!buffer) {
+    buffer = allocate_(key.first, usage);
+  }
+
+  return {buffer.release(),
+          [weak_pool = weak_from_this(), usage](Buffer *b) {
+            if (const auto pool = weak_pool.lock()) {
+              pool->release(b, usage);
+            } else {
+              delete b;
+            }
+          }};
+}
+
+void BufferPool::release(Buffer *buffer, const vk::BufferUsageFlags usage) {
+  std::unique_ptr<Buffer> owned(buffer);
+
+  // Freed outside of the lock
+  std::vector<std::unique_ptr<Buffer>> evicted;
+  std::lock_guard lock(mutex_);
+
+  // Already destroyed by the engine, or nothing to recycle into
+  if (closed_ || !owned->get_handle()) {
+    evicted.push_back(std::move(owned));
+    return;
+  }
+
+  const auto key = ClassKey{owned->get_size(),
+                            static_cast<VkBufferUsageFlags>(usage)};
+  ++stats_.releases;
+  ++stats_.idle_buffers;
+  stats_.idle_bytes += key.first;
+
+  auto &free_list = free_lists_[key];
+  free_list.push_back(
+      idle_.emplace(idle_.end(), IdleBuffer{key, std::move(owned)}));
+
+  // Per class limit, the oldest of the class goes first
+  while (free_list.size() > policy_.max_idle_per_class) {
+    const auto oldest = free_list.front();
+    free_list.erase(free_list.begin());
+    ++stats_.evictions;
+    stats_.evicted_bytes += key.first;
+    --stats_.idle_buffers;
+    stats_.idle_bytes -= key.first;
+    evicted.push_back(std::move(oldest->buffer));
+    idle_.erase(oldest);
+  }
+
+  auto over_budget = evict_locked(policy_.max_idle_bytes);
+  std::ranges::move(over_budget, std::back_inserter(evicted));
+}
+
+std::vector<std::unique_ptr<Buffer>> BufferPool::evict_locked(
+    const vk::DeviceSize max_idle_bytes) {
+  std::vector<std::unique_ptr<Buffer>> evicted;
+  while (stats_.idle_bytes > max_idle_bytes && !idle_.empty()) {
+    const auto oldest = idle_.begin();
+    const auto bytes = oldest->key.first;
+
+    // It is also the oldest of its class, i.e. the front of its free list
+    auto &free_list = free_lists_[oldest->key];
+    free_list.erase(std::ranges::find(free_list, oldest));
+
+    ++stats_.evictions;
+    stats_.evicted_bytes += bytes;
+    --stats_.idle_buffers;
+    stats_.idle_bytes -= bytes;
+    evicted.push_back(std::move(oldest->buffer));
+    idle_.erase(oldest);
+  }
+  return evicted;
+}
+
+vk::DeviceSize BufferPool::trim(const vk::DeviceSize max_idle_bytes) {
+  std::vector<std::unique_ptr<Buffer>> evicted;
+  vk::DeviceSize freed = 0;
+  {
+    std::lock_guard lock(mutex_);
+    const auto before = stats_.idle_bytes;
+    evicted = evict_locked(max_idle_bytes);
+    freed = before - stats_.idle_bytes;
+  }
+  if (freed > 0) {
+    spdlog::debug("BufferPool::trim, freed {} buffers ({} bytes)",
+                  evicted.size(),
+                  freed);
+  }
+  return freed;
+}
+
+void BufferPool::set_policy(const BufferPoolPolicy &policy) {
+  {
+    std::lock_guard lock(mutex_);
+    policy_ = policy;
+  }
+  // Enforce the new byte limit right away, the per class limit applies from
+  // the next release on.
+  trim(policy.max_idle_bytes);
+}
+
+void BufferPool::close() {
+  std::list<IdleBuffer> idle;
+  {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    idle.swap(idle_);
+    free_lists_.clear();
+    stats_.idle_buffers = 0;
+    stats_.idle_bytes = 0;
+  }
+}
+
+}  // namespace core
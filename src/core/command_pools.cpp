@@ -0,0 +1,77 @@
+#include "core/command_pools.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+
+namespace core {
+
+CommandPools::Allocation CommandPools::allocate(
+    const vk::CommandBufferLevel level) {
+  PerThreadPool *pool = nullptr;
+  size_t pool_index = 0;
+  {
+    std::lock_guard lock(mutex_);
+    if (destroyed_) {
+      throw std::runtime_error("CommandPools used after destroy()");
+    }
+
+    const auto id = std::this_thread::get_id();
+    if (const auto it = pool_of_thread_.find(id);
+        it != pool_of_thread_.end()) {
+      pool_index = it->second;
+    } else {
+      spdlog::debug("CommandPools: new pool for thread {}", pools_.size());
+      const auto create_info =
+          vk::CommandPoolCreateInfo()
+              .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+              .setQueueFamilyIndex(queue_family_index_);
+      auto new_pool = std::make_unique<PerThreadPool>();
+      new_pool->pool = device_ptr_->createCommandPool(create_info);
+      pool_index = pools_.size();
+      pools_.push_back(std::move(new_pool));
+      pool_of_thread_.emplace(id, pool_index);
+    }
+    pool = pools_[pool_index].get();
+
+    // Released by any thread, reused by the owner
+    if (auto &free = pool->free_list(level); !free.empty()) {
+      const auto command_buffer = free.back();
+      free.pop_back();
+      return {command_buffer, pool_index};
+    }
+  }
+
+  // Only this thread uses its pool, no need to hold the lock
+  const auto alloc_info = vk::CommandBufferAllocateInfo()
+                              .setCommandBufferCount(1)
+                              .setLevel(level)
+                              .setCommandPool(pool->pool);
+  return {device_ptr_->allocateCommandBuffers(alloc_info).front(), pool_index};
+}
+
+void CommandPools::release(const vk::CommandBufferLevel level,
+                           const Allocation &allocation) {
+  std::lock_guard lock(mutex_);
+  if (destroyed_ || allocation.pool_index >= pools_.size()) {
+    return;  // freed along with the pool
+  }
+  pools_[allocation.pool_index]->free_list(level).push_back(
+      allocation.command_buffer);
+}
+
+void CommandPools::destroy() {
+  std::lock_guard lock(mutex_);
+  if (destroyed_) {
+    return;
+  }
+  spdlog::debug("CommandPools::destroy() freeing {} pools", pools_.size());
+  for (const auto &pool : pools_) {
+    device_ptr_->destroyCommandPool(pool->pool);
+  }
+  pools_.clear();
+  pool_of_thread_.clear();
+  destroyed_ = true;
+}
+
+}  // namespace core
@@ -0,0 +1,90 @@
+#include "core/completion_reactor.hpp"
+
+#include <algorithm>
+
+#include "core/trace.hpp"
+
+namespace core {
+
+// How long the reactor waits before looking for new submissions, when it is
+// already waiting on others (a fence wait cannot be interrupted)
+constexpr uint64_t kPollTimeoutNs = 1'000'000;
+
+CompletionReactor::CompletionReactor(std::shared_ptr<vk::Device> device_ptr,
+                                     Executor executor)
+    : device_ptr_(std::move(device_ptr)), executor_(std::move(executor)) {
+  if (!executor_) {
+    executor_ = [](const std::coroutine_handle<> handle) { handle.resume(); };
+  }
+  thread_ = std::thread([this] { run(); });
+}
+
+CompletionReactor::~CompletionReactor() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void CompletionReactor::watch(const vk::Fence fence,
+                              const std::coroutine_handle<> handle) {
+  {
+    std::lock_guard lock(mutex_);
+    incoming_.push_back({fence, handle});
+    ++num_pending_;
+  }
+  cv_.notify_one();
+}
+
+void CompletionReactor::run() {
+  std::vector<Pending> pending;
+  std::vector<vk::Fence> fences;
+
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [&] {
+        return stopping_ || !incoming_.empty() || !pending.empty();
+      });
+      if (incoming_.empty() && pending.empty()) {
+        return;  // stopping, and nothing in flight
+      }
+      pending.insert(pending.end(), incoming_.begin(), incoming_.end());
+      incoming_.clear();
+    }
+
+    // Sleep until any of them is done
+    fences.clear();
+    for (const auto &p : pending) {
+      fences.push_back(p.fence);
+    }
+    {
+      VKC_TRACE_SCOPE_N("wait", "CompletionReactor::wait", fences.size());
+      const auto result =
+          device_ptr_->waitForFences(fences, false, kPollTimeoutNs);
+      if (result == vk::Result::eTimeout) {
+        continue;
+      }
+    }
+
+    // Resume every finished one, keep the others
+    size_t num_done = 0;
+    const auto done = std::ranges::remove_if(pending, [&](const Pending &p) {
+      if (device_ptr_->getFenceStatus(p.fence) != vk::Result::eSuccess) {
+        return false;
+      }
+      device_ptr_->resetFences(p.fence);
+      executor_(p.handle);
+      ++num_done;
+      return true;
+    });
+    pending.erase(done.begin(), done.end());
+
+    std::lock_guard lock(mutex_);
+    num_pending_ -= num_done;
+  }
+}
+
+}  // namespace core
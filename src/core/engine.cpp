@@ -1,8 +1,623 @@
 #include "core/engine.hpp"
 
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <optional>
+
+#include "core/mapped_file.hpp"
+#include "core/shader_loader.hpp"
+#include "core/thread_pool.hpp"
+#include "helpers.hpp"
+
 namespace core {
 
+// Must match the POD arguments of dispatch_args.cl
+struct DispatchArgsPushConstants {
+  int32_t count_adjust;
+  uint32_t threads_per_block;
+};
+
+std::shared_ptr<Algorithm> ComputeEngine::dispatch_args_algorithm(
+    const Algorithm &target,
+    const std::shared_ptr<Buffer> &count_buf,
+    const std::shared_ptr<Buffer> &args_buf,
+    const int32_t count_adjust) {
+  std::vector params{count_buf, args_buf};
+  auto algo = std::make_shared<Algorithm>(
+      get_device_ptr(),
+      pipeline_cache_,
+      "dispatch_args.spv",
+      params,
+      1u,
+      true,
+      make_clspv_push_const(DispatchArgsPushConstants{
+          .count_adjust = count_adjust,
+          .threads_per_block = target.get_threads_per_block(),
+      }));
+  if (manage_resources_) {
+    register_resource(algorithms_, algo);
+  }
+  return algo;
+}
+
+std::shared_ptr<Buffer> ComputeEngine::import_host_memory(
+    std::byte *data,
+    const vk::DeviceSize size,
+    std::shared_ptr<const void> keep_alive) {
+  const auto alignment = external_memory_host_alignment_;
+  if (alignment == 0 || size == 0 ||
+      reinterpret_cast<uintptr_t>(data) % alignment != 0 ||
+      size % alignment != 0) {
+    return nullptr;
+  }
+
+  const vk::Device device(device_.device);
+  const vk::DispatchLoaderDynamic dld(
+      instance_.instance, vkGetInstanceProcAddr, device_.device);
+  constexpr auto handle_type =
+      vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT;
+
+  vk::MemoryHostPointerPropertiesEXT host_properties;
+  try {
+    host_properties =
+        device.getMemoryHostPointerPropertiesEXT(handle_type, data, dld);
+  } catch (const vk::SystemError &e) {
+    spdlog::warn("Cannot import host memory: {}", e.what());
+    return nullptr;
+  }
+
+  const auto external_info =
+      vk::ExternalMemoryBufferCreateInfo().setHandleTypes(handle_type);
+  const auto buffer_info =
+      vk::BufferCreateInfo()
+          .setPNext(&external_info)
+          .setSize(size)
+          .setUsage(vk::BufferUsageFlagBits::eStorageBuffer);
+  const auto buffer = device.createBuffer(buffer_info);
+
+  const auto requirements = device.getBufferMemoryRequirements(buffer);
+  const auto type_bits =
+      requirements.memoryTypeBits & host_properties.memoryTypeBits;
+  if (type_bits == 0) {
+    spdlog::warn("Cannot import host memory: no compatible memory type");
+    device.destroyBuffer(buffer);
+    return nullptr;
+  }
+
+  const auto import_info = vk::ImportMemoryHostPointerInfoEXT()
+                               .setHandleType(handle_type)
+                               .setPHostPointer(data);
+  const auto alloc_info = vk::MemoryAllocateInfo()
+                              .setPNext(&import_info)
+                              .setAllocationSize(size)
+                              .setMemoryTypeIndex(std::countr_zero(type_bits));
+
+  vk::DeviceMemory memory;
+  try {
+    memory = device.allocateMemory(alloc_info);
+  } catch (const vk::SystemError &e) {
+    spdlog::warn("Cannot import host memory: {}", e.what());
+    device.destroyBuffer(buffer);
+    return nullptr;
+  }
+  device.bindBufferMemory(buffer, memory, 0);
+
+  auto buf = std::make_shared<Buffer>(
+      get_device_ptr(), buffer, memory, size, data, std::move(keep_alive));
+  buf->set_memory_tracker(memory_tracker_, BufferClass::kImported);
+  if (manage_resources_) {
+    register_resource(buffers_, buf);
+  }
+  return buf;
+}
+
+PipelineStats ComputeEngine::pipeline_stats(const Algorithm &algo) const {
+  PipelineStats stats{
+      .kernel = algo.get_spirv_filename(),
+      .threads_per_block = algo.get_threads_per_block(),
+  };
+  if (!features_.pipeline_executable_info) {
+    spdlog::debug("No pipeline executable properties, no statistics of {}",
+                  stats.kernel);
+    return stats;
+  }
+
+  const vk::DispatchLoaderDynamic dld(
+      instance_.instance, vkGetInstanceProcAddr, device_.device);
+  stats.executables = algo.capture_statistics(dld);
+  return stats;
+}
+
+std::shared_ptr<PipelineStatisticsQuery>
+ComputeEngine::pipeline_statistics_query() {
+  if (!features_.pipeline_statistics_query) {
+    throw std::runtime_error("Pipeline statistics queries are not enabled");
+  }
+
+  auto query = std::make_shared<PipelineStatisticsQuery>(get_device_ptr());
+  if (manage_resources_) {
+    register_resource(queries_, query);
+  }
+  return query;
+}
+
+std::shared_ptr<Buffer> ComputeEngine::load_point_file(
+    const std::filesystem::path &path, const size_t element_size) {
+  const auto file_size = std::filesystem::file_size(path);
+  if (file_size == 0 || file_size % element_size != 0) {
+    throw std::runtime_error("Bad point file size: " + path.string());
+  }
+
+  // Zero copy: import the mmap'ed pages
+  if (supports_external_memory_host()) {
+    try {
+      auto file = std::make_shared<MappedFile>(path);
+      const auto alignment = external_memory_host_alignment_;
+      const auto import_size =
+          (file_size + alignment - 1) / alignment * alignment;
+
+      if (import_size <= file->mapped_size()) {
+        if (auto buf = import_host_memory(file->data(), import_size, file)) {
+          spdlog::info("Imported {} ({} bytes) without copy",
+                       path.string(),
+                       file_size);
+          return buf;
+        }
+      }
+    } catch (const std::runtime_error &e) {
+      spdlog::warn("{}", e.what());
+    }
+    spdlog::info("Import of {} failed, reading it instead", path.string());
+  }
+
+  // Fallback: read straight into the persistently mapped buffer
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path.string());
+  }
+
+  auto buf = buffer(file_size);
+  constexpr size_t kReadChunk = 64 << 20;
+  for (size_t offset = 0; offset < file_size; offset += kReadChunk) {
+    const auto len = std::min<size_t>(kReadChunk, file_size - offset);
+    file.read(reinterpret_cast<char *>(buf->get_data_mut() + offset),
+              static_cast<std::streamsize>(len));
+    if (file.fail()) {
+      throw std::runtime_error("Failed to read file: " + path.string());
+    }
+  }
+  buf->flush();
+
+  spdlog::info("Read {} ({} bytes) into a mapped buffer",
+               path.string(),
+               file_size);
+  return buf;
+}
+
+std::vector<HeapUsage> ComputeEngine::heap_usage() const {
+  const VkPhysicalDeviceMemoryProperties *memory_properties = nullptr;
+  vmaGetMemoryProperties(allocator_, &memory_properties);
+
+  std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+  vmaGetHeapBudgets(allocator_, budgets.data());
+
+  std::vector<HeapUsage> heaps;
+  heaps.reserve(memory_properties->memoryHeapCount);
+  for (auto i = 0u; i < memory_properties->memoryHeapCount; ++i) {
+    const auto &budget = budgets[i];
+    heaps.push_back({
+        .heap_index = i,
+        .device_local = (memory_properties->memoryHeaps[i].flags &
+                         VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+        .usage = budget.usage,
+        .budget = budget.budget,
+        .block_bytes = budget.statistics.blockBytes,
+        .allocation_bytes = budget.statistics.allocationBytes,
+        .block_count = budget.statistics.blockCount,
+        .allocation_count = budget.statistics.allocationCount,
+    });
+  }
+  return heaps;
+}
+
+void ComputeEngine::log_memory_report() const {
+  const auto stats = memory_stats();
+  spdlog::info("Engine memory: {} bytes in {} buffers (peak {} bytes)",
+               stats.total_bytes,
+               stats.live_allocations,
+               stats.high_water_mark);
+  for (size_t i = 0; i < kNumBufferClasses; ++i) {
+    spdlog::info("\t{}: {} bytes in {} buffers",
+                 to_string(static_cast<BufferClass>(i)),
+                 stats.bytes_per_class[i],
+                 stats.buffers_per_class[i]);
+  }
+  spdlog::info("\t{} allocations in total, {} rejected",
+               stats.total_allocations,
+               stats.rejected_allocations);
+
+  for (const auto &heap : heap_usage()) {
+    spdlog::info("Heap {}{}: {} / {} bytes, {} allocations",
+                 heap.heap_index,
+                 heap.device_local ? " (device local)" : "",
+                 heap.usage,
+                 heap.budget,
+                 heap.allocation_count);
+  }
+}
+
+std::string ComputeEngine::over_budget_reason(
+    const vk::DeviceSize size,
+    const vk::BufferUsageFlags usage,
+    const bool device_local) const {
+  if (memory_soft_limit_ != 0) {
+    const auto used = memory_tracker_->stats().total_bytes;
+    if (used + size > memory_soft_limit_) {
+      return "soft limit of " + std::to_string(memory_soft_limit_) +
+             " bytes (" + std::to_string(used) + " in use)";
+    }
+  }
+
+  // Ask VMA which heap the buffer would land on, and check that heap's
+  // budget.
+  const auto buffer_info = vk::BufferCreateInfo().setSize(size).setUsage(usage);
+  const auto alloc_info =
+      device_local ? VmaAllocationCreateInfo{
+                         .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+                     }
+                   : VmaAllocationCreateInfo{
+                         .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                                  VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                         .usage = VMA_MEMORY_USAGE_AUTO,
+                     };
+  uint32_t memory_type = 0;
+  if (vmaFindMemoryTypeIndexForBufferInfo(
+          allocator_,
+          reinterpret_cast<const VkBufferCreateInfo *>(&buffer_info),
+          &alloc_info,
+          &memory_type) != VK_SUCCESS) {
+    return {};  // let the allocation itself report the error
+  }
+
+  const VkPhysicalDeviceMemoryProperties *memory_properties = nullptr;
+  vmaGetMemoryProperties(allocator_, &memory_properties);
+  const auto heap_index = memory_properties->memoryTypes[memory_type].heapIndex;
+
+  const auto heap = heap_usage().at(heap_index);
+  if (heap.usage + size > heap.budget) {
+    return "the budget of heap " + std::to_string(heap_index) + " (" +
+           std::to_string(heap.usage) + " / " + std::to_string(heap.budget) +
+           " bytes in use)";
+  }
+  return {};
+}
+
+std::unique_ptr<Buffer> ComputeEngine::allocate_buffer(
+    const vk::DeviceSize size, const vk::BufferUsageFlags usage) {
+  reserve_memory(size, usage);
+  auto buf =
+      std::make_unique<Buffer>(get_device_ptr(), allocator_, size, usage);
+  buf->set_memory_tracker(memory_tracker_, classify_buffer(usage));
+  return buf;
+}
+
+std::shared_ptr<Buffer> ComputeEngine::staged_buffer(
+    const vk::DeviceSize size, const vk::BufferUsageFlags usage) {
+  const auto device_usage = usage | vk::BufferUsageFlagBits::eTransferDst;
+  reserve_memory(size, device_usage, true);
+  auto buf = std::make_shared<Buffer>(get_device_ptr(),
+                                      allocator_,
+                                      size,
+                                      device_usage,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+                                      VmaAllocationCreateFlags{0});
+  buf->set_memory_tracker(memory_tracker_, classify_buffer(usage));
+
+  constexpr auto staging_usage = vk::BufferUsageFlagBits::eTransferSrc;
+  reserve_memory(size, staging_usage);
+  auto staging = std::make_unique<Buffer>(
+      get_device_ptr(),
+      allocator_,
+      size,
+      staging_usage,
+      VMA_MEMORY_USAGE_AUTO,
+      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+          VMA_ALLOCATION_CREATE_MAPPED_BIT);
+  staging->set_memory_tracker(memory_tracker_, BufferClass::kStaging);
+  buf->set_staging(std::move(staging));
+
+  if (manage_resources_) {
+    register_resource(buffers_, buf);
+  }
+  return buf;
+}
+
+std::shared_ptr<TransientBuffers> ComputeEngine::transient_buffers(
+    const TransientPlan &plan) {
+  auto transients = std::make_shared<TransientBuffers>(
+      get_device_ptr(),
+      allocator_,
+      plan,
+      memory_tracker_,
+      [this](const vk::DeviceSize size) {
+        reserve_memory(size, vk::BufferUsageFlagBits::eStorageBuffer, true);
+      });
+  if (manage_resources_) {
+    register_resource(transients_, transients);
+    for (size_t i = 0; i < transients->size(); ++i) {
+      register_resource(buffers_, transients->get(i));
+    }
+  }
+  return transients;
+}
+
+void ComputeEngine::enable_buffer_pool(const BufferPoolPolicy &policy) {
+  if (buffer_pool_) {
+    buffer_pool_->set_policy(policy);
+    return;
+  }
+  buffer_pool_ = std::make_shared<BufferPool>(
+      [this](const vk::DeviceSize size, const vk::BufferUsageFlags usage) {
+        return allocate_buffer(size, usage);
+      },
+      policy);
+}
+
+void ComputeEngine::reserve_memory(const vk::DeviceSize size,
+                                   const vk::BufferUsageFlags usage,
+                                   const bool device_local) {
+  auto reason = over_budget_reason(size, usage, device_local);
+  if (reason.empty()) {
+    return;
+  }
+
+  // Idle pooled buffers are the cheapest memory to give back
+  if (buffer_pool_ && buffer_pool_->trim() > 0) {
+    reason = over_budget_reason(size, usage, device_local);
+    if (reason.empty()) {
+      return;
+    }
+  }
+
+  // Give the user a chance to make room, then try once more
+  if (on_memory_pressure_ && on_memory_pressure_(size)) {
+    reason = over_budget_reason(size, usage, device_local);
+    if (reason.empty()) {
+      return;
+    }
+  }
+
+  memory_tracker_->on_reject();
+  throw OutOfBudgetError("Allocation of " + std::to_string(size) +
+                         " bytes exceeds " + reason);
+}
+
+std::vector<PipelineKey> ComputeEngine::known_pipelines() const {
+  std::vector<PipelineKey> keys;
+  for (const auto &shader : embedded_shaders()) {
+    const std::string name(shader.name);
+    // Would fail to build without the feature
+    if (name == "hilbert64.spv" && !features_.shader_int64) {
+      continue;
+    }
+    const auto tuned = tuning_profile_->entries_of(name);
+    if (tuned.empty()) {
+      keys.push_back({name, kDefaultThreadsPerBlock, shader.is_clspv});
+      continue;
+    }
+    for (const auto &entry : tuned) {
+      keys.push_back({name,
+                      entry.threads_per_block,
+                      shader.is_clspv,
+                      entry.spec_constants});
+    }
+  }
+  return keys;
+}
+
+size_t ComputeEngine::warm_up_pipelines(const std::vector<PipelineKey> &keys,
+                                        const size_t num_threads) {
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  // No point in more workers than pipelines
+  const size_t max_threads =
+      num_threads != 0 ? num_threads
+                       : std::max(1u, std::thread::hardware_concurrency());
+  ThreadPool pool(std::clamp<size_t>(keys.size(), 1, max_threads));
+  std::vector<std::future<void>> results;
+  results.reserve(keys.size());
+  for (const auto &key : keys) {
+    results.push_back(pool.submit([this, &key] {
+      warm_up_pipeline(vkh_device_, pipeline_cache_, key);
+    }));
+  }
+
+  size_t built = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    try {
+      results[i].get();
+      ++built;
+    } catch (const std::exception &e) {
+      spdlog::warn("Failed to warm up {} ({} threads per block): {}",
+                   keys[i].spirv_filename,
+                   keys[i].threads_per_block,
+                   e.what());
+    }
+  }
+
+  const auto end = std::chrono::high_resolution_clock::now();
+  spdlog::info("Warmed up {}/{} pipelines on {} threads in {:.2f} ms",
+               built,
+               keys.size(),
+               pool.size(),
+               std::chrono::duration<double, std::milli>(end - start).count());
+  return built;
+}
+
+void ComputeEngine::load_tuning_profile() {
+  const auto &properties = device_.physical_device.properties;
+  tuning_profile_ =
+      std::make_shared<TuningProfile>(TuningProfile::make_device_key(
+          properties.vendorID, properties.deviceID, properties.driverVersion));
+  tuning_profile_->load(
+      TuningProfile::default_path(tuning_profile_->get_device_key()));
+}
+
+void ComputeEngine::save_tuning_profile() const {
+  const auto path =
+      TuningProfile::default_path(tuning_profile_->get_device_key());
+  tuning_profile_->save(path);
+  spdlog::info("Saved tuning profile to {}", path.string());
+}
+
+std::vector<TuningCandidate> ComputeEngine::workgroup_candidates() const {
+  const auto &limits = device_.physical_device.properties.limits;
+  return TuningProfile::workgroup_candidates(
+      std::min(limits.maxComputeWorkGroupSize[0],
+               limits.maxComputeWorkGroupInvocations));
+}
+
+TuningEntry ComputeEngine::autotune(
+    Algorithm &algo,
+    const uint32_t n,
+    const std::vector<TuningCandidate> &candidates,
+    const uint32_t repetitions) {
+  const auto &limits = device_.physical_device.properties.limits;
+  const auto seq = sequence();
+
+  // Timestamps around the dispatches, so that submission and wake-up latency
+  // on the host do not rank the candidates. Host time if the compute queue
+  // has no timestamps.
+  const auto queue_index =
+      device_.get_queue_index(vkb::QueueType::compute).value();
+  const bool gpu_timing =
+      device_.queue_families[queue_index].timestampValidBits != 0 &&
+      limits.timestampPeriod > 0.0f;
+  const auto device = get_device_ptr();
+  vk::QueryPool timestamps;
+  if (gpu_timing) {
+    timestamps = device->createQueryPool(vk::QueryPoolCreateInfo()
+                                             .setQueryType(
+                                                 vk::QueryType::eTimestamp)
+                                             .setQueryCount(2));
+  } else {
+    spdlog::warn("Autotune: no timestamps on the compute queue, timing {} "
+                 "on the host",
+                 algo.get_spirv_filename());
+  }
+
+  // Command buffers are one time submit, so record again for every run.
+  const auto run_once = [&] {
+    seq->cmd_begin();
+    if (gpu_timing) {
+      seq->get_handle().resetQueryPool(timestamps, 0, 2);
+    }
+    algo.record_bind_core(seq->get_handle());
+    algo.record_bind_push(seq->get_handle());
+    if (gpu_timing) {
+      seq->get_handle().writeTimestamp(
+          vk::PipelineStageFlagBits::eTopOfPipe, timestamps, 0);
+    }
+    for (auto i = 0u; i < repetitions; ++i) {
+      algo.record_dispatch_tmp(seq->get_handle(), n);
+      seq->record_compute_barrier();
+    }
+    if (gpu_timing) {
+      seq->get_handle().writeTimestamp(
+          vk::PipelineStageFlagBits::eBottomOfPipe, timestamps, 1);
+    }
+    seq->cmd_end();
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    seq->launch_kernel_async();
+    seq->sync();
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    const auto host_ms =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        repetitions;
+    if (!gpu_timing) {
+      return host_ms;
+    }
+
+    const auto result = device->getQueryPoolResults<uint64_t>(
+        timestamps,
+        0,
+        2,
+        2 * sizeof(uint64_t),
+        sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+    if (result.result != vk::Result::eSuccess) {
+      spdlog::warn("Autotune: failed to read the timestamps, using host time");
+      return host_ms;
+    }
+    // Ticks of timestampPeriod nanoseconds
+    const auto ticks = result.value[1] - result.value[0];
+    return static_cast<double>(ticks) * limits.timestampPeriod / 1e6 /
+           repetitions;
+  };
+
+  std::optional<TuningEntry> best;
+  for (const auto &candidate : candidates) {
+    if (candidate.threads_per_block == 0 ||
+        candidate.threads_per_block > limits.maxComputeWorkGroupSize[0] ||
+        candidate.threads_per_block > limits.maxComputeWorkGroupInvocations) {
+      continue;
+    }
+
+    try {
+      algo.set_variant(candidate.threads_per_block,
+                       SpecConstants(algo.get_base_spec_constants())
+                           .merge(candidate.spec_constants));
+    } catch (const std::exception &e) {
+      // vk::SystemError, or std::invalid_argument for constants the shader
+      // cannot run with
+      spdlog::warn("Autotune {}: skipping {} threads per block ({})",
+                   algo.get_spirv_filename(),
+                   candidate.threads_per_block,
+                   e.what());
+      continue;
+    }
+
+    run_once();  // warm up
+    const auto time_ms = run_once();
+
+    spdlog::info("Autotune {} (n = {}): {} threads per block, {:.4f} ms",
+                 algo.get_spirv_filename(),
+                 n,
+                 candidate.threads_per_block,
+                 time_ms);
+
+    if (!best.has_value() || time_ms < best->time_ms) {
+      best = TuningEntry{
+          .threads_per_block = candidate.threads_per_block,
+          .spec_constants = candidate.spec_constants,
+          .time_ms = time_ms,
+      };
+    }
+  }
+
+  if (timestamps) {
+    device->destroyQueryPool(timestamps);
+  }
+
+  if (!best.has_value()) {
+    throw std::runtime_error("No valid tuning candidate for " +
+                             algo.get_spirv_filename());
+  }
+
+  algo.set_variant(best->threads_per_block,
+                   SpecConstants(algo.get_base_spec_constants())
+                       .merge(best->spec_constants));
+  algo.set_tuning_profile(tuning_profile_);
+  tuning_profile_->update(algo.get_spirv_filename(), n, *best);
+  return *best;
+}
+
 void ComputeEngine::destroy() {
+  std::lock_guard lock(registry_mutex_);
+
   if (manage_resources_ && !algorithms_.empty()) {
     spdlog::debug("ComputeEngine::destroy() explicitly freeing algorithms");
     for (auto &weak_algorithm : algorithms_) {
@@ -32,6 +647,35 @@ void ComputeEngine::destroy() {
     }
     sequence_.clear();
   }
+
+  // After their buffers, the blocks they are bound to
+  if (manage_resources_ && !transients_.empty()) {
+    spdlog::debug("ComputeEngine::destroy() explicitly freeing transients");
+    for (auto &weak_transients : transients_) {
+      if (const auto transients = weak_transients.lock()) {
+        transients->destroy();
+      }
+    }
+    transients_.clear();
+  }
+
+  if (manage_resources_ && !queries_.empty()) {
+    spdlog::debug("ComputeEngine::destroy() explicitly freeing queries");
+    for (auto &weak_query : queries_) {
+      if (const auto query = weak_query.lock()) {
+        query->destroy();
+      }
+    }
+    queries_.clear();
+  }
+
+  // Frees all secondary command buffers, live ones are ignored on release
+  command_pools_->destroy();
+
+  // Frees the idle buffers, and live ones are freed (not recycled) on release
+  if (buffer_pool_) {
+    buffer_pool_->close();
+  }
 }
 
 }  // namespace core
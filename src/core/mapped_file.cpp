@@ -0,0 +1,78 @@
+#include "core/mapped_file.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+
+namespace core {
+
+// Not implemented on Windows, callers fall back to regular reads.
+
+size_t MappedFile::page_size() { return 4096; }
+
+MappedFile::MappedFile(const fs::path &path) {
+  throw std::runtime_error("MappedFile is not supported on this platform: " +
+                           path.string());
+}
+
+MappedFile::~MappedFile() = default;
+
+}  // namespace core
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace core {
+
+size_t MappedFile::page_size() {
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+MappedFile::MappedFile(const fs::path &path) {
+  if (!fs::exists(path)) {
+    throw std::runtime_error("File not found: " + path.string());
+  }
+
+  size_ = fs::file_size(path);
+  if (size_ == 0) {
+    return;
+  }
+
+  const auto page = page_size();
+  mapped_size_ = (size_ + page - 1) / page * page;
+
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + path.string());
+  }
+
+  void *ptr = mmap(nullptr,
+                   mapped_size_,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_POPULATE,
+                   fd,
+                   0);
+  close(fd);  // the mapping keeps the file alive
+
+  if (ptr == MAP_FAILED) {
+    throw std::runtime_error("Failed to mmap file: " + path.string());
+  }
+
+  data_ = static_cast<std::byte *>(ptr);
+  spdlog::debug("MappedFile: {} ({} bytes)", path.string(), size_);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(data_, mapped_size_);
+  }
+}
+
+}  // namespace core
+
+#endif
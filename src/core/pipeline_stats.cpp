@@ -0,0 +1,196 @@
+#include "core/pipeline_stats.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string_view>
+
+namespace core {
+
+namespace {
+
+std::string to_lower(std::string s) {
+  std::ranges::transform(s, s.begin(), [](const unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return s;
+}
+
+bool contains(const std::string &s, const std::string_view what) {
+  return s.find(what) != std::string::npos;
+}
+
+void write_json_string(std::ostream &os, const std::string &s) {
+  os << '"';
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      os << escaped;
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+// JSON has no NaN or infinity, e.g. a metric of a run that timed nothing
+void write_json_number(std::ostream &os, const double value) {
+  if (std::isfinite(value)) {
+    os << value;
+  } else {
+    os << "null";
+  }
+}
+
+void write_counter(std::ostream &os,
+                   const char *name,
+                   const std::optional<uint64_t> &value) {
+  if (value.has_value()) {
+    os << ",\"" << name << "\":" << *value;
+  }
+}
+
+}  // namespace
+
+void summarize_statistics(PipelineExecutableStats &stats) {
+  const auto add = [](std::optional<uint64_t> &counter, const double value) {
+    counter = counter.value_or(0) + static_cast<uint64_t>(value);
+  };
+
+  std::optional<uint64_t> vgprs;
+  std::optional<uint64_t> registers;
+  for (const auto &statistic : stats.statistics) {
+    const auto name = to_lower(statistic.name);
+    const auto value = static_cast<uint64_t>(statistic.value);
+
+    if (contains(name, "spill")) {
+      add(stats.spills, statistic.value);
+    } else if (contains(name, "vgpr")) {
+      vgprs = vgprs.value_or(value);
+    } else if (contains(name, "register")) {
+      registers = registers.value_or(value);
+    } else if (contains(name, "lds") || contains(name, "shared") ||
+               contains(name, "workgroup memory")) {
+      stats.shared_memory_bytes = stats.shared_memory_bytes.value_or(value);
+    } else if (contains(name, "instruction")) {
+      stats.instructions = stats.instructions.value_or(value);
+    }
+  }
+
+  // On AMD the vector registers are what limits occupancy
+  stats.registers = vgprs.has_value() ? vgprs : registers;
+}
+
+void write_pipeline_stats_json(const std::filesystem::path &path,
+                               const std::vector<PipelineStats> &pipelines) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path.string());
+  }
+
+  // Enough digits for counters reported as doubles
+  file << std::setprecision(15);
+  file << "{\"pipelines\":[";
+  for (size_t i = 0; i < pipelines.size(); ++i) {
+    const auto &pipeline = pipelines[i];
+    file << (i == 0 ? "\n" : ",\n") << "{\"kernel\":";
+    write_json_string(file, pipeline.kernel);
+    file << ",\"threads_per_block\":" << pipeline.threads_per_block;
+    write_counter(file, "invocations", pipeline.invocations);
+
+    file << ",\"metrics\":{";
+    for (size_t m = 0; m < pipeline.metrics.size(); ++m) {
+      file << (m == 0 ? "" : ",");
+      write_json_string(file, pipeline.metrics[m].first);
+      file << ':';
+      write_json_number(file, pipeline.metrics[m].second);
+    }
+
+    file << "},\"executables\":[";
+    for (size_t e = 0; e < pipeline.executables.size(); ++e) {
+      const auto &executable = pipeline.executables[e];
+      file << (e == 0 ? "" : ",") << "{\"name\":";
+      write_json_string(file, executable.name);
+      file << ",\"description\":";
+      write_json_string(file, executable.description);
+      file << ",\"subgroup_size\":" << executable.subgroup_size;
+      write_counter(file, "registers", executable.registers);
+      write_counter(
+          file, "shared_memory_bytes", executable.shared_memory_bytes);
+      write_counter(file, "spills", executable.spills);
+      write_counter(file, "instructions", executable.instructions);
+
+      file << ",\"statistics\":{";
+      for (size_t s = 0; s < executable.statistics.size(); ++s) {
+        file << (s == 0 ? "" : ",");
+        write_json_string(file, executable.statistics[s].name);
+        file << ':';
+        write_json_number(file, executable.statistics[s].value);
+      }
+      file << "}}";
+    }
+    file << "]}";
+  }
+  file << "\n]}\n";
+}
+
+// -----------------------------------------------------------------------------
+//                  PipelineStatisticsQuery
+// -----------------------------------------------------------------------------
+
+PipelineStatisticsQuery::PipelineStatisticsQuery(
+    std::shared_ptr<vk::Device> device_ptr)
+    : VulkanResource(std::move(device_ptr)) {
+  const auto create_info =
+      vk::QueryPoolCreateInfo()
+          .setQueryType(vk::QueryType::ePipelineStatistics)
+          .setQueryCount(1)
+          .setPipelineStatistics(
+              vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations);
+  handle_ = device_ptr_->createQueryPool(create_info);
+}
+
+void PipelineStatisticsQuery::destroy() {
+  if (handle_) {
+    device_ptr_->destroyQueryPool(handle_);
+    handle_ = nullptr;
+  }
+}
+
+void PipelineStatisticsQuery::record_reset(
+    const vk::CommandBuffer &cmd_buf) const {
+  cmd_buf.resetQueryPool(handle_, 0, 1);
+}
+
+void PipelineStatisticsQuery::record_begin(
+    const vk::CommandBuffer &cmd_buf) const {
+  cmd_buf.beginQuery(handle_, 0, {});
+}
+
+void PipelineStatisticsQuery::record_end(
+    const vk::CommandBuffer &cmd_buf) const {
+  cmd_buf.endQuery(handle_, 0);
+}
+
+uint64_t PipelineStatisticsQuery::get_invocations() const {
+  // One statistic enabled, so one value per query
+  const auto result = device_ptr_->getQueryPoolResult<uint64_t>(
+      handle_,
+      0,
+      1,
+      sizeof(uint64_t),
+      vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+  if (result.result != vk::Result::eSuccess) {
+    throw std::runtime_error("Failed to read the pipeline statistics query");
+  }
+  return result.value;
+}
+
+}  // namespace core
@@ -0,0 +1,98 @@
+#include "core/pipeline_warmup.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <spirv_cross/spirv_cross.hpp>
+
+#include "core/shader_loader.hpp"
+#include "core/trace.hpp"
+
+namespace core {
+
+void warm_up_pipeline(const vk::Device device,
+                      const vk::PipelineCache cache,
+                      const PipelineKey &key) {
+  VKC_TRACE_SCOPE_N("pipeline", "warm_up_pipeline", key.threads_per_block);
+  const auto spirv_binary = load_shader(key.spirv_filename);
+
+  // Reflect what Algorithm would have set up from the user's arguments
+  const spirv_cross::Compiler compiler(spirv_binary);
+  const auto resources = compiler.get_shader_resources();
+
+  uint32_t num_bindings = 0;
+  for (const auto &buffer : resources.storage_buffers) {
+    num_bindings = std::max(
+        num_bindings,
+        compiler.get_decoration(buffer.id, spv::DecorationBinding) + 1);
+  }
+
+  uint32_t push_constants_size = 0;
+  for (const auto &block : resources.push_constant_buffers) {
+    const auto &type = compiler.get_type(block.base_type_id);
+    push_constants_size =
+        static_cast<uint32_t>(compiler.get_declared_struct_size(type));
+  }
+
+  std::vector<vk::DescriptorSetLayoutBinding> bindings;
+  bindings.reserve(num_bindings);
+  for (auto i = 0u; i < num_bindings; ++i) {
+    bindings.emplace_back(i,  // Binding index
+                          vk::DescriptorType::eStorageBuffer,
+                          1,  // Descriptor count
+                          vk::ShaderStageFlagBits::eCompute);
+  }
+  const auto set_layout = device.createDescriptorSetLayout(
+      vk::DescriptorSetLayoutCreateInfo().setBindings(bindings));
+
+  const auto push_const = vk::PushConstantRange()
+                              .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                              .setOffset(0)
+                              .setSize(push_constants_size);
+  auto layout_create_info =
+      vk::PipelineLayoutCreateInfo().setSetLayouts(set_layout);
+  if (push_constants_size > 0) {
+    layout_create_info.setPushConstantRanges(push_const);
+  }
+  const auto pipeline_layout = device.createPipelineLayout(layout_create_info);
+
+  const auto module = device.createShaderModule(
+      vk::ShaderModuleCreateInfo().setCode(spirv_binary));
+
+  std::vector<vk::SpecializationMapEntry> spec_map;
+  std::vector<uint32_t> spec_map_content;
+  const auto spec_info = key.spec_constants.make_spec_info(
+      key.threads_per_block, spec_map, spec_map_content);
+
+  const auto shader_stage_create_info =
+      vk::PipelineShaderStageCreateInfo()
+          .setStage(vk::ShaderStageFlagBits::eCompute)
+          .setModule(module)
+          .setPName(key.is_clspv ? "foo" : "main")
+          .setPSpecializationInfo(&spec_info);
+
+  const auto create_info = vk::ComputePipelineCreateInfo()
+                               .setStage(shader_stage_create_info)
+                               .setLayout(pipeline_layout);
+
+  const auto destroy_temporaries = [&] {
+    device.destroyShaderModule(module);
+    device.destroyPipelineLayout(pipeline_layout);
+    device.destroyDescriptorSetLayout(set_layout);
+  };
+
+  try {
+    const auto result = device.createComputePipeline(cache, create_info);
+    device.destroyPipeline(result.value);
+  } catch (...) {
+    destroy_temporaries();
+    throw;
+  }
+  destroy_temporaries();
+
+  spdlog::debug("warm_up_pipeline: {} ({} threads per block)",
+                key.spirv_filename,
+                key.threads_per_block);
+}
+
+}  // namespace core
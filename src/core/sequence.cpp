@@ -7,29 +7,87 @@
 
 namespace core {
 
+namespace {
+
+void record_compute_barrier_into(const vk::CommandBuffer cmd) {
+  const auto barrier =
+      vk::MemoryBarrier()
+          .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+          .setDstAccessMask(vk::AccessFlagBits::eShaderRead |
+                            vk::AccessFlagBits::eShaderWrite);
+  cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                      vk::PipelineStageFlagBits::eComputeShader,
+                      {},
+                      barrier,
+                      nullptr,
+                      nullptr);
+}
+
+void record_indirect_barrier_into(const vk::CommandBuffer cmd) {
+  const auto barrier =
+      vk::MemoryBarrier()
+          .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+          .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead |
+                            vk::AccessFlagBits::eShaderRead |
+                            vk::AccessFlagBits::eShaderWrite);
+  cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                      vk::PipelineStageFlagBits::eDrawIndirect |
+                          vk::PipelineStageFlagBits::eComputeShader,
+                      {},
+                      barrier,
+                      nullptr,
+                      nullptr);
+}
+
+}  // namespace
+
 void Sequence::cmd_begin() const {
-  spdlog::debug("Sequence::begin!");
+  VKC_TRACE_SCOPE("record", "Sequence::cmd_begin");
   constexpr auto info = vk::CommandBufferBeginInfo().setFlags(
       vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
   handle_.begin(info);
 }
 
 void Sequence::cmd_end() const {
-  spdlog::debug("Sequence::end!");
+  VKC_TRACE_SCOPE("record", "Sequence::cmd_end");
   handle_.end();
 }
 
+void Sequence::record_compute_barrier() const {
+  record_compute_barrier_into(handle_);
+}
+
+void Sequence::record_indirect_barrier() const {
+  record_indirect_barrier_into(handle_);
+}
+
+void Sequence::record_execute(
+    const std::vector<std::shared_ptr<SecondarySequence>> &secondaries) const {
+  VKC_TRACE_SCOPE_N("record", "Sequence::record_execute", secondaries.size());
+  std::vector<vk::CommandBuffer> command_buffers;
+  command_buffers.reserve(secondaries.size());
+  for (const auto &secondary : secondaries) {
+    command_buffers.push_back(secondary->get_handle());
+  }
+  handle_.executeCommands(command_buffers);
+}
+
 void Sequence::launch_kernel_async() {
-  spdlog::debug("Sequence::launch_kernel_async");
+  VKC_TRACE_SCOPE("submit", "Sequence::launch_kernel_async");
 
   const auto submit_info = vk::SubmitInfo().setCommandBuffers(handle_);
   assert(vkh_queue_ != nullptr);
 
+  // vkQueueSubmit needs the queue externally synchronized
+  std::unique_lock<std::mutex> lock;
+  if (queue_mutex_ != nullptr) {
+    lock = std::unique_lock(*queue_mutex_);
+  }
   vkh_queue_->submit(submit_info, fence_);
 }
 
 void Sequence::sync() const {
-  spdlog::debug("Sequence::sync");
+  VKC_TRACE_SCOPE("wait", "Sequence::sync");
   const auto wait_result =
       device_ptr_->waitForFences(fence_, false, UINT64_MAX);
   assert(wait_result == vk::Result::eSuccess);
@@ -69,4 +127,58 @@ void Sequence::create_command_buffer() {
   handle_ = device_ptr_->allocateCommandBuffers(alloc_info).front();
 }
 
+// -----------------------------------------------------------------------------
+//                            SecondarySequence
+// -----------------------------------------------------------------------------
+
+SecondarySequence::SecondarySequence(std::shared_ptr<vk::Device> device_ptr,
+                                     const std::shared_ptr<CommandPools> &pools)
+    : VulkanResource(std::move(device_ptr)), pools_(pools) {
+  const auto allocation = pools->allocate(vk::CommandBufferLevel::eSecondary);
+  handle_ = allocation.command_buffer;
+  pool_index_ = allocation.pool_index;
+}
+
+void SecondarySequence::cmd_begin() const {
+  VKC_TRACE_SCOPE("record", "SecondarySequence::cmd_begin");
+  constexpr auto inheritance = vk::CommandBufferInheritanceInfo();
+  const auto info =
+      vk::CommandBufferBeginInfo()
+          .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+          .setPInheritanceInfo(&inheritance);
+  handle_.begin(info);
+}
+
+void SecondarySequence::cmd_end() const {
+  VKC_TRACE_SCOPE("record", "SecondarySequence::cmd_end");
+  handle_.end();
+}
+
+void SecondarySequence::record_dispatch(const Algorithm &algo,
+                                        const uint32_t n) const {
+  VKC_TRACE_SCOPE_N("record", "SecondarySequence::record_dispatch", n);
+  algo.record_bind_core(handle_);
+  algo.record_bind_push(handle_);
+  algo.record_dispatch_tmp(handle_, n);
+}
+
+void SecondarySequence::record_compute_barrier() const {
+  record_compute_barrier_into(handle_);
+}
+
+void SecondarySequence::record_indirect_barrier() const {
+  record_indirect_barrier_into(handle_);
+}
+
+void SecondarySequence::destroy() {
+  if (!handle_) {
+    return;
+  }
+  if (const auto pools = pools_.lock()) {
+    pools->release(vk::CommandBufferLevel::eSecondary,
+                   {handle_, pool_index_});
+  }
+  handle_ = nullptr;
+}
+
 }  // namespace core
@@ -0,0 +1,95 @@
+#include "core/stream_executor.hpp"
+
+#include <algorithm>
+
+namespace core {
+
+StreamExecutor::StreamExecutor(ComputeEngine &engine,
+                               const std::string_view spirv_filename,
+                               const uint32_t threads_per_block,
+                               const size_t in_element_size,
+                               const size_t out_element_size,
+                               const uint32_t chunk_size,
+                               const uint32_t num_slots,
+                               PushConstantsFn make_push_constants)
+    : in_element_size_(in_element_size),
+      out_element_size_(out_element_size),
+      chunk_size_(chunk_size),
+      make_push_constants_(std::move(make_push_constants)) {
+  if (chunk_size == 0 || num_slots == 0) {
+    throw std::invalid_argument("StreamExecutor needs chunks and slots");
+  }
+
+  spdlog::info("StreamExecutor ({}): {} slots of {} elements",
+               spirv_filename,
+               num_slots,
+               chunk_size);
+
+  slots_.resize(num_slots);
+  for (auto &slot : slots_) {
+    slot.in_buf = engine.buffer(chunk_size * in_element_size);
+    slot.out_buf = engine.buffer(chunk_size * out_element_size);
+
+    std::vector params{slot.in_buf, slot.out_buf};
+    slot.algo = engine.algorithm(spirv_filename,
+                                 params,
+                                 threads_per_block,
+                                 true,
+                                 make_push_constants_(chunk_size));
+    slot.seq = engine.sequence();
+  }
+}
+
+void StreamExecutor::retire(Slot &slot, const ConsumerFn &consumer) const {
+  VKC_TRACE_SCOPE_N("stream", "StreamExecutor::retire", slot.offset);
+  slot.seq->sync();
+  slot.in_flight = false;
+
+  const auto size = slot.count * out_element_size_;
+  slot.out_buf->invalidate(size);
+  consumer(slot.offset, {slot.out_buf->get_data(), size});
+}
+
+void StreamExecutor::run(const std::byte *input,
+                         const size_t num_elements,
+                         ConsumerFn consumer) {
+  const size_t num_chunks = (num_elements + chunk_size_ - 1) / chunk_size_;
+  spdlog::debug("StreamExecutor::run, {} elements in {} chunks",
+                num_elements,
+                num_chunks);
+
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    VKC_TRACE_SCOPE_N("stream", "StreamExecutor::chunk", chunk);
+    auto &slot = slots_[chunk % slots_.size()];
+
+    // The slot still holds the chunk from 'num_slots' iterations ago. Since
+    // slots are reused round robin, chunks retire in order.
+    if (slot.in_flight) {
+      retire(slot, consumer);
+    }
+
+    slot.offset = chunk * chunk_size_;
+    slot.count = static_cast<uint32_t>(
+        std::min<size_t>(chunk_size_, num_elements - slot.offset));
+
+    const auto in_size = slot.count * in_element_size_;
+    slot.in_buf->tmp_write_data(input + slot.offset * in_element_size_,
+                                in_size);
+    slot.in_buf->flush_dirty();
+
+    slot.algo->set_push_constants(make_push_constants_(slot.count));
+    slot.seq->simple_record_commands(*slot.algo, slot.count);
+    slot.seq->launch_kernel_async();
+    slot.in_flight = true;
+  }
+
+  // Drain the remaining slots, oldest first
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    auto &slot = slots_[(num_chunks + i) % slots_.size()];
+    if (slot.in_flight) {
+      retire(slot, consumer);
+    }
+  }
+}
+
+}  // namespace core
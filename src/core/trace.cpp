@@ -0,0 +1,161 @@
+#include "core/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace core::trace {
+
+namespace {
+
+/**
+ * @brief Ring buffer of one thread. Only the owning thread writes 'events' and
+ * 'head', readers copy the slots between 'tail' and 'head'.
+ */
+struct ThreadBuffer {
+  explicit ThreadBuffer(const uint32_t tid) : tid(tid) {}
+
+  uint32_t tid;
+  std::array<Event, kEventsPerThread> events{};
+  std::atomic<uint64_t> head{0};  // number of events ever written
+  std::atomic<uint64_t> tail{0};  // first event not cleared
+};
+
+std::atomic<bool> g_enabled{true};
+
+// Buffers outlive their threads, so events of finished threads can be exported
+std::mutex g_registry_mutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_registry;
+
+ThreadBuffer &thread_buffer() {
+  thread_local const std::shared_ptr<ThreadBuffer> buffer = [] {
+    std::lock_guard lock(g_registry_mutex);
+    auto b = std::make_shared<ThreadBuffer>(
+        static_cast<uint32_t>(g_registry.size() + 1));
+    g_registry.push_back(b);
+    return b;
+  }();
+  return *buffer;
+}
+
+/**
+ * @brief Copy the live events of a buffer, dropping those that were
+ * overwritten by the writer while copying.
+ */
+std::vector<Event> snapshot(const ThreadBuffer &buffer) {
+  const auto head = buffer.head.load(std::memory_order_acquire);
+  const auto tail = buffer.tail.load(std::memory_order_relaxed);
+  const auto oldest = head > kEventsPerThread ? head - kEventsPerThread : 0;
+  const auto first = std::max(tail, oldest);
+
+  std::vector<Event> events;
+  events.reserve(head - first);
+  for (auto i = first; i < head; ++i) {
+    events.push_back(buffer.events[i % kEventsPerThread]);
+  }
+
+  const auto new_head = buffer.head.load(std::memory_order_acquire);
+  if (new_head > kEventsPerThread && new_head - kEventsPerThread > first) {
+    const auto overwritten =
+        std::min<uint64_t>(new_head - kEventsPerThread - first, events.size());
+    events.erase(events.begin(),
+                 events.begin() + static_cast<ptrdiff_t>(overwritten));
+  }
+  return events;
+}
+
+void write_json_string(std::ostream &os, const char *s) {
+  os << '"';
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' || *s == '\\') {
+      os << '\\';
+    }
+    os << *s;
+  }
+  os << '"';
+}
+
+}  // namespace
+
+uint64_t now_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void record(const Event &event) {
+  auto &buffer = thread_buffer();
+  const auto head = buffer.head.load(std::memory_order_relaxed);
+  buffer.events[head % kEventsPerThread] = event;
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void set_enabled(const bool enabled) {
+  g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void clear() {
+  std::lock_guard lock(g_registry_mutex);
+  for (const auto &buffer : g_registry) {
+    buffer->tail.store(buffer->head.load(std::memory_order_acquire),
+                       std::memory_order_relaxed);
+  }
+}
+
+void write_chrome_trace(const std::filesystem::path &path) {
+  std::vector<std::pair<uint32_t, std::vector<Event>>> threads;
+  {
+    std::lock_guard lock(g_registry_mutex);
+    for (const auto &buffer : g_registry) {
+      threads.emplace_back(buffer->tid, snapshot(*buffer));
+    }
+  }
+
+  // Timestamps in the file start at the first event
+  uint64_t origin_ns = UINT64_MAX;
+  for (const auto &[tid, events] : threads) {
+    for (const auto &event : events) {
+      origin_ns = std::min(origin_ns, event.begin_ns);
+    }
+  }
+
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path.string());
+  }
+
+  // Chrome trace timestamps are in microseconds
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto &[tid, events] : threads) {
+    for (const auto &event : events) {
+      file << (first ? "\n" : ",\n") << "{\"name\":";
+      write_json_string(file, event.name);
+      file << ",\"cat\":";
+      write_json_string(file, event.category);
+      file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+           << ",\"ts\":" << (event.begin_ns - origin_ns) / 1e3
+           << ",\"dur\":" << (event.end_ns - event.begin_ns) / 1e3
+           << ",\"args\":{\"n\":" << event.arg << "}}";
+      first = false;
+    }
+  }
+  file << "\n]}\n";
+
+  if (file.fail()) {
+    throw std::runtime_error("Failed to write file: " + path.string());
+  }
+}
+
+}  // namespace core::trace
@@ -0,0 +1,248 @@
+#include "core/transient_buffers.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "core/vma_usage.hpp"
+
+namespace core {
+
+namespace {
+
+vk::DeviceSize align_up(const vk::DeviceSize offset,
+                        const vk::DeviceSize alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool stages_overlap(const TransientRange &a, const TransientRange &b) {
+  return a.first_stage <= b.last_stage && b.first_stage <= a.last_stage;
+}
+
+bool memory_overlaps(const TransientRange &a, const TransientRange &b) {
+  return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+}  // namespace
+
+size_t TransientPlan::add(const vk::DeviceSize size,
+                          const uint32_t first_stage,
+                          const uint32_t last_stage,
+                          const vk::BufferUsageFlags usage) {
+  if (size == 0) {
+    throw std::invalid_argument("Transient buffer of size 0");
+  }
+  if (first_stage > last_stage) {
+    throw std::invalid_argument("Transient buffer ends before it starts");
+  }
+  buffers_.push_back({
+      .size = size,
+      .first_stage = first_stage,
+      .last_stage = last_stage,
+      .usage = usage,
+  });
+  return buffers_.size() - 1;
+}
+
+vk::DeviceSize pack_transient_ranges(std::vector<TransientRange> &ranges) {
+  std::vector<size_t> order(ranges.size());
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::ranges::stable_sort(order, [&](const size_t a, const size_t b) {
+    return ranges[a].size > ranges[b].size;
+  });
+
+  vk::DeviceSize block_size = 0;
+  std::vector<size_t> placed;
+  placed.reserve(ranges.size());
+  for (const auto i : order) {
+    auto &range = ranges[i];
+
+    // Placed ranges alive at the same time, lowest first
+    std::vector<const TransientRange *> live;
+    for (const auto j : placed) {
+      if (stages_overlap(range, ranges[j])) {
+        live.push_back(&ranges[j]);
+      }
+    }
+    std::ranges::sort(live, {}, &TransientRange::offset);
+
+    // First gap big enough, or after all of them
+    vk::DeviceSize offset = 0;
+    for (const auto *other : live) {
+      offset = align_up(offset, range.alignment);
+      if (offset + range.size <= other->offset) {
+        break;
+      }
+      offset = std::max(offset, other->offset + other->size);
+    }
+    range.offset = align_up(offset, range.alignment);
+
+    block_size = std::max(block_size, range.offset + range.size);
+    placed.push_back(i);
+  }
+  return block_size;
+}
+
+// -----------------------------------------------------------------------------
+//                  TransientBuffers
+// -----------------------------------------------------------------------------
+
+TransientBuffers::TransientBuffers(
+    std::shared_ptr<vk::Device> device_ptr,
+    const VmaAllocator allocator,
+    const TransientPlan &plan,
+    std::shared_ptr<MemoryTracker> memory_tracker,
+    const ReserveFn &reserve)
+    : device_ptr_(std::move(device_ptr)) {
+  VKC_TRACE_SCOPE_N(
+      "alloc", "TransientBuffers::TransientBuffers", plan.get_buffers().size());
+  const auto &descs = plan.get_buffers();
+  if (descs.empty()) {
+    throw std::invalid_argument("No buffers in the transient plan");
+  }
+
+  // The buffers first, their requirements decide the layout
+  std::vector<vk::Buffer> handles;
+  handles.reserve(descs.size());
+  size_t num_adopted = 0;
+  try {
+    uint32_t memory_type_bits = ~0u;
+    vk::DeviceSize alignment = 1;
+    for (const auto &desc : descs) {
+      handles.push_back(device_ptr_->createBuffer(
+          vk::BufferCreateInfo().setSize(desc.size).setUsage(desc.usage)));
+      const auto requirements =
+          device_ptr_->getBufferMemoryRequirements(handles.back());
+      ranges_.push_back({
+          .size = requirements.size,
+          .alignment = requirements.alignment,
+          .first_stage = desc.first_stage,
+          .last_stage = desc.last_stage,
+      });
+      memory_type_bits &= requirements.memoryTypeBits;
+      alignment = std::max(alignment, requirements.alignment);
+    }
+    if (memory_type_bits == 0) {
+      throw std::runtime_error("No memory type fits all transient buffers");
+    }
+
+    block_size_ = pack_transient_ranges(ranges_);
+    if (reserve) {
+      reserve(block_size_);
+    }
+
+    // One block for all, the aliasing allocation of the VMA documentation
+    const VkMemoryRequirements block_requirements{
+        .size = block_size_,
+        .alignment = alignment,
+        .memoryTypeBits = memory_type_bits,
+    };
+    const VmaAllocationCreateInfo create_info{
+        .preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    };
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VmaAllocationInfo allocation_info{};
+    if (vmaAllocateMemory(allocator,
+                          &block_requirements,
+                          &create_info,
+                          &allocation,
+                          &allocation_info) != VK_SUCCESS) {
+      throw std::runtime_error("Cannot allocate the transient buffers");
+    }
+
+    memory_tracker->on_allocate(BufferClass::kTransient, block_size_);
+    block_ = std::shared_ptr<VmaAllocation_T>(
+        allocation,
+        [allocator,
+         tracker = std::move(memory_tracker),
+         size = block_size_](const VmaAllocation a) {
+          vmaFreeMemory(allocator, a);
+          tracker->on_free(BufferClass::kTransient, size);
+        });
+
+    const auto memory =
+        static_cast<vk::DeviceMemory>(allocation_info.deviceMemory);
+    for (size_t i = 0; i < descs.size(); ++i) {
+      if (vmaBindBufferMemory2(allocator,
+                               allocation,
+                               ranges_[i].offset,
+                               handles[i],
+                               nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Cannot bind a transient buffer");
+      }
+      buffers_.push_back(std::make_shared<Buffer>(device_ptr_,
+                                                  handles[i],
+                                                  memory,
+                                                  descs[i].size,
+                                                  nullptr,
+                                                  block_,
+                                                  false));
+      ++num_adopted;
+    }
+  } catch (...) {
+    for (auto i = num_adopted; i < handles.size(); ++i) {
+      device_ptr_->destroyBuffer(handles[i]);
+    }
+    destroy();
+    throw;
+  }
+
+  spdlog::debug("TransientBuffers: {} buffers, {} bytes instead of {}",
+                buffers_.size(),
+                block_size_,
+                get_unaliased_size());
+}
+
+void TransientBuffers::destroy() {
+  for (const auto &buffer : buffers_) {
+    buffer->destroy();
+  }
+  buffers_.clear();
+  block_.reset();
+}
+
+vk::DeviceSize TransientBuffers::get_unaliased_size() const {
+  vk::DeviceSize total = 0;
+  for (const auto &range : ranges_) {
+    total += range.size;
+  }
+  return total;
+}
+
+bool TransientBuffers::reuses_memory(const uint32_t stage) const {
+  for (const auto &range : ranges_) {
+    if (range.first_stage != stage) {
+      continue;
+    }
+    for (const auto &earlier : ranges_) {
+      if (earlier.last_stage < stage && memory_overlaps(range, earlier)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool TransientBuffers::record_stage_barrier(const vk::CommandBuffer &cmd_buf,
+                                            const uint32_t stage) const {
+  if (!reuses_memory(stage)) {
+    return false;
+  }
+
+  // Earlier reads must be done (execution dependency) and earlier writes
+  // must not land after the new ones
+  const auto barrier =
+      vk::MemoryBarrier()
+          .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+          .setDstAccessMask(vk::AccessFlagBits::eShaderRead |
+                            vk::AccessFlagBits::eShaderWrite);
+  cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                          vk::PipelineStageFlagBits::eComputeShader,
+                          {},
+                          barrier,
+                          nullptr,
+                          nullptr);
+  return true;
+}
+
+}  // namespace core
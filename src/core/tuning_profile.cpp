@@ -0,0 +1,200 @@
+#include "core/tuning_profile.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <bit>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace core {
+
+// First line of the file, bump it if the format changes.
+constexpr std::string_view kProfileHeader =
+    "# vulkan-compute tuning profile v1";
+
+namespace {
+
+// The whole of 'text' as a decimal number, false otherwise (never throws)
+bool parse_uint(const std::string_view text, uint32_t &value) {
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  return ec == std::errc{} && ptr == end;
+}
+
+}  // namespace
+
+std::string TuningProfile::make_device_key(const uint32_t vendor_id,
+                                           const uint32_t device_id,
+                                           const uint32_t driver_version) {
+  std::ostringstream oss;
+  oss << std::hex << vendor_id << '_' << device_id << '_' << driver_version;
+  return oss.str();
+}
+
+fs::path TuningProfile::default_path(const std::string_view device_key) {
+  fs::path dir = fs::current_path();
+  if (const char *env = std::getenv("VKC_TUNING_DIR"); env != nullptr) {
+    dir = env;
+  }
+  return dir / ("tuning_" + std::string(device_key) + ".profile");
+}
+
+uint32_t TuningProfile::size_bucket(const uint32_t n) {
+  return n == 0 ? 0 : static_cast<uint32_t>(std::bit_width(n) - 1);
+}
+
+std::vector<TuningCandidate> TuningProfile::workgroup_candidates(
+    const uint32_t max_threads) {
+  std::vector<TuningCandidate> candidates;
+  for (uint32_t threads = 32; threads <= max_threads; threads *= 2) {
+    candidates.push_back({.threads_per_block = threads});
+  }
+  return candidates;
+}
+
+std::optional<TuningEntry> TuningProfile::find(const std::string_view kernel,
+                                               const uint32_t n) const {
+  const auto bucket = size_bucket(n);
+
+  std::optional<TuningEntry> best;
+  uint32_t best_distance = UINT32_MAX;
+  for (const auto &[key, entry] : entries_) {
+    if (key.first != kernel) {
+      continue;
+    }
+    const auto distance =
+        key.second > bucket ? key.second - bucket : bucket - key.second;
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = entry;
+    }
+  }
+  return best;
+}
+
+std::vector<TuningEntry> TuningProfile::entries_of(
+    const std::string_view kernel) const {
+  std::vector<TuningEntry> entries;
+  for (const auto &[key, entry] : entries_) {
+    if (key.first == kernel) {
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+void TuningProfile::update(const std::string_view kernel,
+                           const uint32_t n,
+                           const TuningEntry &entry) {
+  entries_[{std::string(kernel), size_bucket(n)}] = entry;
+}
+
+// File format, one entry per line after the header and device line:
+//
+//   <kernel> <bucket> <threads_per_block> <time_ms> [<id>=<value> ...]
+//
+// Spec constant values are stored as their raw 32 bit pattern.
+bool TuningProfile::load(const fs::path &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    spdlog::debug("TuningProfile::load, no profile at {}", path.string());
+    return false;
+  }
+
+  std::string line;
+  if (!std::getline(file, line) || line != kProfileHeader) {
+    spdlog::warn("TuningProfile::load, unknown format: {}", path.string());
+    return false;
+  }
+
+  std::string tag, device_key;
+  if (!std::getline(file, line) ||
+      !(std::istringstream(line) >> tag >> device_key) || tag != "device") {
+    spdlog::warn("TuningProfile::load, missing device: {}", path.string());
+    return false;
+  }
+
+  if (!device_key_.empty() && device_key != device_key_) {
+    spdlog::warn("TuningProfile::load, profile is for device {}, not {}",
+                 device_key,
+                 device_key_);
+    return false;
+  }
+
+  decltype(entries_) entries;
+  while (std::getline(file, line)) {
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+
+    std::istringstream iss(line);
+    std::string kernel;
+    uint32_t bucket;
+    TuningEntry entry;
+    if (!(iss >> kernel >> bucket >> entry.threads_per_block >>
+          entry.time_ms) ||
+        entry.threads_per_block == 0) {
+      spdlog::warn("TuningProfile::load, bad line: {}", line);
+      return false;
+    }
+
+    std::string spec;
+    while (iss >> spec) {
+      const auto eq = spec.find('=');
+      if (eq == std::string::npos) {
+        spdlog::warn("TuningProfile::load, bad constant: {}", spec);
+        return false;
+      }
+      uint32_t id = 0;
+      uint32_t raw = 0;
+      if (!parse_uint(std::string_view(spec).substr(0, eq), id) ||
+          !parse_uint(std::string_view(spec).substr(eq + 1), raw)) {
+        spdlog::warn("TuningProfile::load, bad constant: {}", spec);
+        return false;
+      }
+      if (id < kFirstUserSpecConstantId) {
+        spdlog::warn("TuningProfile::load, constant ID {} is reserved", id);
+        return false;
+      }
+      entry.spec_constants.set(id, raw);
+    }
+
+    entries[{kernel, bucket}] = entry;
+  }
+
+  device_key_ = device_key;
+  entries_ = std::move(entries);
+
+  spdlog::info("Loaded tuning profile {} ({} entries)",
+               path.string(),
+               entries_.size());
+  return true;
+}
+
+void TuningProfile::save(const fs::path &path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path.string());
+  }
+
+  file << kProfileHeader << '\n';
+  file << "device " << device_key_ << '\n';
+  for (const auto &[key, entry] : entries_) {
+    file << key.first << ' ' << key.second << ' ' << entry.threads_per_block
+         << ' ' << entry.time_ms;
+    const auto &ids = entry.spec_constants.ids();
+    const auto &values = entry.spec_constants.values();
+    for (size_t i = 0; i < ids.size(); ++i) {
+      file << ' ' << ids[i] << '=' << values[i];
+    }
+    file << '\n';
+  }
+
+  if (file.fail()) {
+    throw std::runtime_error("Failed to write file: " + path.string());
+  }
+}
+
+}  // namespace core
@@ -1,5 +1,5 @@
 // In exactly one translation unit, define the following macro before including
-// the library. This will also define the VMA global allocator object.
+// the library.
 
 #define VMA_IMPLEMENTATION
 #define VMA_DEDICATED_ALLOCATION 0
@@ -8,7 +8,3 @@
 #include "core/vma_usage.hpp"
 
 #include "vk_mem_alloc.h"
-
-namespace core {
-VmaAllocator g_allocator;
-}
\ No newline at end of file
@@ -9,6 +9,13 @@ add_requires("spdlog", "cli11")
 
 add_rules("mode.debug", "mode.release")
 
+option("tracing")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Record host trace spans (see include/core/trace.hpp)")
+    add_defines("VKC_ENABLE_TRACING=1")
+option_end()
+
 set_languages("c++20")
 set_warnings("all")
 
@@ -22,13 +29,12 @@ if is_mode("release") then
     set_optimize("fastest")
 end
 
-if is_plat("windows") then
-elseif is_plat("linux") then
-    before_build(function(target)
-        os.exec("python3 compile_shaders.py")
-        -- os.exec("./compile_shaders.sh")
-    end)
-end
+-- On every platform: the .spv files are not checked in, they must match the
+-- kernels' sources. os.execv() fails the build if any shader fails.
+before_build(function(target)
+    local python = is_host("windows") and "python" or "python3"
+    os.execv(python, {"compile_shaders.py"})
+end)
 
 after_build(function(target)
     platform = os.host()
@@ -39,6 +45,7 @@ after_build(function(target)
     else
         build_path = "$(buildir)/" .. platform .. "/" .. arch .. "/debug/"
     end
+    -- Shaders are embedded in the binary, the files are only a fallback
     os.cp("shaders/compiled_shaders/**.spv", build_path)
     print("Copied compiled shaders to " .. build_path)
 end)
@@ -46,17 +53,45 @@ end)
 target("app")
 set_default(true)
 set_kind("binary")
-add_includedirs("include")
+add_includedirs("include", "shaders/compiled_shaders")
 add_headerfiles("include/*.hpp", "include/**/*.hpp")
 add_files("examples/main.cpp", "src/**/*.cpp")
 add_packages("vk-bootstrap", "vulkan-memory-allocator", "spirv-cross", "glm",
              "vulkansdk", "spdlog", "cli11")
+add_options("tracing")
 
 target("brt")
 set_kind("binary")
-add_includedirs("include")
+add_includedirs("include", "shaders/compiled_shaders")
 add_files("examples/02_brt.cpp", "src/**/*.cpp")
 add_headerfiles("examples/*.hpp", "include/**/*.hpp")
 add_packages("vk-bootstrap", "vulkan-memory-allocator", "spirv-cross", "glm",
              "vulkansdk", "spdlog")
+add_options("tracing")
+
+target("query")
+set_kind("binary")
+add_includedirs("include", "shaders/compiled_shaders")
+add_files("examples/03_query.cpp", "src/**/*.cpp")
+add_headerfiles("examples/*.hpp", "include/**/*.hpp")
+add_packages("vk-bootstrap", "vulkan-memory-allocator", "spirv-cross", "glm",
+             "vulkansdk", "spdlog")
+add_options("tracing")
+
+target("sort_bench")
+set_kind("binary")
+add_includedirs("include")
+add_files("examples/04_sort_bench.cpp")
+add_headerfiles("include/*.hpp")
+if is_plat("linux") then
+    add_syslinks("pthread")
+end
 
+target("batched")
+set_kind("binary")
+add_includedirs("include", "shaders/compiled_shaders")
+add_files("examples/05_batched.cpp", "src/**/*.cpp")
+add_headerfiles("examples/*.hpp", "include/**/*.hpp")
+add_packages("vk-bootstrap", "vulkan-memory-allocator", "spirv-cross", "glm",
+             "vulkansdk", "spdlog")
+add_options("tracing")